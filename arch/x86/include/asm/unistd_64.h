@@ -683,6 +683,16 @@ __SYSCALL(__NR_sendmmsg, sys_sendmmsg)
 __SYSCALL(__NR_setns, sys_setns)
 #define __NR_getcpu				309
 __SYSCALL(__NR_getcpu, sys_getcpu)
+#define __NR_preadv2				310
+__SYSCALL(__NR_preadv2, sys_preadv2)
+#define __NR_pwritev2				311
+__SYSCALL(__NR_pwritev2, sys_pwritev2)
+#define __NR_sched_setattr			312
+__SYSCALL(__NR_sched_setattr, sys_sched_setattr)
+#define __NR_sched_getattr			313
+__SYSCALL(__NR_sched_getattr, sys_sched_getattr)
+#define __NR_copy_file_range			314
+__SYSCALL(__NR_copy_file_range, sys_copy_file_range)
 
 #ifndef __NO_STUBS
 #define __ARCH_WANT_OLD_READDIR
@@ -33,6 +33,7 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/kprobes.h>
+#include <linux/context_tracking.h>
 #include <asm/timer.h>
 #include <asm/cpu.h>
 #include <asm/traps.h>
@@ -261,10 +262,15 @@ do_async_page_fault(struct pt_regs *regs, unsigned long error_code)
 	default:
 		do_page_fault(regs, error_code);
 		break;
-	case KVM_PV_REASON_PAGE_NOT_PRESENT:
+	case KVM_PV_REASON_PAGE_NOT_PRESENT: {
 		/* page is swapped out by the host. */
-		kvm_async_pf_task_wait((u32)read_cr2());
+		u32 token = read_cr2();
+
+		exception_enter(regs);
+		kvm_async_pf_task_wait(token);
+		exception_exit(regs);
 		break;
+	}
 	case KVM_PV_REASON_PAGE_READY:
 		kvm_async_pf_task_wake((u32)read_cr2());
 		break;
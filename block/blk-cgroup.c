@@ -180,6 +180,29 @@ static inline void blkio_update_group_iops(struct blkio_group *blkg,
 	}
 }
 
+static inline void blkio_update_group_target(struct blkio_group *blkg,
+			unsigned int target, int fileid)
+{
+	struct blkio_policy_type *blkiop;
+
+	list_for_each_entry(blkiop, &blkio_list, list) {
+
+		/* If this policy does not own the blkg, do not send updates */
+		if (blkiop->plid != blkg->plid)
+			continue;
+
+		if (fileid == BLKIO_LAT_read_target_device
+		    && blkiop->ops.blkio_update_group_read_target_fn)
+			blkiop->ops.blkio_update_group_read_target_fn(blkg->key,
+								blkg, target);
+
+		if (fileid == BLKIO_LAT_write_target_device
+		    && blkiop->ops.blkio_update_group_write_target_fn)
+			blkiop->ops.blkio_update_group_write_target_fn(blkg->key,
+								blkg, target);
+	}
+}
+
 /*
  * Add to the appropriate stat variable depending on the request type.
  * This should be called with the blkg->stats_lock held.
@@ -873,6 +896,15 @@ static int blkio_policy_parse_and_set(char *buf,
 			break;
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		ret = strict_strtoul(s[1], 10, &temp);
+		if (ret || temp > UINT_MAX)
+			return -EINVAL;
+
+		newpn->plid = plid;
+		newpn->fileid = fileid;
+		newpn->val.target = temp;
+		break;
 	default:
 		BUG();
 	}
@@ -940,6 +972,33 @@ unsigned int blkcg_get_write_iops(struct blkio_cgroup *blkcg, dev_t dev)
 		return -1;
 }
 
+/* Latency targets in usecs, 0 if the cgroup has none for @dev */
+unsigned int blkcg_get_read_target(struct blkio_cgroup *blkcg, dev_t dev)
+{
+	struct blkio_policy_node *pn;
+
+	pn = blkio_policy_search_node(blkcg, dev, BLKIO_POLICY_LATENCY,
+				BLKIO_LAT_read_target_device);
+	if (pn)
+		return pn->val.target;
+	else
+		return 0;
+}
+EXPORT_SYMBOL_GPL(blkcg_get_read_target);
+
+unsigned int blkcg_get_write_target(struct blkio_cgroup *blkcg, dev_t dev)
+{
+	struct blkio_policy_node *pn;
+
+	pn = blkio_policy_search_node(blkcg, dev, BLKIO_POLICY_LATENCY,
+				BLKIO_LAT_write_target_device);
+	if (pn)
+		return pn->val.target;
+	else
+		return 0;
+}
+EXPORT_SYMBOL_GPL(blkcg_get_write_target);
+
 /* Checks whether user asked for deleting a policy rule */
 static bool blkio_delete_rule_command(struct blkio_policy_node *pn)
 {
@@ -961,6 +1020,10 @@ static bool blkio_delete_rule_command(struct blkio_policy_node *pn)
 				return 1;
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		if (pn->val.target == 0)
+			return 1;
+		break;
 	default:
 		BUG();
 	}
@@ -986,6 +1049,9 @@ static void blkio_update_policy_rule(struct blkio_policy_node *oldpn,
 			oldpn->val.iops = newpn->val.iops;
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		oldpn->val.target = newpn->val.target;
+		break;
 	default:
 		BUG();
 	}
@@ -1021,6 +1087,9 @@ static void blkio_update_blkg_policy(struct blkio_cgroup *blkcg,
 			break;
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		blkio_update_group_target(blkg, pn->val.target, pn->fileid);
+		break;
 	default:
 		BUG();
 	}
@@ -1131,6 +1200,10 @@ blkio_print_policy_node(struct seq_file *m, struct blkio_policy_node *pn)
 				break;
 			}
 			break;
+		case BLKIO_POLICY_LATENCY:
+			seq_printf(m, "%u:%u\t%u\n", MAJOR(pn->dev),
+				MINOR(pn->dev), pn->val.target);
+			break;
 		default:
 			BUG();
 	}
@@ -1184,6 +1257,16 @@ static int blkiocg_file_read(struct cgroup *cgrp, struct cftype *cft,
 			BUG();
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		switch(name) {
+		case BLKIO_LAT_read_target_device:
+		case BLKIO_LAT_write_target_device:
+			blkio_read_policy_node_files(cft, blkcg, m);
+			return 0;
+		default:
+			BUG();
+		}
+		break;
 	default:
 		BUG();
 	}
@@ -1294,6 +1377,24 @@ static int blkiocg_file_read_map(struct cgroup *cgrp, struct cftype *cft,
 			BUG();
 		}
 		break;
+	case BLKIO_POLICY_LATENCY:
+		switch(name) {
+		case BLKIO_LAT_io_service_bytes:
+			return blkio_read_blkg_stats(blkcg, cft, cb,
+					BLKIO_STAT_CPU_SERVICE_BYTES, 1, 1);
+		case BLKIO_LAT_io_serviced:
+			return blkio_read_blkg_stats(blkcg, cft, cb,
+						BLKIO_STAT_CPU_SERVICED, 1, 1);
+		case BLKIO_LAT_io_service_time:
+			return blkio_read_blkg_stats(blkcg, cft, cb,
+						BLKIO_STAT_SERVICE_TIME, 1, 0);
+		case BLKIO_LAT_io_wait_time:
+			return blkio_read_blkg_stats(blkcg, cft, cb,
+						BLKIO_STAT_WAIT_TIME, 1, 0);
+		default:
+			BUG();
+		}
+		break;
 	default:
 		BUG();
 	}
@@ -1488,6 +1589,49 @@ struct cftype blkio_files[] = {
 	},
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
+#ifdef CONFIG_LATENCY_GROUP_IOSCHED
+	{
+		.name = "latency.read_target_device",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_LATENCY,
+				BLKIO_LAT_read_target_device),
+		.read_seq_string = blkiocg_file_read,
+		.write_string = blkiocg_file_write,
+		.max_write_len = 256,
+	},
+	{
+		.name = "latency.write_target_device",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_LATENCY,
+				BLKIO_LAT_write_target_device),
+		.read_seq_string = blkiocg_file_read,
+		.write_string = blkiocg_file_write,
+		.max_write_len = 256,
+	},
+	{
+		.name = "latency.io_service_bytes",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_LATENCY,
+				BLKIO_LAT_io_service_bytes),
+		.read_map = blkiocg_file_read_map,
+	},
+	{
+		.name = "latency.io_serviced",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_LATENCY,
+				BLKIO_LAT_io_serviced),
+		.read_map = blkiocg_file_read_map,
+	},
+	{
+		.name = "latency.io_service_time",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_LATENCY,
+				BLKIO_LAT_io_service_time),
+		.read_map = blkiocg_file_read_map,
+	},
+	{
+		.name = "latency.io_wait_time",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_LATENCY,
+				BLKIO_LAT_io_wait_time),
+		.read_map = blkiocg_file_read_map,
+	},
+#endif /* CONFIG_LATENCY_GROUP_IOSCHED */
+
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	{
 		.name = "avg_queue_size",
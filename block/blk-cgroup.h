@@ -19,6 +19,7 @@
 enum blkio_policy_id {
 	BLKIO_POLICY_PROP = 0,		/* Proportional Bandwidth division */
 	BLKIO_POLICY_THROTL,		/* Throttling */
+	BLKIO_POLICY_LATENCY,		/* Latency targets */
 };
 
 /* Max limits for throttle policy */
@@ -111,6 +112,16 @@ enum blkcg_file_name_throtl {
 	BLKIO_THROTL_io_serviced,
 };
 
+/* cgroup files owned by latency target policy */
+enum blkcg_file_name_lat {
+	BLKIO_LAT_read_target_device,
+	BLKIO_LAT_write_target_device,
+	BLKIO_LAT_io_service_bytes,
+	BLKIO_LAT_io_serviced,
+	BLKIO_LAT_io_service_time,
+	BLKIO_LAT_io_wait_time,
+};
+
 struct blkio_cgroup {
 	struct cgroup_subsys_state css;
 	unsigned int weight;
@@ -194,6 +205,8 @@ struct blkio_policy_node {
 		 */
 		u64 bps;
 		unsigned int iops;
+		/* Latency target in usecs, read or write as per "fileid" */
+		unsigned int target;
 	} val;
 };
 
@@ -207,6 +220,10 @@ extern unsigned int blkcg_get_read_iops(struct blkio_cgroup *blkcg,
 				     dev_t dev);
 extern unsigned int blkcg_get_write_iops(struct blkio_cgroup *blkcg,
 				     dev_t dev);
+extern unsigned int blkcg_get_read_target(struct blkio_cgroup *blkcg,
+				     dev_t dev);
+extern unsigned int blkcg_get_write_target(struct blkio_cgroup *blkcg,
+				     dev_t dev);
 
 typedef void (blkio_unlink_group_fn) (void *key, struct blkio_group *blkg);
 
@@ -220,6 +237,10 @@ typedef void (blkio_update_group_read_iops_fn) (void *key,
 			struct blkio_group *blkg, unsigned int read_iops);
 typedef void (blkio_update_group_write_iops_fn) (void *key,
 			struct blkio_group *blkg, unsigned int write_iops);
+typedef void (blkio_update_group_read_target_fn) (void *key,
+			struct blkio_group *blkg, unsigned int read_target);
+typedef void (blkio_update_group_write_target_fn) (void *key,
+			struct blkio_group *blkg, unsigned int write_target);
 
 struct blkio_policy_ops {
 	blkio_unlink_group_fn *blkio_unlink_group_fn;
@@ -228,6 +249,8 @@ struct blkio_policy_ops {
 	blkio_update_group_write_bps_fn *blkio_update_group_write_bps_fn;
 	blkio_update_group_read_iops_fn *blkio_update_group_read_iops_fn;
 	blkio_update_group_write_iops_fn *blkio_update_group_write_iops_fn;
+	blkio_update_group_read_target_fn *blkio_update_group_read_target_fn;
+	blkio_update_group_write_target_fn *blkio_update_group_write_target_fn;
 };
 
 struct blkio_policy_type {
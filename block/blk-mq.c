@@ -0,0 +1,945 @@
+/*
+ * Block multiqueue core code
+ *
+ * Every CPU gets a software staging queue (struct blk_mq_ctx) that bios
+ * are turned into requests on, and merged against, under a lock only that
+ * CPU normally takes.  The staging queues are mapped onto the hardware
+ * dispatch queues the driver registered (struct blk_mq_hw_ctx); running a
+ * hardware queue drains the staging queues mapped to it and feeds the
+ * requests to ->queue_rq().  Requests and their driver payload are
+ * preallocated per hardware queue and identified by a tag.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/writeback.h>
+#include <linux/smp.h>
+#include <linux/list_sort.h>
+#include <linux/cache.h>
+#include <linux/sched.h>
+
+#include <trace/events/block.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+
+/*
+ * Only look this far back into a staging queue for merge candidates
+ */
+#define BLK_MQ_MERGE_DEPTH	8
+
+static bool blk_mq_hctx_has_pending(struct blk_mq_hw_ctx *hctx)
+{
+	return !list_empty_careful(&hctx->dispatch) ||
+		find_first_bit(hctx->ctx_map, hctx->nr_ctx) < hctx->nr_ctx;
+}
+
+static void blk_mq_hctx_mark_pending(struct blk_mq_hw_ctx *hctx,
+				     struct blk_mq_ctx *ctx)
+{
+	if (!test_bit(ctx->index_hw, hctx->ctx_map))
+		set_bit(ctx->index_hw, hctx->ctx_map);
+}
+
+/*
+ * Tags are a plain bitmap per hardware queue.  Allocation is a lockless
+ * search for a clear bit; if the queue is exhausted the caller sleeps
+ * until a request is freed.
+ */
+static int __blk_mq_get_tag(struct blk_mq_hw_ctx *hctx)
+{
+	unsigned int tag;
+
+	do {
+		tag = find_first_zero_bit(hctx->tag_map, hctx->queue_depth);
+		if (tag >= hctx->queue_depth)
+			return -1;
+	} while (test_and_set_bit_lock(tag, hctx->tag_map));
+
+	return tag;
+}
+
+static int blk_mq_get_tag(struct blk_mq_hw_ctx *hctx, gfp_t gfp)
+{
+	DEFINE_WAIT(wait);
+	int tag;
+
+	tag = __blk_mq_get_tag(hctx);
+	if (tag >= 0 || !(gfp & __GFP_WAIT))
+		return tag;
+
+	do {
+		prepare_to_wait(&hctx->tag_wait, &wait, TASK_UNINTERRUPTIBLE);
+		tag = __blk_mq_get_tag(hctx);
+		if (tag >= 0)
+			break;
+		trace_block_sleeprq(hctx->queue, NULL, 0);
+		io_schedule();
+	} while (1);
+
+	finish_wait(&hctx->tag_wait, &wait);
+	return tag;
+}
+
+static void blk_mq_put_tag(struct blk_mq_hw_ctx *hctx, unsigned int tag)
+{
+	BUG_ON(tag >= hctx->queue_depth);
+
+	clear_bit_unlock(tag, hctx->tag_map);
+	smp_mb__after_clear_bit();
+	if (waitqueue_active(&hctx->tag_wait))
+		wake_up(&hctx->tag_wait);
+}
+
+/**
+ * blk_mq_alloc_request - allocate a request from a multiqueue queue
+ * @q:		the queue
+ * @rw:		initial cmd_flags, at least the data direction
+ * @gfp:	allocation mask; with __GFP_WAIT this waits for a free tag
+ *
+ * The request is taken from the hardware queue the calling CPU maps to.
+ * Returns %NULL if the queue is dead or out of tags and @gfp does not
+ * allow sleeping.
+ */
+struct request *blk_mq_alloc_request(struct request_queue *q, int rw,
+				     gfp_t gfp)
+{
+	struct blk_mq_ctx *ctx;
+	struct blk_mq_hw_ctx *hctx;
+	struct request *rq;
+	int tag;
+
+	if (unlikely(test_bit(QUEUE_FLAG_DEAD, &q->queue_flags)))
+		return NULL;
+
+	ctx = __blk_mq_get_ctx(q, raw_smp_processor_id());
+	hctx = blk_mq_map_queue(q, ctx->cpu);
+
+	tag = blk_mq_get_tag(hctx, gfp);
+	if (tag < 0)
+		return NULL;
+
+	rq = hctx->rqs[tag];
+	blk_rq_init(q, rq);
+	rq->tag = tag;
+	rq->mq_ctx = ctx;
+	rq->cmd_flags = rw;
+	if (blk_queue_io_stat(q))
+		rq->cmd_flags |= REQ_IO_STAT;
+
+	return rq;
+}
+EXPORT_SYMBOL(blk_mq_alloc_request);
+
+/**
+ * blk_mq_free_request - return a request to its hardware queue
+ * @rq:		the request
+ */
+void blk_mq_free_request(struct request *rq)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(rq->q, ctx->cpu);
+
+	/* this is a bio leak */
+	WARN_ON(rq->bio != NULL);
+
+	rq->cmd_flags = 0;
+	blk_mq_put_tag(hctx, rq->tag);
+}
+EXPORT_SYMBOL(blk_mq_free_request);
+
+static void __blk_mq_end_io(struct request *rq, int error)
+{
+	if (unlikely(error) && !rq->errors)
+		rq->errors = error;
+
+	if (blk_update_request(rq, error, blk_rq_bytes(rq)))
+		BUG();
+
+	if (unlikely(laptop_mode) && rq->cmd_type == REQ_TYPE_FS)
+		laptop_io_completion(&rq->q->backing_dev_info);
+
+	blk_account_io_done(rq);
+
+	if (rq->end_io)
+		rq->end_io(rq, error);
+	else
+		blk_mq_free_request(rq);
+}
+
+/**
+ * blk_mq_end_io - end I/O on a request on the current CPU
+ * @rq:		the request being processed
+ * @error:	%0 for success, < %0 for error
+ *
+ * Completes all bios of @rq and frees it, unless someone waits on it
+ * through ->end_io.  Drivers normally want blk_mq_complete_request().
+ */
+void blk_mq_end_io(struct request *rq, int error)
+{
+	__blk_mq_end_io(rq, error);
+}
+EXPORT_SYMBOL(blk_mq_end_io);
+
+#if defined(CONFIG_SMP) && defined(CONFIG_USE_GENERIC_SMP_HELPERS)
+static void __blk_mq_complete_request_remote(void *data)
+{
+	struct request *rq = data;
+
+	__blk_mq_end_io(rq, rq->errors);
+}
+
+/*
+ * Send the completion over to the CPU that submitted the request, so the
+ * bio end_io handlers run where the data and the waiting task are cache
+ * hot.  Returns false if the caller should complete the request itself.
+ */
+static bool blk_mq_steer_completion(struct request *rq, int error)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	bool steered = false;
+	int cpu;
+
+	if (!test_bit(QUEUE_FLAG_SAME_COMP, &rq->q->queue_flags))
+		return false;
+
+	cpu = get_cpu();
+	if (cpu != ctx->cpu && cpu_online(ctx->cpu) &&
+	    (test_bit(QUEUE_FLAG_SAME_FORCE, &rq->q->queue_flags) ||
+	     blk_cpu_to_group(cpu) != blk_cpu_to_group(ctx->cpu))) {
+		rq->errors = error;
+		rq->csd.func = __blk_mq_complete_request_remote;
+		rq->csd.info = rq;
+		rq->csd.flags = 0;
+		__smp_call_function_single(ctx->cpu, &rq->csd, 0);
+		steered = true;
+	}
+	put_cpu();
+
+	return steered;
+}
+#else /* CONFIG_SMP && CONFIG_USE_GENERIC_SMP_HELPERS */
+static bool blk_mq_steer_completion(struct request *rq, int error)
+{
+	return false;
+}
+#endif
+
+/**
+ * blk_mq_complete_request - end I/O on a request
+ * @rq:		the request being processed
+ * @error:	%0 for success, < %0 for error
+ *
+ * Description:
+ *     Ends all I/O on a request.  With QUEUE_FLAG_SAME_COMP set the
+ *     completion is finished on the CPU that submitted the request,
+ *     unless that CPU shares a cache group with the current one (and
+ *     QUEUE_FLAG_SAME_FORCE is not set).  May be called from hard irq
+ *     context.
+ */
+void blk_mq_complete_request(struct request *rq, int error)
+{
+	if (!blk_mq_steer_completion(rq, error))
+		__blk_mq_end_io(rq, error);
+}
+EXPORT_SYMBOL(blk_mq_complete_request);
+
+static void blk_mq_start_request(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	trace_block_rq_issue(q, rq);
+
+	rq->cmd_flags |= REQ_STARTED;
+	rq->resid_len = blk_rq_bytes(rq);
+	if (unlikely(blk_bidi_rq(rq)))
+		rq->next_rq->resid_len = blk_rq_bytes(rq->next_rq);
+}
+
+/*
+ * Run this hardware queue, pulling any software queues mapped to it in.
+ * Requests the driver could not take go on the hctx dispatch list and are
+ * retried first the next time the queue is run.
+ */
+static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	LIST_HEAD(rq_list);
+	unsigned int bit;
+	int ret;
+
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	for_each_set_bit(bit, hctx->ctx_map, hctx->nr_ctx) {
+		struct blk_mq_ctx *ctx = hctx->ctxs[bit];
+
+		clear_bit(bit, hctx->ctx_map);
+		spin_lock(&ctx->lock);
+		list_splice_tail_init(&ctx->rq_list, &rq_list);
+		spin_unlock(&ctx->lock);
+	}
+
+	/*
+	 * If we have previous entries on our dispatch list, grab them
+	 * and stuff them at the front for more fair dispatch.
+	 */
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock(&hctx->lock);
+		list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock(&hctx->lock);
+	}
+
+	while (!list_empty(&rq_list)) {
+		struct request *rq;
+
+		rq = list_first_entry(&rq_list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+
+		blk_mq_start_request(rq);
+
+		ret = q->mq_ops->queue_rq(hctx, rq);
+		if (ret == BLK_MQ_RQ_QUEUE_BUSY) {
+			list_add(&rq->queuelist, &rq_list);
+			break;
+		}
+		if (ret != BLK_MQ_RQ_QUEUE_OK) {
+			pr_err("blk-mq: bad return on queue: %d\n", ret);
+			rq->errors = -EIO;
+			blk_mq_end_io(rq, rq->errors);
+		}
+	}
+
+	/*
+	 * Any items that need requeuing?  Stuff them into hctx->dispatch,
+	 * that is where we will continue on next queue run.
+	 */
+	if (!list_empty(&rq_list)) {
+		spin_lock(&hctx->lock);
+		list_splice(&rq_list, &hctx->dispatch);
+		spin_unlock(&hctx->lock);
+
+		/*
+		 * The driver stopped the queue before returning BUSY, but a
+		 * completion may have restarted it before the requests made
+		 * it onto the dispatch list.  Don't leave them stranded.
+		 */
+		smp_mb();
+		if (!test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			blk_mq_run_hw_queue(hctx, true);
+	}
+}
+
+/**
+ * blk_mq_run_hw_queue - dispatch pending requests of a hardware queue
+ * @hctx:	the hardware queue
+ * @async:	punt the run to kblockd instead of running it inline
+ *
+ * A synchronous run must happen from process context; completion
+ * handlers restarting a queue from interrupt context must pass @async.
+ */
+void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async)
+{
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	if (!async)
+		__blk_mq_run_hw_queue(hctx);
+	else
+		kblockd_schedule_delayed_work(hctx->queue, &hctx->run_work, 0);
+}
+EXPORT_SYMBOL(blk_mq_run_hw_queue);
+
+void blk_mq_run_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!blk_mq_hctx_has_pending(hctx))
+			continue;
+		blk_mq_run_hw_queue(hctx, async);
+	}
+}
+EXPORT_SYMBOL(blk_mq_run_queues);
+
+void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	cancel_delayed_work(&hctx->run_work);
+	set_bit(BLK_MQ_S_STOPPED, &hctx->state);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queue);
+
+void blk_mq_start_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	clear_bit(BLK_MQ_S_STOPPED, &hctx->state);
+	__blk_mq_run_hw_queue(hctx);
+}
+EXPORT_SYMBOL(blk_mq_start_hw_queue);
+
+/**
+ * blk_mq_start_stopped_hw_queues - restart stopped hardware queues
+ * @q:		the queue
+ *
+ * Clears the stopped state of every stopped hardware queue of @q and
+ * kicks kblockd to run them.  Safe to call from interrupt context.
+ */
+void blk_mq_start_stopped_hw_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			continue;
+
+		clear_bit(BLK_MQ_S_STOPPED, &hctx->state);
+		blk_mq_run_hw_queue(hctx, true);
+	}
+}
+EXPORT_SYMBOL(blk_mq_start_stopped_hw_queues);
+
+static void blk_mq_work_fn(struct work_struct *work)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = container_of(work, struct blk_mq_hw_ctx, run_work.work);
+	__blk_mq_run_hw_queue(hctx);
+}
+
+static void __blk_mq_insert_request(struct blk_mq_hw_ctx *hctx,
+				    struct blk_mq_ctx *ctx,
+				    struct request *rq, bool at_head)
+{
+	trace_block_rq_insert(hctx->queue, rq);
+
+	if (at_head)
+		list_add(&rq->queuelist, &ctx->rq_list);
+	else
+		list_add_tail(&rq->queuelist, &ctx->rq_list);
+	blk_mq_hctx_mark_pending(hctx, ctx);
+}
+
+/**
+ * blk_mq_insert_request - queue a prepared request for dispatch
+ * @rq:		the request, from blk_mq_alloc_request()
+ * @at_head:	queue ahead of other staged requests
+ * @run_queue:	run the hardware queue afterwards
+ * @async:	run it from kblockd rather than inline
+ */
+void blk_mq_insert_request(struct request *rq, bool at_head, bool run_queue,
+			   bool async)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(rq->q, ctx->cpu);
+
+	spin_lock(&ctx->lock);
+	__blk_mq_insert_request(hctx, ctx, rq, at_head);
+	spin_unlock(&ctx->lock);
+
+	if (run_queue)
+		blk_mq_run_hw_queue(hctx, async);
+}
+EXPORT_SYMBOL(blk_mq_insert_request);
+
+static int plug_ctx_cmp(void *priv, struct list_head *a, struct list_head *b)
+{
+	struct request *rqa = container_of(a, struct request, queuelist);
+	struct request *rqb = container_of(b, struct request, queuelist);
+
+	return !(rqa->mq_ctx < rqb->mq_ctx ||
+		 (rqa->mq_ctx == rqb->mq_ctx &&
+		  blk_rq_pos(rqa) < blk_rq_pos(rqb)));
+}
+
+/*
+ * Called from blk_flush_plug_list() with the multiqueue requests of a
+ * plug.  Each software queue is locked once for its whole batch, and
+ * each hardware queue that got work is run once at the end.
+ */
+void blk_mq_flush_plug_list(struct list_head *list, bool from_schedule)
+{
+	struct blk_mq_ctx *ctx = NULL;
+	struct blk_mq_hw_ctx *hctx = NULL;
+	struct request_queue *q = NULL;
+	unsigned int depth = 0;
+
+	list_sort(NULL, list, plug_ctx_cmp);
+
+	while (!list_empty(list)) {
+		struct request *rq = list_entry_rq(list->next);
+
+		list_del_init(&rq->queuelist);
+		if (rq->mq_ctx != ctx) {
+			if (ctx) {
+				spin_unlock(&ctx->lock);
+				if (hctx->queue != rq->q) {
+					trace_block_unplug(q, depth,
+							   !from_schedule);
+					blk_mq_run_queues(q, from_schedule);
+					depth = 0;
+				}
+			}
+			ctx = rq->mq_ctx;
+			q = rq->q;
+			hctx = blk_mq_map_queue(q, ctx->cpu);
+			spin_lock(&ctx->lock);
+		}
+		__blk_mq_insert_request(hctx, ctx, rq, false);
+		depth++;
+	}
+
+	if (ctx) {
+		spin_unlock(&ctx->lock);
+		trace_block_unplug(q, depth, !from_schedule);
+		blk_mq_run_queues(q, from_schedule);
+	}
+}
+
+/*
+ * Try to merge @bio into one of the last few requests staged on @ctx.
+ * Called with ctx->lock held.
+ */
+static bool blk_mq_attempt_merge(struct request_queue *q,
+				 struct blk_mq_ctx *ctx, struct bio *bio)
+{
+	struct request *rq;
+	int checked = BLK_MQ_MERGE_DEPTH;
+
+	list_for_each_entry_reverse(rq, &ctx->rq_list, queuelist) {
+		int el_ret;
+
+		if (!checked--)
+			break;
+
+		el_ret = elv_try_merge(rq, bio);
+		if (el_ret == ELEVATOR_BACK_MERGE) {
+			if (bio_attempt_back_merge(q, rq, bio))
+				return true;
+			break;
+		} else if (el_ret == ELEVATOR_FRONT_MERGE) {
+			if (bio_attempt_front_merge(q, rq, bio))
+				return true;
+			break;
+		}
+	}
+
+	return false;
+}
+
+static void blk_mq_bio_to_request(struct request *rq, struct bio *bio)
+{
+	init_request_from_bio(rq, bio);
+	rq->cpu = rq->mq_ctx->cpu;
+
+	drive_stat_acct(rq, 1);
+}
+
+/*
+ * Turn @bio into a request and queue it, merging and plugging as usual.
+ * With @use_plug false the request bypasses the plug and the hardware
+ * queue is run before returning, which the flush code relies on.
+ */
+static void __blk_mq_make_request(struct request_queue *q, struct bio *bio,
+				  bool use_plug)
+{
+	const int rw = bio_data_dir(bio);
+	const bool is_sync = rw_is_sync(bio->bi_rw);
+	struct blk_plug *plug = use_plug ? current->plug : NULL;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+
+	if (plug && !blk_queue_nomerges(q) &&
+	    attempt_plug_merge(current, q, bio))
+		return;
+
+	if (!plug && !blk_queue_nomerges(q)) {
+		ctx = __blk_mq_get_ctx(q, raw_smp_processor_id());
+		spin_lock(&ctx->lock);
+		if (blk_mq_attempt_merge(q, ctx, bio)) {
+			spin_unlock(&ctx->lock);
+			return;
+		}
+		spin_unlock(&ctx->lock);
+	}
+
+	rq = blk_mq_alloc_request(q, rw | (is_sync ? REQ_SYNC : 0),
+				  GFP_NOIO);
+	if (unlikely(!rq)) {
+		bio_endio(bio, -EIO);
+		return;
+	}
+	trace_block_getrq(q, bio, rw);
+
+	blk_mq_bio_to_request(rq, bio);
+
+	if (plug) {
+		if (list_empty(&plug->list))
+			trace_block_plug(q);
+		else if (!plug->should_sort) {
+			struct request *__rq;
+
+			__rq = list_entry_rq(plug->list.prev);
+			if (__rq->q != q)
+				plug->should_sort = 1;
+		}
+		list_add_tail(&rq->queuelist, &plug->list);
+		plug->count++;
+		if (plug->count >= BLK_MAX_REQUEST_COUNT)
+			blk_flush_plug_list(plug, false);
+		return;
+	}
+
+	blk_mq_insert_request(rq, false, true, false);
+}
+
+/*
+ * Issue a cache flush and wait for it.  There is no elevator here to
+ * sequence flushes against data, so REQ_FLUSH and emulated REQ_FUA are
+ * done synchronously in the context of the submitter.
+ */
+static int blk_mq_issue_flush(struct request_queue *q)
+{
+	struct request *rq;
+	int ret;
+
+	rq = blk_mq_alloc_request(q, WRITE_FLUSH, GFP_NOIO);
+	if (!rq)
+		return -ENXIO;
+
+	rq->cmd_type = REQ_TYPE_FS;
+	ret = blk_execute_rq(q, NULL, rq, 0);
+	blk_put_request(rq);
+
+	return ret;
+}
+
+struct blk_mq_fua_wait {
+	struct completion	done;
+	bio_end_io_t		*end_io;
+	void			*private;
+	int			error;
+};
+
+static void blk_mq_fua_end_io(struct bio *bio, int error)
+{
+	struct blk_mq_fua_wait *wait = bio->bi_private;
+
+	wait->error = error;
+	complete(&wait->done);
+}
+
+static void blk_mq_flush_fua_bio(struct request_queue *q, struct bio *bio)
+{
+	struct blk_mq_fua_wait wait;
+	int ret;
+
+	if (!(q->flush_flags & REQ_FLUSH)) {
+		/* no volatile cache, nothing to do */
+		bio->bi_rw &= ~(REQ_FLUSH | REQ_FUA);
+		if (!bio->bi_size) {
+			bio_endio(bio, 0);
+			return;
+		}
+		__blk_mq_make_request(q, bio, true);
+		return;
+	}
+
+	if (bio->bi_rw & REQ_FLUSH) {
+		ret = blk_mq_issue_flush(q);
+		if (ret) {
+			bio_endio(bio, ret);
+			return;
+		}
+		bio->bi_rw &= ~REQ_FLUSH;
+	}
+
+	if (!bio->bi_size) {
+		bio_endio(bio, 0);
+		return;
+	}
+
+	if (!(bio->bi_rw & REQ_FUA) || (q->flush_flags & REQ_FUA)) {
+		__blk_mq_make_request(q, bio, false);
+		return;
+	}
+
+	/* emulate FUA with a post-flush once the data is on the device */
+	bio->bi_rw &= ~REQ_FUA;
+	init_completion(&wait.done);
+	wait.end_io = bio->bi_end_io;
+	wait.private = bio->bi_private;
+	bio->bi_end_io = blk_mq_fua_end_io;
+	bio->bi_private = &wait;
+
+	__blk_mq_make_request(q, bio, false);
+	wait_for_completion(&wait.done);
+
+	ret = wait.error;
+	if (!ret)
+		ret = blk_mq_issue_flush(q);
+
+	bio->bi_end_io = wait.end_io;
+	bio->bi_private = wait.private;
+	bio_endio(bio, ret);
+}
+
+static int blk_mq_make_request(struct request_queue *q, struct bio *bio)
+{
+	blk_queue_bounce(q, &bio);
+
+	if (unlikely(bio->bi_rw & (REQ_FLUSH | REQ_FUA)))
+		blk_mq_flush_fua_bio(q, bio);
+	else
+		__blk_mq_make_request(q, bio, true);
+
+	return 0;
+}
+
+/*
+ * ->poll_fn for multiqueue devices.  There is no way to tell which hardware
+ * queue the waiter's I/O went to, so poll the one this CPU submits to.
+ */
+static int blk_mq_poll(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int ret;
+
+	hctx = blk_mq_map_queue(q, get_cpu());
+	ret = q->mq_ops->poll(hctx);
+	put_cpu();
+
+	return ret;
+}
+
+static void blk_mq_free_rq_map(struct blk_mq_hw_ctx *hctx)
+{
+	unsigned int i;
+
+	if (hctx->rqs) {
+		for (i = 0; i < hctx->queue_depth; i++)
+			kfree(hctx->rqs[i]);
+		kfree(hctx->rqs);
+	}
+	kfree(hctx->tag_map);
+
+	hctx->rqs = NULL;
+	hctx->tag_map = NULL;
+}
+
+static int blk_mq_init_rq_map(struct blk_mq_hw_ctx *hctx,
+			      struct blk_mq_reg *reg, int node)
+{
+	size_t rq_size = L1_CACHE_ALIGN(sizeof(struct request) +
+					reg->cmd_size);
+	unsigned int i;
+
+	hctx->queue_depth = reg->queue_depth;
+	hctx->tag_map = kzalloc_node(BITS_TO_LONGS(reg->queue_depth) *
+				     sizeof(unsigned long), GFP_KERNEL, node);
+	hctx->rqs = kzalloc_node(reg->queue_depth * sizeof(struct request *),
+				 GFP_KERNEL, node);
+	if (!hctx->tag_map || !hctx->rqs)
+		goto fail;
+
+	for (i = 0; i < reg->queue_depth; i++) {
+		hctx->rqs[i] = kzalloc_node(rq_size, GFP_KERNEL, node);
+		if (!hctx->rqs[i])
+			goto fail;
+	}
+
+	init_waitqueue_head(&hctx->tag_wait);
+	return 0;
+
+fail:
+	blk_mq_free_rq_map(hctx);
+	return -ENOMEM;
+}
+
+static void blk_mq_free_hw_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!hctx)
+			continue;
+		if (q->mq_ops && q->mq_ops->exit_hctx)
+			q->mq_ops->exit_hctx(hctx, i);
+		blk_mq_free_rq_map(hctx);
+		kfree(hctx->ctxs);
+		kfree(hctx->ctx_map);
+		free_cpumask_var(hctx->cpumask);
+		kfree(hctx);
+	}
+}
+
+/*
+ * Spread the CPUs over the hardware queues in contiguous ranges, so
+ * that CPUs close to each other (by number, which usually means by
+ * topology) share a hardware queue.
+ */
+static void blk_mq_map_swqueue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct blk_mq_ctx *ctx = __blk_mq_get_ctx(q, cpu);
+
+		q->mq_map[cpu] = cpu * q->nr_hw_queues / nr_cpu_ids;
+		hctx = blk_mq_map_queue(q, cpu);
+
+		cpumask_set_cpu(cpu, hctx->cpumask);
+		ctx->index_hw = hctx->nr_ctx;
+		hctx->ctxs[hctx->nr_ctx++] = ctx;
+	}
+}
+
+/**
+ * blk_mq_init_queue - allocate a multiqueue request queue
+ * @reg:	hardware queue count, depth and driver callbacks
+ * @driver_data: default for hctx->driver_data
+ *
+ * Description:
+ *    Sets up the per-CPU software queues, @reg->nr_hw_queues hardware
+ *    queues and @reg->queue_depth preallocated requests for each of them.
+ *    Each request is followed by @reg->cmd_size bytes of driver data, see
+ *    blk_mq_rq_to_pdu().  The queue is released with blk_cleanup_queue()
+ *    like any other.
+ */
+struct request_queue *blk_mq_init_queue(struct blk_mq_reg *reg,
+					void *driver_data)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct request_queue *q;
+	unsigned int cpu;
+	int i;
+
+	if (!reg->nr_hw_queues || !reg->ops->queue_rq ||
+	    !reg->queue_depth || reg->queue_depth > BLK_MQ_MAX_DEPTH)
+		return ERR_PTR(-EINVAL);
+
+	if (reg->nr_hw_queues > nr_cpu_ids)
+		reg->nr_hw_queues = nr_cpu_ids;
+
+	q = blk_alloc_queue_node(GFP_KERNEL, reg->numa_node);
+	if (!q)
+		return ERR_PTR(-ENOMEM);
+
+	q->queue_ctx = alloc_percpu(struct blk_mq_ctx);
+	q->mq_map = kzalloc_node(sizeof(unsigned int) * nr_cpu_ids,
+				 GFP_KERNEL, reg->numa_node);
+	q->queue_hw_ctx = kzalloc_node(reg->nr_hw_queues * sizeof(hctx),
+				       GFP_KERNEL, reg->numa_node);
+	if (!q->queue_ctx || !q->mq_map || !q->queue_hw_ctx)
+		goto err_queue;
+
+	q->nr_hw_queues = reg->nr_hw_queues;
+
+	for (i = 0; i < q->nr_hw_queues; i++) {
+		hctx = kzalloc_node(sizeof(*hctx), GFP_KERNEL, reg->numa_node);
+		if (!hctx)
+			goto err_queue;
+		q->queue_hw_ctx[i] = hctx;
+
+		if (!zalloc_cpumask_var(&hctx->cpumask, GFP_KERNEL))
+			goto err_queue;
+
+		spin_lock_init(&hctx->lock);
+		INIT_LIST_HEAD(&hctx->dispatch);
+		INIT_DELAYED_WORK(&hctx->run_work, blk_mq_work_fn);
+		hctx->queue = q;
+		hctx->queue_num = i;
+		hctx->driver_data = driver_data;
+
+		hctx->ctxs = kmalloc_node(nr_cpu_ids * sizeof(void *),
+					  GFP_KERNEL, reg->numa_node);
+		hctx->ctx_map = kzalloc_node(BITS_TO_LONGS(nr_cpu_ids) *
+					     sizeof(unsigned long),
+					     GFP_KERNEL, reg->numa_node);
+		if (!hctx->ctxs || !hctx->ctx_map)
+			goto err_queue;
+
+		if (blk_mq_init_rq_map(hctx, reg, reg->numa_node))
+			goto err_queue;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct blk_mq_ctx *ctx = __blk_mq_get_ctx(q, cpu);
+
+		memset(ctx, 0, sizeof(*ctx));
+		spin_lock_init(&ctx->lock);
+		INIT_LIST_HEAD(&ctx->rq_list);
+		ctx->cpu = cpu;
+		ctx->queue = q;
+	}
+
+	blk_mq_map_swqueue(q);
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (reg->ops->init_hctx &&
+		    reg->ops->init_hctx(hctx, driver_data, i))
+			goto err_init;
+	}
+
+	q->mq_ops = reg->ops;
+	q->queue_flags = QUEUE_FLAG_MQ_DEFAULT;
+	if (!(reg->flags & BLK_MQ_F_SHOULD_MERGE))
+		queue_flag_set_unlocked(QUEUE_FLAG_NOMERGES, q);
+
+	blk_queue_make_request(q, blk_mq_make_request);
+	q->nr_requests = reg->queue_depth;
+
+	if (reg->ops->poll && blk_queue_poll_fn(q, blk_mq_poll))
+		goto err_queue;
+
+	return q;
+
+err_init:
+	while (--i >= 0) {
+		if (reg->ops->exit_hctx)
+			reg->ops->exit_hctx(q->queue_hw_ctx[i], i);
+	}
+err_queue:
+	/* releasing the queue kobject frees what was set up so far */
+	blk_cleanup_queue(q);
+	return ERR_PTR(-ENOMEM);
+}
+EXPORT_SYMBOL(blk_mq_init_queue);
+
+/*
+ * Called by blk_sync_queue() to make sure no hardware queue run is
+ * pending or in progress.
+ */
+void blk_mq_sync_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		cancel_delayed_work_sync(&hctx->run_work);
+}
+
+/*
+ * Called on release of the queue kobject.
+ */
+void blk_mq_free_queue(struct request_queue *q)
+{
+	if (q->queue_hw_ctx) {
+		blk_mq_free_hw_queues(q);
+		kfree(q->queue_hw_ctx);
+	}
+	kfree(q->mq_map);
+	if (q->queue_ctx)
+		free_percpu(q->queue_ctx);
+
+	q->queue_hw_ctx = NULL;
+	q->mq_map = NULL;
+	q->queue_ctx = NULL;
+	q->nr_hw_queues = 0;
+}
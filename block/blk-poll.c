@@ -0,0 +1,145 @@
+/*
+ * Polled I/O completions
+ *
+ * On devices that finish an I/O in a few microseconds, taking the
+ * interrupt and switching back to the task waiting for the I/O costs about
+ * as much as the I/O itself.  Drivers that can reap completions without an
+ * interrupt register a ->poll_fn, and synchronous waiters that asked for
+ * it (RWF_HIPRI) spin on that instead of sleeping.
+ *
+ * Spinning for the whole service time burns a CPU, so the waiter can first
+ * sleep for part of it (io_poll_delay): either a fixed time, or half of
+ * the mean completion time seen for polled I/O on the queue.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/hrtimer.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+
+#include "blk.h"
+
+/**
+ * blk_queue_poll_fn - set driver function to poll for completions
+ * @q:  the request queue for the device
+ * @fn: function that reaps completed requests
+ *
+ * Description:
+ *    @fn is called with preemption enabled or disabled and must not
+ *    sleep.  It returns the number of requests it completed.  Polling is
+ *    enabled on the queue; it can be turned off again through the io_poll
+ *    sysfs attribute.
+ **/
+int blk_queue_poll_fn(struct request_queue *q, poll_fn *fn)
+{
+	if (!q->poll_stats) {
+		q->poll_stats = alloc_percpu(struct blk_poll_stats);
+		if (!q->poll_stats)
+			return -ENOMEM;
+	}
+
+	q->poll_fn = fn;
+	q->poll_delay = -1;
+	queue_flag_set_unlocked(QUEUE_FLAG_POLL, q);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(blk_queue_poll_fn);
+
+void blk_poll_free(struct request_queue *q)
+{
+	free_percpu(q->poll_stats);
+	q->poll_stats = NULL;
+}
+
+/**
+ * blk_poll - reap completed requests without waiting for an interrupt
+ * @q: the queue to poll
+ *
+ * Returns the number of requests the driver completed, which may be
+ * requests of other tasks.
+ */
+int blk_poll(struct request_queue *q)
+{
+	int ret;
+
+	if (!q->poll_fn || !blk_queue_poll(q))
+		return 0;
+
+	ret = q->poll_fn(q);
+
+	this_cpu_inc(q->poll_stats->invoked);
+	if (ret > 0)
+		this_cpu_inc(q->poll_stats->success);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(blk_poll);
+
+/**
+ * blk_poll_sleep - sleep through part of the service time of an I/O
+ * @q:      the queue the I/O was issued to
+ * @rw:     data direction of the I/O
+ * @issued: ktime_get() at submission, in nanoseconds
+ *
+ * Called by a polling waiter before it starts to spin.  The sleep is
+ * shortened by the time that already passed since the I/O was issued.
+ * Returns true if the caller slept.
+ */
+bool blk_poll_sleep(struct request_queue *q, int rw, u64 issued)
+{
+	struct hrtimer_sleeper hs;
+	int delay = ACCESS_ONCE(q->poll_delay);
+	u64 nsecs, elapsed;
+
+	if (delay < 0 || !blk_queue_poll(q))
+		return false;
+
+	if (delay > 0)
+		nsecs = (u64)delay * NSEC_PER_USEC;
+	else
+		nsecs = ACCESS_ONCE(q->poll_nsec[rw & WRITE]) / 2;
+
+	elapsed = ktime_to_ns(ktime_get()) - issued;
+	if (nsecs <= elapsed)
+		return false;
+	nsecs -= elapsed;
+
+	hrtimer_init_on_stack(&hs.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	hrtimer_init_sleeper(&hs, current);
+	hrtimer_set_expires(&hs.timer, ns_to_ktime(nsecs));
+
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	hrtimer_start_expires(&hs.timer, HRTIMER_MODE_REL);
+	if (hs.task)
+		io_schedule();
+	hrtimer_cancel(&hs.timer);
+	__set_current_state(TASK_RUNNING);
+	destroy_hrtimer_on_stack(&hs.timer);
+
+	this_cpu_inc(q->poll_stats->sleeps);
+	return true;
+}
+EXPORT_SYMBOL_GPL(blk_poll_sleep);
+
+/**
+ * blk_poll_account - record the completion time of a polled I/O
+ * @q:      the queue the I/O was issued to
+ * @rw:     data direction of the I/O
+ * @issued: ktime_get() at submission, in nanoseconds
+ *
+ * Feeds the running mean that adaptive hybrid polling sleeps against.
+ * Updates are racy, the mean is only a hint.
+ */
+void blk_poll_account(struct request_queue *q, int rw, u64 issued)
+{
+	unsigned long sample = ktime_to_ns(ktime_get()) - issued;
+	unsigned long mean = q->poll_nsec[rw & WRITE];
+
+	/* exponentially weighted, new samples count 1/8 */
+	if (mean)
+		sample = mean - (mean >> 3) + (sample >> 3);
+	q->poll_nsec[rw & WRITE] = sample;
+
+	this_cpu_inc(q->poll_stats->polled);
+}
+EXPORT_SYMBOL_GPL(blk_poll_account);
@@ -20,6 +20,27 @@ void __blk_queue_free_tags(struct request_queue *q);
 bool __blk_end_bidi_request(struct request *rq, int error,
 			    unsigned int nr_bytes, unsigned int bidi_bytes);
 
+void drive_stat_acct(struct request *rq, int new_io);
+void blk_account_io_done(struct request *req);
+bool bio_attempt_back_merge(struct request_queue *q, struct request *req,
+			    struct bio *bio);
+bool bio_attempt_front_merge(struct request_queue *q, struct request *req,
+			     struct bio *bio);
+bool attempt_plug_merge(struct task_struct *tsk, struct request_queue *q,
+			struct bio *bio);
+
+/*
+ * Per-cpu polling statistics, shown in the io_poll_stats sysfs file
+ */
+struct blk_poll_stats {
+	unsigned long	polled;		/* I/Os waited for by polling */
+	unsigned long	invoked;	/* calls into ->poll_fn */
+	unsigned long	success;	/* ... that found completed requests */
+	unsigned long	sleeps;		/* hybrid sleeps before polling */
+};
+
+void blk_poll_free(struct request_queue *q);
+
 void blk_rq_timed_out_timer(unsigned long data);
 void blk_delete_timer(struct request *);
 void blk_add_timer(struct request *);
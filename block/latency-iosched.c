@@ -0,0 +1,744 @@
+/*
+ *  Latency target I/O scheduler
+ *
+ *  Meant for devices without a seek penalty.  Requests are queued per
+ *  group, one group per blkio cgroup, and dispatched earliest deadline
+ *  first, the deadline of a request being its arrival time plus the read
+ *  or write latency target of its group.  There is no sorting and no
+ *  idling: whenever the driver asks for a request and some group may
+ *  dispatch, it gets one.
+ *
+ *  What a group may dispatch is limited by its depth, the number of its
+ *  requests allowed in the driver at once.  Completion latencies are
+ *  averaged per group over a window; when a group misses its target, the
+ *  depth of every group with a looser target is halved.  Windows without a
+ *  miss let the depths grow back.
+ *
+ *  See Documentation/block/latency-iosched.txt
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/rcupdate.h>
+#include "blk-cgroup.h"
+
+/*
+ * tunables, in usecs except for the window
+ */
+static const unsigned int read_target = 2000;	/* default read target */
+static const unsigned int write_target = 10000;	/* default write target */
+static const unsigned int window = 50;		/* msecs between depth updates */
+
+struct lat_group {
+	/* requests waiting for dispatch, in arrival order */
+	struct list_head fifo[2];
+	unsigned int nr_queued;
+	/* on lat_data->active_list while requests are queued */
+	struct list_head active_node;
+	/* on lat_data->group_list until the group is destroyed */
+	struct list_head group_node;
+
+	/* requests in the driver, and how many the group may have there */
+	unsigned int inflight;
+	unsigned int depth;
+
+	/* latency targets set by the cgroup, 0 uses the queue default */
+	unsigned int target[2];
+
+	/* completion latencies seen in the current window */
+	u64 lat_sum[2];
+	unsigned int lat_nr[2];
+
+	int ref;
+#ifdef CONFIG_LATENCY_GROUP_IOSCHED
+	struct blkio_group blkg;
+#endif
+};
+
+struct lat_data {
+	struct request_queue *queue;
+
+	struct lat_group root_group;
+	struct list_head group_list;
+	/* groups with queued requests */
+	struct list_head active_list;
+	unsigned int nr_queued;
+
+	/* dispatch was refused because of group depths */
+	bool throttled;
+	struct work_struct unplug_work;
+	unsigned long window_start;
+	unsigned int nr_blkcg_linked_grps;
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	unsigned int target[2];
+	unsigned int window;
+	unsigned int max_depth;
+};
+
+#define RQ_LG(rq)	((struct lat_group *) (rq)->elevator_private[0])
+#define RQ_ARRIVAL(rq)	((unsigned long) (rq)->elevator_private[1])
+
+/* usecs; only differences are used, so wrapping on 32bit is fine */
+static inline unsigned long lat_now(void)
+{
+	return (unsigned long) ktime_to_us(ktime_get());
+}
+
+static inline unsigned int
+lat_group_target(struct lat_data *ld, struct lat_group *lg, int dir)
+{
+	return lg->target[dir] ? lg->target[dir] : ld->target[dir];
+}
+
+static inline unsigned long lat_deadline(struct lat_data *ld, struct request *rq)
+{
+	return RQ_ARRIVAL(rq) + lat_group_target(ld, RQ_LG(rq), rq_data_dir(rq));
+}
+
+static void lat_init_group(struct lat_data *ld, struct lat_group *lg)
+{
+	INIT_LIST_HEAD(&lg->fifo[READ]);
+	INIT_LIST_HEAD(&lg->fifo[WRITE]);
+	INIT_LIST_HEAD(&lg->active_node);
+	INIT_LIST_HEAD(&lg->group_node);
+	lg->depth = ld->max_depth;
+}
+
+static void lat_put_group(struct lat_group *lg)
+{
+	BUG_ON(lg->ref <= 0);
+	lg->ref--;
+	if (lg->ref)
+		return;
+	BUG_ON(lg->nr_queued || lg->inflight);
+#ifdef CONFIG_LATENCY_GROUP_IOSCHED
+	free_percpu(lg->blkg.stats_cpu);
+#endif
+	kfree(lg);
+}
+
+#ifdef CONFIG_LATENCY_GROUP_IOSCHED
+static inline struct lat_group *lg_of_blkg(struct blkio_group *blkg)
+{
+	if (blkg)
+		return container_of(blkg, struct lat_group, blkg);
+	return NULL;
+}
+
+static void lat_update_group_read_target(void *key, struct blkio_group *blkg,
+					 unsigned int target)
+{
+	lg_of_blkg(blkg)->target[READ] = target;
+}
+
+static void lat_update_group_write_target(void *key, struct blkio_group *blkg,
+					  unsigned int target)
+{
+	lg_of_blkg(blkg)->target[WRITE] = target;
+}
+
+static void lat_init_add_group_lists(struct lat_data *ld, struct lat_group *lg,
+				     struct blkio_cgroup *blkcg)
+{
+	struct backing_dev_info *bdi = &ld->queue->backing_dev_info;
+	unsigned int major, minor;
+
+	/*
+	 * bdi->dev may not be set up yet, in which case the group gets its
+	 * dev (and with it its targets) filled in on a later lookup.
+	 */
+	if (bdi->dev) {
+		sscanf(dev_name(bdi->dev), "%u:%u", &major, &minor);
+		blkiocg_add_blkio_group(blkcg, &lg->blkg, (void *)ld,
+					MKDEV(major, minor),
+					BLKIO_POLICY_LATENCY);
+	} else
+		blkiocg_add_blkio_group(blkcg, &lg->blkg, (void *)ld, 0,
+					BLKIO_POLICY_LATENCY);
+
+	ld->nr_blkcg_linked_grps++;
+	lg->target[READ] = blkcg_get_read_target(blkcg, lg->blkg.dev);
+	lg->target[WRITE] = blkcg_get_write_target(blkcg, lg->blkg.dev);
+
+	list_add(&lg->group_node, &ld->group_list);
+}
+
+/*
+ * Should be called from sleepable context, allocating the per cpu stats
+ * can block.
+ */
+static struct lat_group *lat_alloc_group(struct lat_data *ld)
+{
+	struct lat_group *lg;
+
+	lg = kzalloc_node(sizeof(*lg), GFP_KERNEL, ld->queue->node);
+	if (!lg)
+		return NULL;
+
+	lat_init_group(ld, lg);
+
+	/*
+	 * Initial reference, dropped by whichever of cgroup removal and
+	 * elevator exit gets to the group first.
+	 */
+	lg->ref = 1;
+
+	if (blkio_alloc_blkg_stats(&lg->blkg)) {
+		kfree(lg);
+		return NULL;
+	}
+
+	return lg;
+}
+
+static struct lat_group *
+lat_find_group(struct lat_data *ld, struct blkio_cgroup *blkcg)
+{
+	struct lat_group *lg;
+	struct backing_dev_info *bdi = &ld->queue->backing_dev_info;
+	unsigned int major, minor;
+
+	/* common case when there are no blkio cgroups */
+	if (blkcg == &blkio_root_cgroup)
+		lg = &ld->root_group;
+	else
+		lg = lg_of_blkg(blkiocg_lookup_group(blkcg, (void *)ld));
+
+	if (lg && !lg->blkg.dev && bdi->dev && dev_name(bdi->dev)) {
+		sscanf(dev_name(bdi->dev), "%u:%u", &major, &minor);
+		lg->blkg.dev = MKDEV(major, minor);
+		lg->target[READ] = blkcg_get_read_target(blkcg, lg->blkg.dev);
+		lg->target[WRITE] = blkcg_get_write_target(blkcg, lg->blkg.dev);
+	}
+
+	return lg;
+}
+
+/*
+ * Find the group of the current task, allocating it if it does not exist
+ * and @gfp_mask allows us to sleep.  Otherwise the I/O is charged to the
+ * root group.  Must be called with the queue lock held.
+ */
+static struct lat_group *lat_get_group(struct lat_data *ld, gfp_t gfp_mask)
+{
+	struct request_queue *q = ld->queue;
+	struct blkio_cgroup *blkcg;
+	struct lat_group *lg, *__lg;
+
+	rcu_read_lock();
+	blkcg = task_blkio_cgroup(current);
+	lg = lat_find_group(ld, blkcg);
+	if (lg || !(gfp_mask & __GFP_WAIT)) {
+		rcu_read_unlock();
+		return lg ? lg : &ld->root_group;
+	}
+	rcu_read_unlock();
+
+	/*
+	 * Drop the queue lock to allocate.  As in CFQ, the queue is assumed
+	 * to stay around; our caller holds a request allocation on it.
+	 */
+	spin_unlock_irq(q->queue_lock);
+	lg = lat_alloc_group(ld);
+	spin_lock_irq(q->queue_lock);
+
+	rcu_read_lock();
+	blkcg = task_blkio_cgroup(current);
+
+	/* someone else may have set up the group in the meantime */
+	__lg = lat_find_group(ld, blkcg);
+	if (__lg) {
+		if (lg)
+			lat_put_group(lg);
+		rcu_read_unlock();
+		return __lg;
+	}
+
+	if (!lg) {
+		rcu_read_unlock();
+		return &ld->root_group;
+	}
+
+	lat_init_add_group_lists(ld, lg, blkcg);
+	rcu_read_unlock();
+	return lg;
+}
+
+static int lat_allow_merge(struct request_queue *q, struct request *rq,
+			   struct bio *bio)
+{
+	struct lat_data *ld = q->elevator->elevator_data;
+	struct lat_group *lg;
+
+	/* do not let a bio ride on a request of another group */
+	rcu_read_lock();
+	lg = lat_find_group(ld, task_blkio_cgroup(current));
+	rcu_read_unlock();
+
+	return (lg ? lg : &ld->root_group) == RQ_LG(rq);
+}
+
+static void lat_destroy_group(struct lat_data *ld, struct lat_group *lg)
+{
+	/* Something wrong if we are trying to remove same group twice */
+	BUG_ON(list_empty(&lg->group_node));
+
+	list_del_init(&lg->group_node);
+
+	BUG_ON(!ld->nr_blkcg_linked_grps);
+	ld->nr_blkcg_linked_grps--;
+
+	/* requests still queued or in flight hold their own references */
+	lat_put_group(lg);
+}
+
+static void lat_release_groups(struct lat_data *ld)
+{
+	struct lat_group *lg, *n;
+
+	list_for_each_entry_safe(lg, n, &ld->group_list, group_node) {
+		/*
+		 * If the cgroup removal path got to the blkio_group first,
+		 * it takes care of destroying the group.
+		 */
+		if (!blkiocg_del_blkio_group(&lg->blkg))
+			lat_destroy_group(ld, lg);
+	}
+}
+
+/*
+ * The cgroup of @blkg is going away, no new I/O will be charged to the
+ * group.  Called under rcu_read_lock(), which keeps @key, our lat_data,
+ * valid.
+ */
+static void lat_unlink_blkio_group(void *key, struct blkio_group *blkg)
+{
+	struct lat_data *ld = key;
+	unsigned long flags;
+
+	spin_lock_irqsave(ld->queue->queue_lock, flags);
+	lat_destroy_group(ld, lg_of_blkg(blkg));
+	spin_unlock_irqrestore(ld->queue->queue_lock, flags);
+}
+
+static inline void lat_update_dispatch_stats(struct lat_group *lg,
+					     struct request *rq)
+{
+	blkiocg_update_dispatch_stats(&lg->blkg, blk_rq_bytes(rq),
+				      rq_data_dir(rq), rq_is_sync(rq));
+}
+
+static inline void lat_update_completion_stats(struct lat_group *lg,
+					       struct request *rq)
+{
+	blkiocg_update_completion_stats(&lg->blkg, rq_start_time_ns(rq),
+					rq_io_start_time_ns(rq),
+					rq_data_dir(rq), rq_is_sync(rq));
+}
+
+#else /* LATENCY_GROUP_IOSCHED */
+static struct lat_group *lat_get_group(struct lat_data *ld, gfp_t gfp_mask)
+{
+	return &ld->root_group;
+}
+
+static void lat_release_groups(struct lat_data *ld) {}
+
+static inline void lat_update_dispatch_stats(struct lat_group *lg,
+					     struct request *rq) {}
+static inline void lat_update_completion_stats(struct lat_group *lg,
+					       struct request *rq) {}
+#endif /* LATENCY_GROUP_IOSCHED */
+
+/*
+ * Evaluate the window that just ended.  If some group missed its target,
+ * throttle every group whose target in that direction is looser than the
+ * tightest target missed.  Otherwise let the depths recover.
+ */
+static void lat_update_depths(struct lat_data *ld)
+{
+	struct lat_group *lg, *missed_lg = NULL;
+	unsigned int missed = UINT_MAX, target, depth;
+	int dir, missed_dir = READ;
+	u64 mean;
+
+	if (time_before(jiffies, ld->window_start +
+			msecs_to_jiffies(ld->window)))
+		return;
+	ld->window_start = jiffies;
+
+	list_for_each_entry(lg, &ld->group_list, group_node) {
+		for (dir = READ; dir <= WRITE; dir++) {
+			if (!lg->lat_nr[dir])
+				continue;
+
+			mean = div_u64(lg->lat_sum[dir], lg->lat_nr[dir]);
+			target = lat_group_target(ld, lg, dir);
+			if (mean > target && target < missed) {
+				missed = target;
+				missed_dir = dir;
+				missed_lg = lg;
+			}
+			lg->lat_sum[dir] = 0;
+			lg->lat_nr[dir] = 0;
+		}
+	}
+
+	list_for_each_entry(lg, &ld->group_list, group_node) {
+		if (missed_lg) {
+			if (lg != missed_lg &&
+			    lat_group_target(ld, lg, missed_dir) > missed)
+				lg->depth = max(lg->depth / 2, 1U);
+		} else {
+			depth = lg->depth + max(lg->depth / 4, 1U);
+			lg->depth = min(depth, ld->max_depth);
+		}
+	}
+}
+
+static void lat_kick_queue(struct work_struct *work)
+{
+	struct lat_data *ld = container_of(work, struct lat_data, unplug_work);
+	struct request_queue *q = ld->queue;
+
+	spin_lock_irq(q->queue_lock);
+	__blk_run_queue(q);
+	spin_unlock_irq(q->queue_lock);
+}
+
+static void lat_remove_request(struct lat_data *ld, struct request *rq)
+{
+	struct lat_group *lg = RQ_LG(rq);
+
+	rq_fifo_clear(rq);
+	if (!--lg->nr_queued)
+		list_del_init(&lg->active_node);
+	ld->nr_queued--;
+}
+
+static void lat_add_request(struct request_queue *q, struct request *rq)
+{
+	struct lat_data *ld = q->elevator->elevator_data;
+	struct lat_group *lg = RQ_LG(rq);
+
+	rq->elevator_private[1] = (void *) lat_now();
+	list_add_tail(&rq->queuelist, &lg->fifo[rq_data_dir(rq)]);
+
+	if (!lg->nr_queued++)
+		list_add_tail(&lg->active_node, &ld->active_list);
+	ld->nr_queued++;
+}
+
+static void lat_merged_requests(struct request_queue *q, struct request *rq,
+				struct request *next)
+{
+	struct lat_data *ld = q->elevator->elevator_data;
+
+	/*
+	 * Keep the earlier arrival time, and with it the place in the fifo.
+	 * Requests of different groups can be merged here, rq keeps its own
+	 * group then.
+	 */
+	if (RQ_LG(rq) == RQ_LG(next) &&
+	    rq_data_dir(rq) == rq_data_dir(next) &&
+	    time_before(RQ_ARRIVAL(next), RQ_ARRIVAL(rq))) {
+		list_move(&rq->queuelist, &next->queuelist);
+		rq->elevator_private[1] = next->elevator_private[1];
+	}
+
+	lat_remove_request(ld, next);
+}
+
+/*
+ * Move the request with the earliest deadline among the groups that are
+ * below their depth to the dispatch queue.
+ */
+static int lat_dispatch_requests(struct request_queue *q, int force)
+{
+	struct lat_data *ld = q->elevator->elevator_data;
+	struct request *rq = NULL, *__rq;
+	struct lat_group *lg;
+	int dir;
+
+	if (!ld->nr_queued)
+		return 0;
+
+	lat_update_depths(ld);
+
+	list_for_each_entry(lg, &ld->active_list, active_node) {
+		if (!force && lg->inflight >= lg->depth)
+			continue;
+
+		for (dir = READ; dir <= WRITE; dir++) {
+			if (list_empty(&lg->fifo[dir]))
+				continue;
+			__rq = rq_entry_fifo(lg->fifo[dir].next);
+			if (!rq || time_before(lat_deadline(ld, __rq),
+					       lat_deadline(ld, rq)))
+				rq = __rq;
+		}
+	}
+
+	if (!rq) {
+		/* completions will kick the queue once a group may go on */
+		ld->throttled = true;
+		return 0;
+	}
+
+	lg = RQ_LG(rq);
+	lat_remove_request(ld, rq);
+	lg->inflight++;
+	lat_update_dispatch_stats(lg, rq);
+	elv_dispatch_add_tail(q, rq);
+	return 1;
+}
+
+static void lat_completed_request(struct request_queue *q, struct request *rq)
+{
+	struct lat_data *ld = q->elevator->elevator_data;
+	struct lat_group *lg = RQ_LG(rq);
+	const int dir = rq_data_dir(rq);
+
+	WARN_ON(!lg->inflight);
+	lg->inflight--;
+	lg->lat_sum[dir] += lat_now() - RQ_ARRIVAL(rq);
+	lg->lat_nr[dir]++;
+	lat_update_completion_stats(lg, rq);
+
+	lat_update_depths(ld);
+
+	if (ld->throttled && ld->nr_queued) {
+		ld->throttled = false;
+		kblockd_schedule_work(q, &ld->unplug_work);
+	}
+}
+
+static int
+lat_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
+{
+	struct lat_data *ld = q->elevator->elevator_data;
+	struct lat_group *lg;
+
+	might_sleep_if(gfp_mask & __GFP_WAIT);
+
+	spin_lock_irq(q->queue_lock);
+	lg = lat_get_group(ld, gfp_mask);
+	lg->ref++;
+	rq->elevator_private[0] = lg;
+	spin_unlock_irq(q->queue_lock);
+
+	return 0;
+}
+
+static void lat_put_request(struct request *rq)
+{
+	struct lat_group *lg = RQ_LG(rq);
+
+	if (lg) {
+		rq->elevator_private[0] = NULL;
+		lat_put_group(lg);
+	}
+}
+
+static void lat_exit_queue(struct elevator_queue *e)
+{
+	struct lat_data *ld = e->elevator_data;
+	struct request_queue *q = ld->queue;
+	bool wait = false;
+
+	cancel_work_sync(&ld->unplug_work);
+
+	spin_lock_irq(q->queue_lock);
+	lat_release_groups(ld);
+
+	/*
+	 * Groups the cgroup removal path claimed may still be looked up
+	 * under rcu.
+	 */
+	if (ld->nr_blkcg_linked_grps)
+		wait = true;
+	spin_unlock_irq(q->queue_lock);
+
+	/*
+	 * Not unconditional: some drivers create and delete queues hundreds
+	 * of times during boot.
+	 */
+	if (wait)
+		synchronize_rcu();
+
+#ifdef CONFIG_LATENCY_GROUP_IOSCHED
+	free_percpu(ld->root_group.blkg.stats_cpu);
+#endif
+	kfree(ld);
+}
+
+static void *lat_init_queue(struct request_queue *q)
+{
+	struct lat_data *ld;
+	struct lat_group *lg;
+
+	ld = kmalloc_node(sizeof(*ld), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!ld)
+		return NULL;
+
+	ld->queue = q;
+	ld->target[READ] = read_target;
+	ld->target[WRITE] = write_target;
+	ld->window = window;
+	ld->max_depth = q->nr_requests;
+	ld->window_start = jiffies;
+	INIT_LIST_HEAD(&ld->group_list);
+	INIT_LIST_HEAD(&ld->active_list);
+	INIT_WORK(&ld->unplug_work, lat_kick_queue);
+
+	lg = &ld->root_group;
+	lat_init_group(ld, lg);
+
+	/*
+	 * One reference is dropped when the groups are released on exit,
+	 * the other stays as the root group is embedded in lat_data.
+	 */
+	lg->ref = 2;
+
+#ifdef CONFIG_LATENCY_GROUP_IOSCHED
+	if (blkio_alloc_blkg_stats(&lg->blkg)) {
+		kfree(ld);
+		return NULL;
+	}
+
+	rcu_read_lock();
+	blkiocg_add_blkio_group(&blkio_root_cgroup, &lg->blkg, (void *)ld, 0,
+				BLKIO_POLICY_LATENCY);
+	rcu_read_unlock();
+	ld->nr_blkcg_linked_grps++;
+#endif
+	list_add(&lg->group_node, &ld->group_list);
+
+	return ld;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+lat_var_show(unsigned int var, char *page)
+{
+	return sprintf(page, "%u\n", var);
+}
+
+static ssize_t
+lat_var_store(unsigned int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtoul(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR)					\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct lat_data *ld = e->elevator_data;				\
+	return lat_var_show(__VAR, (page));				\
+}
+SHOW_FUNCTION(lat_read_target_show, ld->target[READ]);
+SHOW_FUNCTION(lat_write_target_show, ld->target[WRITE]);
+SHOW_FUNCTION(lat_window_show, ld->window);
+SHOW_FUNCTION(lat_max_depth_show, ld->max_depth);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)				\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct lat_data *ld = e->elevator_data;				\
+	unsigned int __data;						\
+	int ret = lat_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	*(__PTR) = __data;						\
+	return ret;							\
+}
+STORE_FUNCTION(lat_read_target_store, &ld->target[READ], 1, UINT_MAX);
+STORE_FUNCTION(lat_write_target_store, &ld->target[WRITE], 1, UINT_MAX);
+STORE_FUNCTION(lat_window_store, &ld->window, 1, UINT_MAX);
+STORE_FUNCTION(lat_max_depth_store, &ld->max_depth, 1, UINT_MAX);
+#undef STORE_FUNCTION
+
+#define LAT_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, lat_##name##_show, \
+				      lat_##name##_store)
+
+static struct elv_fs_entry lat_attrs[] = {
+	LAT_ATTR(read_target),
+	LAT_ATTR(write_target),
+	LAT_ATTR(window),
+	LAT_ATTR(max_depth),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_latency = {
+	.ops = {
+		.elevator_merge_req_fn =	lat_merged_requests,
+#ifdef CONFIG_LATENCY_GROUP_IOSCHED
+		.elevator_allow_merge_fn =	lat_allow_merge,
+#endif
+		.elevator_dispatch_fn =		lat_dispatch_requests,
+		.elevator_add_req_fn =		lat_add_request,
+		.elevator_completed_req_fn =	lat_completed_request,
+		.elevator_set_req_fn =		lat_set_request,
+		.elevator_put_req_fn =		lat_put_request,
+		.elevator_init_fn =		lat_init_queue,
+		.elevator_exit_fn =		lat_exit_queue,
+	},
+
+	.elevator_attrs = lat_attrs,
+	.elevator_name = "latency",
+	.elevator_owner = THIS_MODULE,
+};
+
+#ifdef CONFIG_LATENCY_GROUP_IOSCHED
+static struct blkio_policy_type blkio_policy_latency = {
+	.ops = {
+		.blkio_unlink_group_fn =	lat_unlink_blkio_group,
+		.blkio_update_group_read_target_fn =
+						lat_update_group_read_target,
+		.blkio_update_group_write_target_fn =
+						lat_update_group_write_target,
+	},
+	.plid = BLKIO_POLICY_LATENCY,
+};
+#else
+static struct blkio_policy_type blkio_policy_latency;
+#endif
+
+static int __init lat_init(void)
+{
+	elv_register(&iosched_latency);
+	blkio_policy_register(&blkio_policy_latency);
+
+	return 0;
+}
+
+static void __exit lat_exit(void)
+{
+	blkio_policy_unregister(&blkio_policy_latency);
+	elv_unregister(&iosched_latency);
+}
+
+module_init(lat_init);
+module_exit(lat_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Latency target IO scheduler");
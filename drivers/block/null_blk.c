@@ -0,0 +1,557 @@
+/*
+ * Null block device driver
+ *
+ * A block device that does no I/O at all: every bio or request is
+ * completed without touching its data.  This leaves only the cost of the
+ * block layer itself, which makes the driver useful for measuring changes
+ * to request handling, the elevators, plugging and the multiqueue code.
+ *
+ * The driver can sit on top of the bio interface, the request_fn
+ * interface or the multiqueue interface (queue_mode), and can complete
+ * I/O inline, from softirq context or from a timer firing after a
+ * configurable delay (irqmode, completion_nsec).  In timer mode the
+ * queue can also be polled for completions that are due.
+ */
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/bio.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+
+struct nullb_cmd {
+	struct list_head list;
+	struct request *rq;
+	struct bio *bio;
+	unsigned int tag;
+	struct nullb *nullb;
+	u64 deadline;		/* timer mode completion time, in ns */
+};
+
+struct nullb {
+	struct list_head list;
+	unsigned int index;
+	struct request_queue *q;
+	struct gendisk *disk;
+
+	/* bio and request_fn modes; multiqueue keeps cmds in the request */
+	struct nullb_cmd *cmds;
+	unsigned int queue_depth;
+
+	/* bio mode tag allocation */
+	unsigned long *tag_map;
+	wait_queue_head_t tag_wait;
+
+	/* request_fn mode ran out of tags, rerun the queue on completion */
+	bool tag_starved;
+};
+
+/*
+ * Per-cpu list of commands waiting for the softirq or timer completion.
+ */
+struct nullb_completion_queue {
+	spinlock_t lock;
+	struct list_head list;
+	struct hrtimer timer;
+	struct tasklet_struct tasklet;
+};
+
+static DEFINE_PER_CPU(struct nullb_completion_queue, completion_queues);
+
+static LIST_HEAD(nullb_list);
+static DEFINE_MUTEX(nullb_lock);
+static int null_major;
+static int nullb_indexes;
+
+enum {
+	NULL_IRQ_NONE		= 0,
+	NULL_IRQ_SOFTIRQ	= 1,
+	NULL_IRQ_TIMER		= 2,
+};
+
+enum {
+	NULL_Q_BIO		= 0,
+	NULL_Q_RQ		= 1,
+	NULL_Q_MQ		= 2,
+};
+
+static int submit_queues;
+module_param(submit_queues, int, S_IRUGO);
+MODULE_PARM_DESC(submit_queues, "Number of submission queues with queue_mode=2 (default: one per CPU)");
+
+static int home_node = NUMA_NO_NODE;
+module_param(home_node, int, S_IRUGO);
+MODULE_PARM_DESC(home_node, "Home node for the device");
+
+static int queue_mode = NULL_Q_MQ;
+module_param(queue_mode, int, S_IRUGO);
+MODULE_PARM_DESC(queue_mode, "Block interface to use (0=bio,1=rq,2=multiqueue)");
+
+static int gb = 250;
+module_param(gb, int, S_IRUGO);
+MODULE_PARM_DESC(gb, "Size in GB");
+
+static int bs = 512;
+module_param(bs, int, S_IRUGO);
+MODULE_PARM_DESC(bs, "Block size (in bytes)");
+
+static int nr_devices = 2;
+module_param(nr_devices, int, S_IRUGO);
+MODULE_PARM_DESC(nr_devices, "Number of devices to register");
+
+static int irqmode = NULL_IRQ_SOFTIRQ;
+module_param(irqmode, int, S_IRUGO);
+MODULE_PARM_DESC(irqmode, "IRQ completion handler. 0-none, 1-softirq, 2-timer");
+
+static int completion_nsec = 10000;
+module_param(completion_nsec, int, S_IRUGO);
+MODULE_PARM_DESC(completion_nsec, "Time in ns to complete a request in hardware. Default: 10,000ns");
+
+static int hw_queue_depth = 64;
+module_param(hw_queue_depth, int, S_IRUGO);
+MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 64");
+
+static struct nullb_cmd *alloc_cmd(struct nullb *nullb)
+{
+	DEFINE_WAIT(wait);
+	unsigned int tag;
+
+	do {
+		prepare_to_wait(&nullb->tag_wait, &wait, TASK_UNINTERRUPTIBLE);
+		tag = find_first_zero_bit(nullb->tag_map, nullb->queue_depth);
+		if (tag < nullb->queue_depth &&
+		    !test_and_set_bit_lock(tag, nullb->tag_map))
+			break;
+		if (tag >= nullb->queue_depth)
+			io_schedule();
+	} while (1);
+	finish_wait(&nullb->tag_wait, &wait);
+
+	return &nullb->cmds[tag];
+}
+
+static void free_cmd(struct nullb_cmd *cmd)
+{
+	struct nullb *nullb = cmd->nullb;
+
+	clear_bit_unlock(cmd->tag, nullb->tag_map);
+	smp_mb__after_clear_bit();
+	if (waitqueue_active(&nullb->tag_wait))
+		wake_up(&nullb->tag_wait);
+}
+
+static void end_cmd(struct nullb_cmd *cmd)
+{
+	struct request_queue *q;
+	unsigned long flags;
+
+	switch (queue_mode) {
+	case NULL_Q_MQ:
+		blk_mq_end_io(cmd->rq, 0);
+		break;
+	case NULL_Q_RQ:
+		q = cmd->rq->q;
+		spin_lock_irqsave(q->queue_lock, flags);
+		__blk_end_request_all(cmd->rq, 0);
+		if (cmd->nullb->tag_starved) {
+			cmd->nullb->tag_starved = false;
+			blk_run_queue_async(q);
+		}
+		spin_unlock_irqrestore(q->queue_lock, flags);
+		break;
+	case NULL_Q_BIO:
+		bio_endio(cmd->bio, 0);
+		free_cmd(cmd);
+		break;
+	}
+}
+
+static void null_complete_list(struct nullb_completion_queue *cq)
+{
+	struct nullb_cmd *cmd, *next;
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&cq->lock, flags);
+	list_splice_init(&cq->list, &list);
+	spin_unlock_irqrestore(&cq->lock, flags);
+
+	list_for_each_entry_safe(cmd, next, &list, list)
+		end_cmd(cmd);
+}
+
+static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
+{
+	null_complete_list(container_of(timer, struct nullb_completion_queue,
+					timer));
+	return HRTIMER_NORESTART;
+}
+
+static void null_cmd_tasklet(unsigned long data)
+{
+	null_complete_list((struct nullb_completion_queue *) data);
+}
+
+/*
+ * Queue @cmd for deferred completion on this CPU.  In timer mode the
+ * timer is armed by the first command on an empty list, so commands
+ * arriving while it is pending complete together with that one.
+ */
+static void null_cmd_defer(struct nullb_cmd *cmd, bool timer)
+{
+	struct nullb_completion_queue *cq = &get_cpu_var(completion_queues);
+	unsigned long flags;
+	bool first;
+
+	if (timer)
+		cmd->deadline = ktime_to_ns(ktime_get()) + completion_nsec;
+
+	spin_lock_irqsave(&cq->lock, flags);
+	first = list_empty(&cq->list);
+	list_add_tail(&cmd->list, &cq->list);
+	spin_unlock_irqrestore(&cq->lock, flags);
+
+	if (!timer)
+		tasklet_schedule(&cq->tasklet);
+	else if (first)
+		hrtimer_start(&cq->timer, ktime_set(0, completion_nsec),
+			      HRTIMER_MODE_REL);
+
+	put_cpu_var(completion_queues);
+}
+
+/*
+ * Timer mode supports polling: complete the commands queued on this CPU
+ * whose completion time has passed without waiting for the timer.
+ */
+static int null_poll_completions(void)
+{
+	struct nullb_completion_queue *cq = &get_cpu_var(completion_queues);
+	u64 now = ktime_to_ns(ktime_get());
+	struct nullb_cmd *cmd, *next;
+	unsigned long flags;
+	LIST_HEAD(list);
+	int nr = 0;
+
+	spin_lock_irqsave(&cq->lock, flags);
+	list_for_each_entry_safe(cmd, next, &cq->list, list) {
+		if (cmd->deadline > now)
+			break;
+		list_move_tail(&cmd->list, &list);
+	}
+	spin_unlock_irqrestore(&cq->lock, flags);
+
+	list_for_each_entry_safe(cmd, next, &list, list) {
+		end_cmd(cmd);
+		nr++;
+	}
+
+	put_cpu_var(completion_queues);
+	return nr;
+}
+
+static int null_poll_queue(struct request_queue *q)
+{
+	return null_poll_completions();
+}
+
+static int null_poll_hctx(struct blk_mq_hw_ctx *hctx)
+{
+	return null_poll_completions();
+}
+
+static void null_softirq_done_fn(struct request *rq)
+{
+	end_cmd(rq->special);
+}
+
+static void null_handle_cmd(struct nullb_cmd *cmd)
+{
+	switch (irqmode) {
+	case NULL_IRQ_NONE:
+		end_cmd(cmd);
+		break;
+	case NULL_IRQ_SOFTIRQ:
+		/* request_fn mode has the block layer's own softirq for this */
+		if (queue_mode == NULL_Q_RQ)
+			blk_complete_request(cmd->rq);
+		else
+			null_cmd_defer(cmd, false);
+		break;
+	case NULL_IRQ_TIMER:
+		null_cmd_defer(cmd, true);
+		break;
+	}
+}
+
+static int null_queue_bio(struct request_queue *q, struct bio *bio)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_cmd *cmd;
+
+	cmd = alloc_cmd(nullb);
+	cmd->bio = bio;
+
+	null_handle_cmd(cmd);
+	return 0;
+}
+
+static void null_request_fn(struct request_queue *q)
+{
+	struct nullb *nullb = q->queuedata;
+	struct request *rq;
+
+	while ((rq = blk_peek_request(q)) != NULL) {
+		struct nullb_cmd *cmd;
+
+		if (blk_queue_start_tag(q, rq)) {
+			/* restarted when a tag is freed in end_cmd() */
+			nullb->tag_starved = true;
+			break;
+		}
+
+		cmd = &nullb->cmds[rq->tag];
+		cmd->rq = rq;
+		rq->special = cmd;
+
+		spin_unlock_irq(q->queue_lock);
+		null_handle_cmd(cmd);
+		spin_lock_irq(q->queue_lock);
+	}
+}
+
+static int null_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *rq)
+{
+	struct nullb_cmd *cmd = blk_mq_rq_to_pdu(rq);
+
+	cmd->rq = rq;
+	cmd->nullb = hctx->driver_data;
+
+	null_handle_cmd(cmd);
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static struct blk_mq_ops null_mq_ops = {
+	.queue_rq	= null_queue_rq,
+};
+
+static struct blk_mq_reg null_mq_reg = {
+	.ops		= &null_mq_ops,
+	.cmd_size	= sizeof(struct nullb_cmd),
+	.flags		= BLK_MQ_F_SHOULD_MERGE,
+};
+
+static void null_free_cmds(struct nullb *nullb)
+{
+	kfree(nullb->cmds);
+	kfree(nullb->tag_map);
+}
+
+static int null_alloc_cmds(struct nullb *nullb)
+{
+	unsigned int i;
+
+	nullb->queue_depth = hw_queue_depth;
+	nullb->cmds = kzalloc_node(nullb->queue_depth * sizeof(*nullb->cmds),
+				   GFP_KERNEL, home_node);
+	nullb->tag_map = kzalloc_node(BITS_TO_LONGS(nullb->queue_depth) *
+				      sizeof(unsigned long),
+				      GFP_KERNEL, home_node);
+	if (!nullb->cmds || !nullb->tag_map) {
+		null_free_cmds(nullb);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nullb->queue_depth; i++) {
+		nullb->cmds[i].tag = i;
+		nullb->cmds[i].nullb = nullb;
+	}
+	init_waitqueue_head(&nullb->tag_wait);
+	return 0;
+}
+
+static const struct block_device_operations null_fops = {
+	.owner =	THIS_MODULE,
+};
+
+static void null_del_dev(struct nullb *nullb)
+{
+	list_del(&nullb->list);
+
+	del_gendisk(nullb->disk);
+	blk_cleanup_queue(nullb->q);
+	put_disk(nullb->disk);
+	null_free_cmds(nullb);
+	kfree(nullb);
+}
+
+static int null_add_dev(void)
+{
+	struct gendisk *disk;
+	struct nullb *nullb;
+	sector_t size;
+
+	nullb = kzalloc_node(sizeof(*nullb), GFP_KERNEL, home_node);
+	if (!nullb)
+		return -ENOMEM;
+
+	if (queue_mode != NULL_Q_MQ && null_alloc_cmds(nullb))
+		goto out_free_nullb;
+
+	switch (queue_mode) {
+	case NULL_Q_MQ:
+		null_mq_reg.nr_hw_queues = submit_queues;
+		null_mq_reg.queue_depth = hw_queue_depth;
+		null_mq_reg.numa_node = home_node;
+		nullb->q = blk_mq_init_queue(&null_mq_reg, nullb);
+		if (IS_ERR(nullb->q))
+			nullb->q = NULL;
+		break;
+	case NULL_Q_BIO:
+		nullb->q = blk_alloc_queue_node(GFP_KERNEL, home_node);
+		if (nullb->q)
+			blk_queue_make_request(nullb->q, null_queue_bio);
+		break;
+	case NULL_Q_RQ:
+		nullb->q = blk_init_queue_node(null_request_fn, NULL, home_node);
+		if (!nullb->q)
+			break;
+		blk_queue_softirq_done(nullb->q, null_softirq_done_fn);
+		if (blk_queue_init_tags(nullb->q, nullb->queue_depth, NULL)) {
+			blk_cleanup_queue(nullb->q);
+			nullb->q = NULL;
+		}
+		break;
+	}
+	if (!nullb->q)
+		goto out_free_cmds;
+
+	if (irqmode == NULL_IRQ_TIMER && queue_mode != NULL_Q_MQ &&
+	    blk_queue_poll_fn(nullb->q, null_poll_queue))
+		goto out_cleanup_queue;
+
+	nullb->q->queuedata = nullb;
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, nullb->q);
+	blk_queue_logical_block_size(nullb->q, bs);
+	blk_queue_physical_block_size(nullb->q, bs);
+
+	disk = nullb->disk = alloc_disk_node(1, home_node);
+	if (!disk)
+		goto out_cleanup_queue;
+
+	mutex_lock(&nullb_lock);
+	list_add_tail(&nullb->list, &nullb_list);
+	nullb->index = nullb_indexes++;
+	mutex_unlock(&nullb_lock);
+
+	size = gb * 1024 * 1024 * 1024ULL;
+	sector_div(size, bs);
+	set_capacity(disk, size * (bs >> 9));
+
+	disk->flags |= GENHD_FL_EXT_DEVT;
+	disk->major		= null_major;
+	disk->first_minor	= nullb->index;
+	disk->fops		= &null_fops;
+	disk->private_data	= nullb;
+	disk->queue		= nullb->q;
+	sprintf(disk->disk_name, "nullb%d", nullb->index);
+	add_disk(disk);
+	return 0;
+
+out_cleanup_queue:
+	blk_cleanup_queue(nullb->q);
+out_free_cmds:
+	null_free_cmds(nullb);
+out_free_nullb:
+	kfree(nullb);
+	return -ENOMEM;
+}
+
+static void null_del_all(void)
+{
+	struct nullb *nullb;
+
+	mutex_lock(&nullb_lock);
+	while (!list_empty(&nullb_list)) {
+		nullb = list_entry(nullb_list.next, struct nullb, list);
+		null_del_dev(nullb);
+	}
+	mutex_unlock(&nullb_lock);
+}
+
+static int __init null_init(void)
+{
+	unsigned int i;
+
+	if (bs > PAGE_SIZE || bs < 512 || !is_power_of_2(bs)) {
+		pr_warn("null_blk: invalid block size %d\n", bs);
+		pr_warn("null_blk: defaults block size to 512\n");
+		bs = 512;
+	}
+
+	if (queue_mode < NULL_Q_BIO || queue_mode > NULL_Q_MQ)
+		queue_mode = NULL_Q_MQ;
+
+	if (hw_queue_depth < 1 || hw_queue_depth > BLK_MQ_MAX_DEPTH)
+		hw_queue_depth = 64;
+
+	if (submit_queues < 1 || submit_queues > nr_cpu_ids)
+		submit_queues = nr_cpu_ids;
+
+	if (irqmode == NULL_IRQ_TIMER)
+		null_mq_ops.poll = null_poll_hctx;
+
+	for_each_possible_cpu(i) {
+		struct nullb_completion_queue *cq = &per_cpu(completion_queues, i);
+
+		spin_lock_init(&cq->lock);
+		INIT_LIST_HEAD(&cq->list);
+		tasklet_init(&cq->tasklet, null_cmd_tasklet, (unsigned long) cq);
+		hrtimer_init(&cq->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		cq->timer.function = null_cmd_timer_expired;
+	}
+
+	null_major = register_blkdev(0, "nullb");
+	if (null_major < 0)
+		return null_major;
+
+	for (i = 0; i < nr_devices; i++) {
+		if (null_add_dev()) {
+			null_del_all();
+			unregister_blkdev(null_major, "nullb");
+			return -EINVAL;
+		}
+	}
+
+	pr_info("null: module loaded\n");
+	return 0;
+}
+
+static void __exit null_exit(void)
+{
+	unsigned int i;
+
+	unregister_blkdev(null_major, "nullb");
+	null_del_all();
+
+	for_each_possible_cpu(i) {
+		struct nullb_completion_queue *cq = &per_cpu(completion_queues, i);
+
+		hrtimer_cancel(&cq->timer);
+		tasklet_kill(&cq->tasklet);
+	}
+}
+
+module_init(null_init);
+module_exit(null_exit);
+
+MODULE_DESCRIPTION("Null block device driver");
+MODULE_LICENSE("GPL");
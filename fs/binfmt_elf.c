@@ -347,6 +347,17 @@ static unsigned long elf_map(struct file *filep, unsigned long addr,
 	} else
 		map_addr = do_mmap(filep, addr, size, prot, type, off);
 
+	/*
+	 * Text that other processes run already is in the page cache:
+	 * map it right away instead of taking a minor fault per page.
+	 */
+	if (!BAD_ADDR(map_addr) && !(prot & PROT_WRITE)) {
+		struct vm_area_struct *vma = find_vma(current->mm, map_addr);
+
+		if (vma && vma->vm_start <= map_addr)
+			map_cached_pages(vma, map_addr, map_addr + size);
+	}
+
 	up_write(&current->mm->mmap_sem);
 	return(map_addr);
 }
@@ -2121,12 +2121,16 @@ out:
 	return ret;
 }
 
-static noinline long btrfs_ioctl_clone(struct file *file, unsigned long srcfd,
+/*
+ * Share the extents of [off, off + olen) of src_file with file at destoff.
+ * The caller holds write access to the mount of @file.
+ */
+static noinline long btrfs_clone_files(struct file *file,
+				       struct file *src_file,
 				       u64 off, u64 olen, u64 destoff)
 {
 	struct inode *inode = fdentry(file)->d_inode;
 	struct btrfs_root *root = BTRFS_I(inode)->root;
-	struct file *src_file;
 	struct inode *src;
 	struct btrfs_trans_handle *trans;
 	struct btrfs_path *path;
@@ -2150,50 +2154,29 @@ static noinline long btrfs_ioctl_clone(struct file *file, unsigned long srcfd,
 	 *   they don't overlap)?
 	 */
 
-	/* the destination must be opened for writing */
-	if (!(file->f_mode & FMODE_WRITE) || (file->f_flags & O_APPEND))
-		return -EINVAL;
-
 	if (btrfs_root_readonly(root))
 		return -EROFS;
 
-	ret = mnt_want_write(file->f_path.mnt);
-	if (ret)
-		return ret;
-
-	src_file = fget(srcfd);
-	if (!src_file) {
-		ret = -EBADF;
-		goto out_drop_write;
-	}
-
 	src = src_file->f_dentry->d_inode;
 
-	ret = -EINVAL;
-	if (src == inode)
-		goto out_fput;
-
 	/* the src must be open for reading */
-	if (!(src_file->f_mode & FMODE_READ))
-		goto out_fput;
+	if (src == inode || !(src_file->f_mode & FMODE_READ))
+		return -EINVAL;
 
-	ret = -EISDIR;
 	if (S_ISDIR(src->i_mode) || S_ISDIR(inode->i_mode))
-		goto out_fput;
+		return -EISDIR;
 
-	ret = -EXDEV;
 	if (src->i_sb != inode->i_sb || BTRFS_I(src)->root != root)
-		goto out_fput;
+		return -EXDEV;
 
-	ret = -ENOMEM;
 	buf = vmalloc(btrfs_level_size(root, 0));
 	if (!buf)
-		goto out_fput;
+		return -ENOMEM;
 
 	path = btrfs_alloc_path();
 	if (!path) {
 		vfree(buf);
-		goto out_fput;
+		return -ENOMEM;
 	}
 	path->reada = 2;
 
@@ -2237,8 +2220,8 @@ static noinline long btrfs_ioctl_clone(struct file *file, unsigned long srcfd,
 	}
 
 	/* truncate page cache pages from target inode range */
-	truncate_inode_pages_range(&inode->i_data, off,
-				   ALIGN(off + len, PAGE_CACHE_SIZE) - 1);
+	truncate_inode_pages_range(&inode->i_data, destoff,
+				   ALIGN(destoff + len, PAGE_CACHE_SIZE) - 1);
 
 	/* clone data */
 	key.objectid = btrfs_ino(src);
@@ -2447,13 +2430,78 @@ out_unlock:
 	mutex_unlock(&inode->i_mutex);
 	vfree(buf);
 	btrfs_free_path(path);
-out_fput:
+	return ret;
+}
+
+static noinline long btrfs_ioctl_clone(struct file *file, unsigned long srcfd,
+				       u64 off, u64 olen, u64 destoff)
+{
+	struct file *src_file;
+	int ret;
+
+	/* the destination must be opened for writing */
+	if (!(file->f_mode & FMODE_WRITE) || (file->f_flags & O_APPEND))
+		return -EINVAL;
+
+	ret = mnt_want_write(file->f_path.mnt);
+	if (ret)
+		return ret;
+
+	src_file = fget(srcfd);
+	if (!src_file) {
+		ret = -EBADF;
+		goto out_drop_write;
+	}
+
+	ret = btrfs_clone_files(file, src_file, off, olen, destoff);
+
 	fput(src_file);
 out_drop_write:
 	mnt_drop_write(file->f_path.mnt);
 	return ret;
 }
 
+/*
+ * ->copy_file_range: clone what is block aligned and leave the rest to
+ * the page cache copy in the VFS.  A range ending at EOF counts as
+ * aligned, like for BTRFS_IOC_CLONE_RANGE.
+ */
+ssize_t btrfs_copy_file_range(struct file *file_in, loff_t pos_in,
+			      struct file *file_out, loff_t pos_out,
+			      size_t len, unsigned int flags)
+{
+	struct inode *src = fdentry(file_in)->d_inode;
+	struct inode *inode = fdentry(file_out)->d_inode;
+	u64 bs = BTRFS_I(inode)->root->fs_info->sb->s_blocksize;
+	loff_t isize = i_size_read(src);
+	long ret;
+
+	if (src == inode || BTRFS_I(src)->root != BTRFS_I(inode)->root)
+		return -EOPNOTSUPP;
+	if (!IS_ALIGNED(pos_in, bs) || !IS_ALIGNED(pos_out, bs))
+		return -EOPNOTSUPP;
+
+	if (pos_in >= isize)
+		return 0;
+	if (pos_in + len >= isize)
+		len = isize - pos_in;
+	else
+		len = round_down(len, bs);
+	if (!len)
+		return -EOPNOTSUPP;
+
+	ret = mnt_want_write(file_out->f_path.mnt);
+	if (ret)
+		return ret;
+	ret = btrfs_clone_files(file_out, file_in, pos_in, len, pos_out);
+	mnt_drop_write(file_out->f_path.mnt);
+
+	/* the file changed size under us, copy what is there */
+	if (ret == -EINVAL)
+		return -EOPNOTSUPP;
+	return ret ? ret : len;
+}
+
 static long btrfs_ioctl_clone_range(struct file *file, void __user *argp)
 {
 	struct btrfs_ioctl_clone_range_args args;
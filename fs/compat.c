@@ -1093,7 +1093,7 @@ out:
 
 static ssize_t compat_do_readv_writev(int type, struct file *file,
 			       const struct compat_iovec __user *uvector,
-			       unsigned long nr_segs, loff_t *pos)
+			       unsigned long nr_segs, loff_t *pos, int flags)
 {
 	compat_ssize_t tot_len;
 	struct iovec iovstack[UIO_FASTIOV];
@@ -1132,7 +1132,7 @@ static ssize_t compat_do_readv_writev(int type, struct file *file,
 
 	if (fnv)
 		ret = do_sync_readv_writev(file, iov, nr_segs, tot_len,
-						pos, fnv);
+						pos, fnv, flags);
 	else
 		ret = do_loop_readv_writev(file, iov, nr_segs, pos, fn);
 
@@ -1150,7 +1150,7 @@ out:
 
 static size_t compat_readv(struct file *file,
 			   const struct compat_iovec __user *vec,
-			   unsigned long vlen, loff_t *pos)
+			   unsigned long vlen, loff_t *pos, int flags)
 {
 	ssize_t ret = -EBADF;
 
@@ -1161,7 +1161,7 @@ static size_t compat_readv(struct file *file,
 	if (!file->f_op || (!file->f_op->aio_read && !file->f_op->read))
 		goto out;
 
-	ret = compat_do_readv_writev(READ, file, vec, vlen, pos);
+	ret = compat_do_readv_writev(READ, file, vec, vlen, pos, flags);
 
 out:
 	if (ret > 0)
@@ -1181,16 +1181,15 @@ compat_sys_readv(unsigned long fd, const struct compat_iovec __user *vec,
 	file = fget_light(fd, &fput_needed);
 	if (!file)
 		return -EBADF;
-	ret = compat_readv(file, vec, vlen, &file->f_pos);
+	ret = compat_readv(file, vec, vlen, &file->f_pos, 0);
 	fput_light(file, fput_needed);
 	return ret;
 }
 
-asmlinkage ssize_t
-compat_sys_preadv(unsigned long fd, const struct compat_iovec __user *vec,
-		  unsigned long vlen, u32 pos_low, u32 pos_high)
+static ssize_t compat_preadv(unsigned long fd,
+			     const struct compat_iovec __user *vec,
+			     unsigned long vlen, loff_t pos, int flags)
 {
-	loff_t pos = ((loff_t)pos_high << 32) | pos_low;
 	struct file *file;
 	int fput_needed;
 	ssize_t ret;
@@ -1202,14 +1201,23 @@ compat_sys_preadv(unsigned long fd, const struct compat_iovec __user *vec,
 		return -EBADF;
 	ret = -ESPIPE;
 	if (file->f_mode & FMODE_PREAD)
-		ret = compat_readv(file, vec, vlen, &pos);
+		ret = compat_readv(file, vec, vlen, &pos, flags);
 	fput_light(file, fput_needed);
 	return ret;
 }
 
+asmlinkage ssize_t
+compat_sys_preadv(unsigned long fd, const struct compat_iovec __user *vec,
+		  unsigned long vlen, u32 pos_low, u32 pos_high)
+{
+	loff_t pos = ((loff_t)pos_high << 32) | pos_low;
+
+	return compat_preadv(fd, vec, vlen, pos, 0);
+}
+
 static size_t compat_writev(struct file *file,
 			    const struct compat_iovec __user *vec,
-			    unsigned long vlen, loff_t *pos)
+			    unsigned long vlen, loff_t *pos, int flags)
 {
 	ssize_t ret = -EBADF;
 
@@ -1220,7 +1228,7 @@ static size_t compat_writev(struct file *file,
 	if (!file->f_op || (!file->f_op->aio_write && !file->f_op->write))
 		goto out;
 
-	ret = compat_do_readv_writev(WRITE, file, vec, vlen, pos);
+	ret = compat_do_readv_writev(WRITE, file, vec, vlen, pos, flags);
 
 out:
 	if (ret > 0)
@@ -1240,16 +1248,15 @@ compat_sys_writev(unsigned long fd, const struct compat_iovec __user *vec,
 	file = fget_light(fd, &fput_needed);
 	if (!file)
 		return -EBADF;
-	ret = compat_writev(file, vec, vlen, &file->f_pos);
+	ret = compat_writev(file, vec, vlen, &file->f_pos, 0);
 	fput_light(file, fput_needed);
 	return ret;
 }
 
-asmlinkage ssize_t
-compat_sys_pwritev(unsigned long fd, const struct compat_iovec __user *vec,
-		   unsigned long vlen, u32 pos_low, u32 pos_high)
+static ssize_t compat_pwritev(unsigned long fd,
+			      const struct compat_iovec __user *vec,
+			      unsigned long vlen, loff_t pos, int flags)
 {
-	loff_t pos = ((loff_t)pos_high << 32) | pos_low;
 	struct file *file;
 	int fput_needed;
 	ssize_t ret;
@@ -1261,7 +1268,62 @@ compat_sys_pwritev(unsigned long fd, const struct compat_iovec __user *vec,
 		return -EBADF;
 	ret = -ESPIPE;
 	if (file->f_mode & FMODE_PWRITE)
-		ret = compat_writev(file, vec, vlen, &pos);
+		ret = compat_writev(file, vec, vlen, &pos, flags);
+	fput_light(file, fput_needed);
+	return ret;
+}
+
+asmlinkage ssize_t
+compat_sys_pwritev(unsigned long fd, const struct compat_iovec __user *vec,
+		   unsigned long vlen, u32 pos_low, u32 pos_high)
+{
+	loff_t pos = ((loff_t)pos_high << 32) | pos_low;
+
+	return compat_pwritev(fd, vec, vlen, pos, 0);
+}
+
+asmlinkage ssize_t
+compat_sys_preadv2(unsigned long fd, const struct compat_iovec __user *vec,
+		   unsigned long vlen, u32 pos_low, u32 pos_high, int flags)
+{
+	loff_t pos = ((loff_t)pos_high << 32) | pos_low;
+	struct file *file;
+	int fput_needed;
+	ssize_t ret;
+
+	if (flags & ~RWF_SUPPORTED)
+		return -EOPNOTSUPP;
+
+	if (pos != -1)
+		return compat_preadv(fd, vec, vlen, pos, flags);
+
+	file = fget_light(fd, &fput_needed);
+	if (!file)
+		return -EBADF;
+	ret = compat_readv(file, vec, vlen, &file->f_pos, flags);
+	fput_light(file, fput_needed);
+	return ret;
+}
+
+asmlinkage ssize_t
+compat_sys_pwritev2(unsigned long fd, const struct compat_iovec __user *vec,
+		    unsigned long vlen, u32 pos_low, u32 pos_high, int flags)
+{
+	loff_t pos = ((loff_t)pos_high << 32) | pos_low;
+	struct file *file;
+	int fput_needed;
+	ssize_t ret;
+
+	if (flags & ~RWF_SUPPORTED)
+		return -EOPNOTSUPP;
+
+	if (pos != -1)
+		return compat_pwritev(fd, vec, vlen, pos, flags);
+
+	file = fget_light(fd, &fput_needed);
+	if (!file)
+		return -EBADF;
+	ret = compat_writev(file, vec, vlen, &file->f_pos, flags);
 	fput_light(file, fput_needed);
 	return ret;
 }
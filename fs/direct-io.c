@@ -106,6 +106,11 @@ struct dio {
 	struct bio *bio_list;		/* singly linked via bi_private */
 	struct task_struct *waiter;	/* waiting task (NULL if none) */
 
+	/* RWF_HIPRI: poll this queue instead of sleeping for completions */
+	struct request_queue *poll_queue;
+	u64 poll_issued;		/* ktime of the last submission, ns */
+	int poll_slept;			/* hybrid sleep done since then */
+
 	/* AIO related stuff */
 	struct kiocb *iocb;		/* kiocb */
 	int is_async;			/* is IO async ? */
@@ -411,6 +416,11 @@ static void dio_bio_submit(struct dio *dio)
 	if (dio->is_async && dio->rw == READ)
 		bio_set_pages_dirty(bio);
 
+	if (dio->poll_queue) {
+		dio->poll_issued = ktime_to_ns(ktime_get());
+		dio->poll_slept = 0;
+	}
+
 	if (dio->submit_io)
 		dio->submit_io(dio->rw, bio, dio->inode,
 			       dio->logical_offset_in_bio);
@@ -431,6 +441,29 @@ static void dio_cleanup(struct dio *dio)
 		page_cache_release(dio_get_page(dio));
 }
 
+/*
+ * Instead of sleeping until the completion interrupt wakes us, look for the
+ * completion ourselves.  The first round after a submission may sleep for
+ * part of the expected service time (hybrid polling, see io_poll_delay).
+ */
+static void dio_poll_one(struct dio *dio)
+{
+	struct request_queue *q = dio->poll_queue;
+
+	if (!dio->poll_slept) {
+		dio->poll_slept = 1;
+		if (blk_poll_sleep(q, dio->rw, dio->poll_issued))
+			return;
+	}
+
+	if (!blk_poll(q)) {
+		if (need_resched())
+			cond_resched();
+		else
+			cpu_relax();
+	}
+}
+
 /*
  * Wait for the next BIO to complete.  Remove it and return it.  NULL is
  * returned once all BIOs have been completed.  This must only be called once
@@ -451,6 +484,12 @@ static struct bio *dio_await_one(struct dio *dio)
 	 * and can call it after testing our condition.
 	 */
 	while (dio->refcount > 1 && dio->bio_list == NULL) {
+		if (dio->poll_queue && blk_queue_poll(dio->poll_queue)) {
+			spin_unlock_irqrestore(&dio->bio_lock, flags);
+			dio_poll_one(dio);
+			spin_lock_irqsave(&dio->bio_lock, flags);
+			continue;
+		}
 		__set_current_state(TASK_UNINTERRUPTIBLE);
 		dio->waiter = current;
 		spin_unlock_irqrestore(&dio->bio_lock, flags);
@@ -464,6 +503,9 @@ static struct bio *dio_await_one(struct dio *dio)
 		dio->bio_list = bio->bi_private;
 	}
 	spin_unlock_irqrestore(&dio->bio_lock, flags);
+
+	if (bio && dio->poll_queue)
+		blk_poll_account(dio->poll_queue, dio->rw, dio->poll_issued);
 	return bio;
 }
 
@@ -1288,6 +1330,14 @@ __blockdev_direct_IO(int rw, struct kiocb *iocb, struct inode *inode,
 	dio->is_async = !is_sync_kiocb(iocb) && !((rw & WRITE) &&
 		(end > i_size_read(inode)));
 
+	/*
+	 * Synchronous I/O that asked for it spins on the device's completion
+	 * queue instead of sleeping for the interrupt.
+	 */
+	if (!dio->is_async && kiocbIsHipri(iocb) && bdev &&
+	    blk_queue_poll(bdev_get_queue(bdev)))
+		dio->poll_queue = bdev_get_queue(bdev);
+
 	retval = direct_io_worker(rw, iocb, inode, iov, offset,
 				nr_segs, blkbits, get_block, end_io,
 				submit_io, dio);
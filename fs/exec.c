@@ -2077,7 +2077,7 @@ static int umh_pipe_setup(struct subprocess_info *info, struct cred *new)
 	fd_install(0, rp);
 	spin_lock(&cf->file_lock);
 	fdt = files_fdtable(cf);
-	FD_SET(0, fdt->open_fds);
+	__set_open_fd(0, fdt);
 	FD_CLR(0, fdt->close_on_exec);
 	spin_unlock(&cf->file_lock);
 
@@ -14,12 +14,22 @@
 #include <linux/sched.h>
 #include <linux/pipe_fs_i.h>
 
+/*
+ * Opening only holds the inode's i_mutex, not the pipe lock, so this
+ * cannot use pipe_wait().
+ */
 static void wait_for_partner(struct inode* inode, unsigned int *cnt)
 {
 	int cur = *cnt;	
 
 	while (cur == *cnt) {
-		pipe_wait(inode->i_pipe);
+		DEFINE_WAIT(wait);
+
+		prepare_to_wait(&inode->i_pipe->wait, &wait, TASK_INTERRUPTIBLE);
+		mutex_unlock(&inode->i_mutex);
+		schedule();
+		finish_wait(&inode->i_pipe->wait, &wait);
+		mutex_lock(&inode->i_mutex);
 		if (signal_pending(current))
 			break;
 	}
@@ -50,25 +50,49 @@ unsigned int pipe_min_size = PAGE_SIZE;
  * -- Manfred Spraul <manfred@colorfullife.com> 2002-05-09
  */
 
+/*
+ * Locking:
+ *
+ * read(2) only takes pipe->rd_mutex and write(2) only takes pipe->wr_mutex,
+ * so one reader and one writer run concurrently.  Between the two, the
+ * ring indices (nrbufs, curbuf) and the length of the last buffer are
+ * only changed under pipe->ring_lock, which is never held across a copy:
+ *
+ *  - the reader owns the buffer at curbuf, it consumes the buffer and
+ *    only then advances curbuf and drops nrbufs;
+ *  - the writer owns the slots past the last buffer, it fills a slot and
+ *    only then bumps nrbufs.  When it appends to the last buffer it holds
+ *    a page reference, so that a reader consuming the buffer meanwhile
+ *    cannot free the page from under it.
+ *
+ * Everybody else (splice, tee, fuse, F_SETPIPE_SZ, FIONREAD) takes both
+ * mutexes through pipe_lock() and has the whole pipe to itself.  The
+ * inode's i_mutex only serializes open, release and fasync.
+ *
+ * The reader and the writer may find each other asleep without holding
+ * the other's mutex, so wakeups go through pipe_wake() and the sleepers
+ * recheck their condition after queueing themselves (pipe_wait_ring()).
+ */
 static void pipe_lock_nested(struct pipe_inode_info *pipe, int subclass)
 {
-	if (pipe->inode)
-		mutex_lock_nested(&pipe->inode->i_mutex, subclass);
+	if (pipe->inode) {
+		mutex_lock_nested(&pipe->rd_mutex, subclass);
+		mutex_lock_nested(&pipe->wr_mutex, subclass);
+	}
 }
 
 void pipe_lock(struct pipe_inode_info *pipe)
 {
-	/*
-	 * pipe_lock() nests non-pipe inode locks (for writing to a file)
-	 */
-	pipe_lock_nested(pipe, I_MUTEX_PARENT);
+	pipe_lock_nested(pipe, 0);
 }
 EXPORT_SYMBOL(pipe_lock);
 
 void pipe_unlock(struct pipe_inode_info *pipe)
 {
-	if (pipe->inode)
-		mutex_unlock(&pipe->inode->i_mutex);
+	if (pipe->inode) {
+		mutex_unlock(&pipe->wr_mutex);
+		mutex_unlock(&pipe->rd_mutex);
+	}
 }
 EXPORT_SYMBOL(pipe_unlock);
 
@@ -78,15 +102,15 @@ void pipe_double_lock(struct pipe_inode_info *pipe1,
 	BUG_ON(pipe1 == pipe2);
 
 	if (pipe1 < pipe2) {
-		pipe_lock_nested(pipe1, I_MUTEX_PARENT);
-		pipe_lock_nested(pipe2, I_MUTEX_CHILD);
+		pipe_lock_nested(pipe1, 0);
+		pipe_lock_nested(pipe2, SINGLE_DEPTH_NESTING);
 	} else {
-		pipe_lock_nested(pipe2, I_MUTEX_PARENT);
-		pipe_lock_nested(pipe1, I_MUTEX_CHILD);
+		pipe_lock_nested(pipe2, 0);
+		pipe_lock_nested(pipe1, SINGLE_DEPTH_NESTING);
 	}
 }
 
-/* Drop the inode semaphore and wait for a pipe event, atomically */
+/* Drop the pipe lock and wait for a pipe event, atomically */
 void pipe_wait(struct pipe_inode_info *pipe)
 {
 	DEFINE_WAIT(wait);
@@ -102,6 +126,54 @@ void pipe_wait(struct pipe_inode_info *pipe)
 	pipe_lock(pipe);
 }
 
+/*
+ * Wait for the writer (@reader set) or the reader to make progress,
+ * dropping only our own end's mutex.  The other end does not take it,
+ * so the condition has to be rechecked once we are on the wait queue;
+ * this pairs with the barrier in pipe_wake().
+ */
+static void pipe_wait_ring(struct pipe_inode_info *pipe, int reader)
+{
+	struct mutex *mutex = reader ? &pipe->rd_mutex : &pipe->wr_mutex;
+	DEFINE_WAIT(wait);
+	int sleep;
+
+	prepare_to_wait(&pipe->wait, &wait, TASK_INTERRUPTIBLE);
+	if (reader)
+		sleep = !pipe->nrbufs && pipe->writers;
+	else
+		sleep = pipe->nrbufs >= pipe->buffers && pipe->readers;
+	if (sleep) {
+		mutex_unlock(mutex);
+		schedule();
+		mutex_lock(mutex);
+	}
+	finish_wait(&pipe->wait, &wait);
+}
+
+/*
+ * Wake up the other end, but only if somebody is actually sleeping on
+ * the pipe or polling it: a reader that keeps up with the writer (or the
+ * other way round) is not on the wait queue, and skipping the wait queue
+ * lock for it is most of the cost of a small write.
+ */
+static inline void pipe_wake(struct pipe_inode_info *pipe, unsigned long mask)
+{
+	smp_mb();
+	if (waitqueue_active(&pipe->wait))
+		wake_up_interruptible_sync_poll(&pipe->wait, mask);
+}
+
+/*
+ * Keep @page as the one-deep allocation cache of the pipe, unless the
+ * cache is already populated.  A reader and a writer can race on it.
+ */
+static void pipe_cache_page(struct pipe_inode_info *pipe, struct page *page)
+{
+	if (cmpxchg(&pipe->tmp_page, NULL, page))
+		page_cache_release(page);
+}
+
 static int
 pipe_iov_copy_from_user(void *to, struct iovec *iov, unsigned long len,
 			int atomic)
@@ -205,8 +277,8 @@ static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
 	 * temporary page, let's keep track of it as a one-deep
 	 * allocation cache. (Otherwise just release our reference to it)
 	 */
-	if (page_count(page) == 1 && !pipe->tmp_page)
-		pipe->tmp_page = page;
+	if (page_count(page) == 1)
+		pipe_cache_page(pipe, page);
 	else
 		page_cache_release(page);
 }
@@ -351,7 +423,7 @@ pipe_read(struct kiocb *iocb, const struct iovec *_iov,
 {
 	struct file *filp = iocb->ki_filp;
 	struct inode *inode = filp->f_path.dentry->d_inode;
-	struct pipe_inode_info *pipe;
+	struct pipe_inode_info *pipe = inode->i_pipe;
 	int do_wakeup;
 	ssize_t ret;
 	struct iovec *iov = (struct iovec *)_iov;
@@ -364,16 +436,24 @@ pipe_read(struct kiocb *iocb, const struct iovec *_iov,
 
 	do_wakeup = 0;
 	ret = 0;
-	mutex_lock(&inode->i_mutex);
-	pipe = inode->i_pipe;
+	mutex_lock(&pipe->rd_mutex);
 	for (;;) {
-		int bufs = pipe->nrbufs;
+		int bufs, waiting_writers;
+		size_t chars = 0;
+
+		spin_lock(&pipe->ring_lock);
+		bufs = pipe->nrbufs;
+		if (bufs)
+			chars = pipe->bufs[pipe->curbuf].len;
+		waiting_writers = pipe->waiting_writers;
+		spin_unlock(&pipe->ring_lock);
+
 		if (bufs) {
 			int curbuf = pipe->curbuf;
 			struct pipe_buffer *buf = pipe->bufs + curbuf;
 			const struct pipe_buf_operations *ops = buf->ops;
+			struct pipe_buffer done;
 			void *addr;
-			size_t chars = buf->len;
 			int error, atomic;
 
 			if (chars > total_len)
@@ -404,16 +484,27 @@ redo:
 				break;
 			}
 			ret += chars;
+
+			/* A writer may be appending to this very buffer */
+			done.ops = NULL;
+			spin_lock(&pipe->ring_lock);
 			buf->offset += chars;
 			buf->len -= chars;
 			if (!buf->len) {
+				done = *buf;
 				buf->ops = NULL;
-				ops->release(pipe, buf);
 				curbuf = (curbuf + 1) & (pipe->buffers - 1);
 				pipe->curbuf = curbuf;
-				pipe->nrbufs = --bufs;
+				pipe->nrbufs--;
 				do_wakeup = 1;
 			}
+			bufs = pipe->nrbufs;
+			spin_unlock(&pipe->ring_lock);
+
+			/* The slot may be reused as soon as the lock is gone */
+			if (done.ops)
+				ops->release(pipe, &done);
+
 			total_len -= chars;
 			if (!total_len)
 				break;	/* common path: read succeeded */
@@ -422,7 +513,7 @@ redo:
 			continue;
 		if (!pipe->writers)
 			break;
-		if (!pipe->waiting_writers) {
+		if (!waiting_writers) {
 			/* syscall merging: Usually we must not sleep
 			 * if O_NONBLOCK is set, or if we got some data.
 			 * But if a writer sleeps in kernel space, then
@@ -441,16 +532,16 @@ redo:
 			break;
 		}
 		if (do_wakeup) {
-			wake_up_interruptible_sync_poll(&pipe->wait, POLLOUT | POLLWRNORM);
+			pipe_wake(pipe, POLLOUT | POLLWRNORM);
  			kill_fasync(&pipe->fasync_writers, SIGIO, POLL_OUT);
 		}
-		pipe_wait(pipe);
+		pipe_wait_ring(pipe, 1);
 	}
-	mutex_unlock(&inode->i_mutex);
+	mutex_unlock(&pipe->rd_mutex);
 
 	/* Signal writers asynchronously that there is more room. */
 	if (do_wakeup) {
-		wake_up_interruptible_sync_poll(&pipe->wait, POLLOUT | POLLWRNORM);
+		pipe_wake(pipe, POLLOUT | POLLWRNORM);
 		kill_fasync(&pipe->fasync_writers, SIGIO, POLL_OUT);
 	}
 	if (ret > 0)
@@ -464,7 +555,7 @@ pipe_write(struct kiocb *iocb, const struct iovec *_iov,
 {
 	struct file *filp = iocb->ki_filp;
 	struct inode *inode = filp->f_path.dentry->d_inode;
-	struct pipe_inode_info *pipe;
+	struct pipe_inode_info *pipe = inode->i_pipe;
 	ssize_t ret;
 	int do_wakeup;
 	struct iovec *iov = (struct iovec *)_iov;
@@ -478,8 +569,7 @@ pipe_write(struct kiocb *iocb, const struct iovec *_iov,
 
 	do_wakeup = 0;
 	ret = 0;
-	mutex_lock(&inode->i_mutex);
-	pipe = inode->i_pipe;
+	mutex_lock(&pipe->wr_mutex);
 
 	if (!pipe->readers) {
 		send_sig(SIGPIPE, current, 0);
@@ -489,27 +579,46 @@ pipe_write(struct kiocb *iocb, const struct iovec *_iov,
 
 	/* We try to merge small writes */
 	chars = total_len & (PAGE_SIZE-1); /* size of the last buffer */
-	if (pipe->nrbufs && chars != 0) {
-		int lastbuf = (pipe->curbuf + pipe->nrbufs - 1) &
+	if (chars != 0) {
+		struct page *page = NULL;
+		struct pipe_buffer *buf;
+		int offset;
+
+		spin_lock(&pipe->ring_lock);
+		if (pipe->nrbufs) {
+			int lastbuf = (pipe->curbuf + pipe->nrbufs - 1) &
 							(pipe->buffers - 1);
-		struct pipe_buffer *buf = pipe->bufs + lastbuf;
-		const struct pipe_buf_operations *ops = buf->ops;
-		int offset = buf->offset + buf->len;
 
-		if (ops->can_merge && offset + chars <= PAGE_SIZE) {
+			buf = pipe->bufs + lastbuf;
+			offset = buf->offset + buf->len;
+			if (buf->ops->can_merge && offset + chars <= PAGE_SIZE) {
+				page = buf->page;
+				page_cache_get(page);
+			}
+		}
+		spin_unlock(&pipe->ring_lock);
+
+		/*
+		 * Only anonymous buffers can be merged, they need no
+		 * ->confirm() and are mapped directly, as buf->flags
+		 * belong to a reader that may be mapping the buffer too.
+		 */
+		if (page) {
 			int error, atomic = 1;
 			void *addr;
 
-			error = ops->confirm(pipe, buf);
-			if (error)
-				goto out;
-
 			iov_fault_in_pages_read(iov, chars);
 redo1:
-			addr = ops->map(pipe, buf, atomic);
+			if (atomic)
+				addr = kmap_atomic(page, KM_USER0);
+			else
+				addr = kmap(page);
 			error = pipe_iov_copy_from_user(offset + addr, iov,
 							chars, atomic);
-			ops->unmap(pipe, buf, addr);
+			if (atomic)
+				kunmap_atomic(addr, KM_USER0);
+			else
+				kunmap(page);
 			ret = error;
 			do_wakeup = 1;
 			if (error) {
@@ -517,9 +626,33 @@ redo1:
 					atomic = 0;
 					goto redo1;
 				}
+				page_cache_release(page);
 				goto out;
 			}
-			buf->len += chars;
+
+			spin_lock(&pipe->ring_lock);
+			if (pipe->nrbufs) {
+				/* still the last buffer, only we add new ones */
+				buf->len += chars;
+			} else {
+				/*
+				 * The reader emptied the pipe under us, queue
+				 * what we copied as a buffer of its own.  It
+				 * owns the reference we took.
+				 */
+				buf = pipe->bufs + pipe->curbuf;
+				buf->page = page;
+				buf->ops = &anon_pipe_buf_ops;
+				buf->offset = offset;
+				buf->len = chars;
+				buf->flags = 0;
+				pipe->nrbufs = 1;
+				page = NULL;
+			}
+			spin_unlock(&pipe->ring_lock);
+			if (page)
+				page_cache_release(page);
+
 			total_len -= chars;
 			ret = chars;
 			if (!total_len)
@@ -528,7 +661,7 @@ redo1:
 	}
 
 	for (;;) {
-		int bufs;
+		int bufs, newbuf;
 
 		if (!pipe->readers) {
 			send_sig(SIGPIPE, current, 0);
@@ -536,11 +669,15 @@ redo1:
 				ret = -EPIPE;
 			break;
 		}
+		spin_lock(&pipe->ring_lock);
 		bufs = pipe->nrbufs;
+		newbuf = (pipe->curbuf + bufs) & (pipe->buffers-1);
+		spin_unlock(&pipe->ring_lock);
+
+		/* The reader only ever frees slots, newbuf stays ours */
 		if (bufs < pipe->buffers) {
-			int newbuf = (pipe->curbuf + bufs) & (pipe->buffers-1);
 			struct pipe_buffer *buf = pipe->bufs + newbuf;
-			struct page *page = pipe->tmp_page;
+			struct page *page = xchg(&pipe->tmp_page, NULL);
 			char *src;
 			int error, atomic = 1;
 
@@ -550,7 +687,6 @@ redo1:
 					ret = ret ? : -ENOMEM;
 					break;
 				}
-				pipe->tmp_page = page;
 			}
 			/* Always wake up, even if the copy fails. Otherwise
 			 * we lock up (O_NONBLOCK-)readers that sleep due to
@@ -581,6 +717,7 @@ redo2:
 					atomic = 0;
 					goto redo2;
 				}
+				pipe_cache_page(pipe, page);
 				if (!ret)
 					ret = error;
 				break;
@@ -592,15 +729,15 @@ redo2:
 			buf->ops = &anon_pipe_buf_ops;
 			buf->offset = 0;
 			buf->len = chars;
-			pipe->nrbufs = ++bufs;
-			pipe->tmp_page = NULL;
+			spin_lock(&pipe->ring_lock);
+			pipe->nrbufs++;
+			spin_unlock(&pipe->ring_lock);
 
 			total_len -= chars;
 			if (!total_len)
 				break;
-		}
-		if (bufs < pipe->buffers)
 			continue;
+		}
 		if (filp->f_flags & O_NONBLOCK) {
 			if (!ret)
 				ret = -EAGAIN;
@@ -612,18 +749,22 @@ redo2:
 			break;
 		}
 		if (do_wakeup) {
-			wake_up_interruptible_sync_poll(&pipe->wait, POLLIN | POLLRDNORM);
+			pipe_wake(pipe, POLLIN | POLLRDNORM);
 			kill_fasync(&pipe->fasync_readers, SIGIO, POLL_IN);
 			do_wakeup = 0;
 		}
+		spin_lock(&pipe->ring_lock);
 		pipe->waiting_writers++;
-		pipe_wait(pipe);
+		spin_unlock(&pipe->ring_lock);
+		pipe_wait_ring(pipe, 0);
+		spin_lock(&pipe->ring_lock);
 		pipe->waiting_writers--;
+		spin_unlock(&pipe->ring_lock);
 	}
 out:
-	mutex_unlock(&inode->i_mutex);
+	mutex_unlock(&pipe->wr_mutex);
 	if (do_wakeup) {
-		wake_up_interruptible_sync_poll(&pipe->wait, POLLIN | POLLRDNORM);
+		pipe_wake(pipe, POLLIN | POLLRDNORM);
 		kill_fasync(&pipe->fasync_readers, SIGIO, POLL_IN);
 	}
 	if (ret > 0)
@@ -652,8 +793,8 @@ static long pipe_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 	switch (cmd) {
 		case FIONREAD:
-			mutex_lock(&inode->i_mutex);
 			pipe = inode->i_pipe;
+			pipe_lock(pipe);
 			count = 0;
 			buf = pipe->curbuf;
 			nrbufs = pipe->nrbufs;
@@ -661,7 +802,7 @@ static long pipe_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 				count += pipe->bufs[buf].len;
 				buf = (buf+1) & (pipe->buffers - 1);
 			}
-			mutex_unlock(&inode->i_mutex);
+			pipe_unlock(pipe);
 
 			return put_user(count, (int __user *)arg);
 		default:
@@ -680,7 +821,11 @@ pipe_poll(struct file *filp, poll_table *wait)
 
 	poll_wait(filp, &pipe->wait, wait);
 
-	/* Reading only -- no need for acquiring the semaphore.  */
+	/*
+	 * Reading only -- no need for acquiring the mutexes, but the
+	 * barrier pairs with pipe_wake(), which skips an empty queue.
+	 */
+	smp_mb();
 	nrbufs = pipe->nrbufs;
 	mask = 0;
 	if (filp->f_mode & FMODE_READ) {
@@ -898,6 +1043,9 @@ struct pipe_inode_info * alloc_pipe_info(struct inode *inode)
 	if (pipe) {
 		pipe->bufs = kzalloc(sizeof(struct pipe_buffer) * PIPE_DEF_BUFFERS, GFP_KERNEL);
 		if (pipe->bufs) {
+			mutex_init(&pipe->rd_mutex);
+			mutex_init(&pipe->wr_mutex);
+			spin_lock_init(&pipe->ring_lock);
 			init_waitqueue_head(&pipe->wait);
 			pipe->r_counter = pipe->w_counter = 1;
 			pipe->inode = inode;
@@ -1219,7 +1367,7 @@ long pipe_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 	if (!pipe)
 		return -EBADF;
 
-	mutex_lock(&pipe->inode->i_mutex);
+	pipe_lock(pipe);
 
 	switch (cmd) {
 	case F_SETPIPE_SZ: {
@@ -1248,7 +1396,7 @@ long pipe_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 	}
 
 out:
-	mutex_unlock(&pipe->inode->i_mutex);
+	pipe_unlock(pipe);
 	return ret;
 }
 
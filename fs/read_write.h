@@ -8,7 +8,11 @@ typedef ssize_t (*io_fn_t)(struct file *, char __user *, size_t, loff_t *);
 typedef ssize_t (*iov_fn_t)(struct kiocb *, const struct iovec *,
 		unsigned long, loff_t);
 
+/* preadv2/pwritev2 flags we know about */
+#define RWF_SUPPORTED	RWF_HIPRI
+
 ssize_t do_sync_readv_writev(struct file *filp, const struct iovec *iov,
-		unsigned long nr_segs, size_t len, loff_t *ppos, iov_fn_t fn);
+		unsigned long nr_segs, size_t len, loff_t *ppos, iov_fn_t fn,
+		int flags);
 ssize_t do_loop_readv_writev(struct file *filp, struct iovec *iov,
 		unsigned long nr_segs, loff_t *ppos, io_fn_t fn);
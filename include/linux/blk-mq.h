@@ -0,0 +1,137 @@
+#ifndef BLK_MQ_H
+#define BLK_MQ_H
+
+#include <linux/blkdev.h>
+
+/*
+ * Multiqueue block layer interface
+ *
+ * A multiqueue driver does not get a request_fn.  Each CPU submits into
+ * its own software staging queue (struct blk_mq_ctx, private to the block
+ * layer), where requests are plugged and merged without touching any
+ * shared lock.  The staging queues are mapped onto one or more hardware
+ * dispatch queues, which hand requests to the driver through
+ * ->queue_rq().  Requests are preallocated per hardware queue and carry
+ * a tag that is unique within it, so drivers can use ->tag directly as
+ * a command identifier.
+ */
+
+struct blk_mq_ctx;
+
+struct blk_mq_hw_ctx {
+	/*
+	 * requests the driver returned BUSY for, dispatched first on the
+	 * next run of the queue
+	 */
+	spinlock_t		lock;
+	struct list_head	dispatch;
+
+	unsigned long		state;		/* BLK_MQ_S_* flags */
+	struct delayed_work	run_work;
+
+	cpumask_var_t		cpumask;
+	unsigned int		queue_num;
+
+	void			*driver_data;
+	struct request_queue	*queue;
+
+	/* preallocated requests, indexed by tag */
+	unsigned int		queue_depth;
+	struct request		**rqs;
+	unsigned long		*tag_map;
+	wait_queue_head_t	tag_wait;
+
+	/* software queues mapped to this hardware queue */
+	unsigned int		nr_ctx;
+	struct blk_mq_ctx	**ctxs;
+	unsigned long		*ctx_map;	/* ctxs with pending requests */
+};
+
+typedef int (queue_rq_fn)(struct blk_mq_hw_ctx *, struct request *);
+typedef int (init_hctx_fn)(struct blk_mq_hw_ctx *, void *, unsigned int);
+typedef void (exit_hctx_fn)(struct blk_mq_hw_ctx *, unsigned int);
+typedef int (poll_hctx_fn)(struct blk_mq_hw_ctx *);
+
+struct blk_mq_ops {
+	/*
+	 * Queue request.  Called without any block layer lock held; the
+	 * request has been started and must eventually be passed to
+	 * blk_mq_complete_request() unless BUSY or ERROR is returned.
+	 * A driver returning BUSY must stop the hw queue first and restart
+	 * it once it can take requests again.
+	 */
+	queue_rq_fn		*queue_rq;
+
+	/*
+	 * Called when a hardware queue is set up and torn down.  Optional;
+	 * without ->init_hctx the driver_data passed to blk_mq_init_queue()
+	 * is stored in every hw queue.
+	 */
+	init_hctx_fn		*init_hctx;
+	exit_hctx_fn		*exit_hctx;
+
+	/*
+	 * Reap completed requests without waiting for the interrupt.
+	 * Optional; returns the number of requests completed.  Called with
+	 * preemption disabled and must not sleep.
+	 */
+	poll_hctx_fn		*poll;
+};
+
+struct blk_mq_reg {
+	struct blk_mq_ops	*ops;
+	unsigned int		nr_hw_queues;
+	unsigned int		queue_depth;	/* requests per hw queue */
+	unsigned int		cmd_size;	/* per-request driver data */
+	int			numa_node;
+	unsigned int		flags;		/* BLK_MQ_F_* */
+};
+
+enum {
+	BLK_MQ_RQ_QUEUE_OK	= 0,	/* queued fine */
+	BLK_MQ_RQ_QUEUE_BUSY	= 1,	/* requeue IO for later */
+	BLK_MQ_RQ_QUEUE_ERROR	= 2,	/* end IO with error */
+
+	BLK_MQ_F_SHOULD_MERGE	= 1 << 0,
+
+	BLK_MQ_S_STOPPED	= 0,
+
+	BLK_MQ_MAX_DEPTH	= 2048,
+};
+
+struct request_queue *blk_mq_init_queue(struct blk_mq_reg *, void *);
+
+struct request *blk_mq_alloc_request(struct request_queue *q, int rw,
+				     gfp_t gfp);
+void blk_mq_free_request(struct request *rq);
+void blk_mq_insert_request(struct request *rq, bool at_head, bool run_queue,
+			   bool async);
+
+void blk_mq_complete_request(struct request *rq, int error);
+void blk_mq_end_io(struct request *rq, int error);
+
+void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async);
+void blk_mq_run_queues(struct request_queue *q, bool async);
+void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *hctx);
+void blk_mq_start_hw_queue(struct blk_mq_hw_ctx *hctx);
+void blk_mq_start_stopped_hw_queues(struct request_queue *q);
+
+/*
+ * Driver command data is immediately after the request. So subtract
+ * request size to get back to the original request.
+ */
+static inline struct request *blk_mq_rq_from_pdu(void *pdu)
+{
+	return pdu - sizeof(struct request);
+}
+
+static inline void *blk_mq_rq_to_pdu(struct request *rq)
+{
+	return (void *) rq + sizeof(*rq);
+}
+
+#define queue_for_each_hw_ctx(q, hctx, i)				\
+	for ((i) = 0; (i) < (q)->nr_hw_queues &&			\
+	     ({ hctx = (q)->queue_hw_ctx[i]; 1; }); (i)++)
+
+#endif
@@ -12,6 +12,7 @@
 #include <linux/types.h>
 #include <linux/init.h>
 #include <linux/fs.h>
+#include <linux/wait.h>
 
 #include <linux/atomic.h>
 
@@ -34,10 +35,25 @@ struct fdtable {
 	struct file __rcu **fd;      /* current fd array */
 	fd_set *close_on_exec;
 	fd_set *open_fds;
+	unsigned long *full_fds_bits; /* one bit per full open_fds word */
 	struct rcu_head rcu;
 	struct fdtable *next;
 };
 
+static inline void __set_open_fd(unsigned int fd, struct fdtable *fdt)
+{
+	__set_bit(fd, fdt->open_fds->fds_bits);
+	fd /= BITS_PER_LONG;
+	if (!~fdt->open_fds->fds_bits[fd])
+		__set_bit(fd, fdt->full_fds_bits);
+}
+
+static inline void __clear_open_fd(unsigned int fd, struct fdtable *fdt)
+{
+	__clear_bit(fd, fdt->open_fds->fds_bits);
+	__clear_bit(fd / BITS_PER_LONG, fdt->full_fds_bits);
+}
+
 /*
  * Open file table structure
  */
@@ -46,6 +62,9 @@ struct files_struct {
    * read mostly part
    */
 	atomic_t count;
+	bool resize_in_progress;
+	wait_queue_head_t resize_wait;
+
 	struct fdtable __rcu *fdt;
 	struct fdtable fdtab;
   /*
@@ -53,6 +72,7 @@ struct files_struct {
    */
 	spinlock_t file_lock ____cacheline_aligned_in_smp;
 	int next_fd;
+	unsigned long full_fds_bits_init[1];
 	struct embedded_fd_set close_on_exec_init;
 	struct embedded_fd_set open_fds_init;
 	struct file __rcu * fd_array[NR_OPEN_DEFAULT];
@@ -122,4 +122,14 @@ extern void account_process_tick(struct task_struct *, int user);
 extern void account_steal_ticks(unsigned long ticks);
 extern void account_idle_ticks(unsigned long ticks);
 
+#ifdef CONFIG_NO_HZ_FULL
+extern void vtime_account_user(struct task_struct *tsk);
+extern void vtime_account_system(struct task_struct *tsk);
+extern void vtime_task_switch(struct task_struct *prev);
+#else
+static inline void vtime_account_user(struct task_struct *tsk) { }
+static inline void vtime_account_system(struct task_struct *tsk) { }
+static inline void vtime_task_switch(struct task_struct *prev) { }
+#endif
+
 #endif /* _LINUX_KERNEL_STAT_H */
@@ -0,0 +1,130 @@
+#ifndef _LINUX_LIST_LRU_H
+#define _LINUX_LIST_LRU_H
+/*
+ * Per-node LRU lists for shrinkable caches
+ *
+ * A list_lru splits one logical LRU into a list per NUMA node, each
+ * with its own lock and item count.  Objects are placed on the list
+ * of the node their memory was allocated from, so adding to and
+ * removing from the LRU only contends with other users of the same
+ * node, and reclaim on one node only walks that node's objects.
+ */
+
+#include <linux/list.h>
+#include <linux/nodemask.h>
+#include <linux/spinlock.h>
+
+/* list_lru_walk_cb has to always return one of those */
+enum lru_status {
+	LRU_REMOVED,		/* item removed from list */
+	LRU_ROTATE,		/* item referenced, give another pass */
+	LRU_SKIP,		/* item cannot be locked, skip */
+	LRU_RETRY,		/* item not freeable. May drop the lock
+				   internally, but has to return locked. */
+};
+
+struct list_lru_node {
+	spinlock_t		lock;
+	struct list_head	list;
+	/* kept outside the lock for lockless counting by shrinkers */
+	long			nr_items;
+} ____cacheline_aligned_in_smp;
+
+struct list_lru {
+	struct list_lru_node	*node;
+	nodemask_t		active_nodes;
+};
+
+extern int list_lru_init(struct list_lru *lru);
+extern void list_lru_destroy(struct list_lru *lru);
+
+/**
+ * list_lru_add - add an element to the lru list's tail
+ * @lru: the lru pointer
+ * @item: the item to be added.
+ *
+ * If the element is already part of a list, this function returns doing
+ * nothing.  Therefore the caller does not need to keep state about whether
+ * or not the element already belongs in the list and is allowed to lazy
+ * update it.  The element is queued on the list of the node its memory
+ * belongs to.
+ *
+ * Return value: true if the list was updated, false otherwise
+ */
+extern bool list_lru_add(struct list_lru *lru, struct list_head *item);
+
+/**
+ * list_lru_del - delete an element from the lru list
+ * @lru: the lru pointer
+ * @item: the item to be deleted.
+ *
+ * This function works analogously as list_lru_add in terms of list
+ * manipulation.  The caller does not have to know in advance whether or
+ * not the element is on the list.
+ *
+ * Return value: true if the list was updated, false otherwise
+ */
+extern bool list_lru_del(struct list_lru *lru, struct list_head *item);
+
+/**
+ * list_lru_count_node - return the number of objects on one node's list
+ * @lru: the lru pointer.
+ * @nid: the node id to count from.
+ *
+ * The count is read without taking the node lock, so it is only a
+ * snapshot; it is meant for shrinkers sizing their next scan.
+ */
+extern unsigned long list_lru_count_node(struct list_lru *lru, int nid);
+
+static inline unsigned long list_lru_count(struct list_lru *lru)
+{
+	unsigned long count = 0;
+	int nid;
+
+	for_each_node_mask(nid, lru->active_nodes)
+		count += list_lru_count_node(lru, nid);
+
+	return count;
+}
+
+typedef enum lru_status
+(*list_lru_walk_cb)(struct list_head *item, spinlock_t *lock, void *cb_arg);
+
+/**
+ * list_lru_walk_node - walk one node's list and isolate objects from it
+ * @lru: the lru pointer.
+ * @nid: the node id to scan from.
+ * @isolate: callback function that is responsible for deciding what to do
+ *  with the item currently being scanned
+ * @cb_arg: opaque type that will be passed to @isolate
+ * @nr_to_walk: how many items to scan, decremented as items are visited
+ *
+ * The list is walked oldest first with the node lock held, and @isolate
+ * is called for each item.  An item for which @isolate returns
+ * LRU_REMOVED must have been taken off the list by the callback, usually
+ * onto a private dispose list; LRU_ROTATE moves the item to the tail so
+ * it gets another pass.  The callback may drop the node lock only if it
+ * returns LRU_RETRY, in which case the walk restarts from the head.
+ *
+ * Return value: the number of objects effectively removed from the LRU.
+ */
+extern unsigned long list_lru_walk_node(struct list_lru *lru, int nid,
+					list_lru_walk_cb isolate, void *cb_arg,
+					unsigned long *nr_to_walk);
+
+static inline unsigned long
+list_lru_walk(struct list_lru *lru, list_lru_walk_cb isolate,
+	      void *cb_arg, unsigned long nr_to_walk)
+{
+	unsigned long isolated = 0;
+	int nid;
+
+	for_each_node_mask(nid, lru->active_nodes) {
+		isolated += list_lru_walk_node(lru, nid, isolate,
+					       cb_arg, &nr_to_walk);
+		if (!nr_to_walk)
+			break;
+	}
+	return isolated;
+}
+#endif /* _LINUX_LIST_LRU_H */
@@ -118,8 +118,8 @@ static inline int llist_empty(const struct llist_head *head)
 	return ACCESS_ONCE(head->first) == NULL;
 }
 
-void llist_add(struct llist_node *new, struct llist_head *head);
-void llist_add_batch(struct llist_node *new_first, struct llist_node *new_last,
+bool llist_add(struct llist_node *new, struct llist_head *head);
+bool llist_add_batch(struct llist_node *new_first, struct llist_node *new_last,
 		     struct llist_head *head);
 struct llist_node *llist_del_first(struct llist_head *head);
 struct llist_node *llist_del_all(struct llist_head *head);
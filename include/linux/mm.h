@@ -193,6 +193,9 @@ struct vm_fault {
 					 * is set (which is also implied by
 					 * VM_FAULT_ERROR).
 					 */
+	/* for ->map_pages() only */
+	pgoff_t max_pgoff;		/* Map pages up to this offset */
+	pte_t *pte;			/* pte entry of virtual_address */
 };
 
 /*
@@ -205,6 +208,11 @@ struct vm_operations_struct {
 	void (*close)(struct vm_area_struct * area);
 	int (*fault)(struct vm_area_struct *vma, struct vm_fault *vmf);
 
+	/* map the pages from vmf->pgoff to vmf->max_pgoff that are ready
+	 * without blocking, starting at vmf->virtual_address and vmf->pte;
+	 * called with the page table lock held, must not sleep */
+	void (*map_pages)(struct vm_area_struct *vma, struct vm_fault *vmf);
+
 	/* notification that a previously read-only page is about to become
 	 * writable, if an error is returned it will cause a SIGBUS */
 	int (*page_mkwrite)(struct vm_area_struct *vma, struct vm_fault *vmf);
@@ -984,6 +992,10 @@ static inline int fixup_user_fault(struct task_struct *tsk,
 #endif
 
 extern int make_pages_present(unsigned long addr, unsigned long end);
+extern void map_cached_pages(struct vm_area_struct *vma, unsigned long start,
+		unsigned long end);
+extern void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte);
 extern int access_process_vm(struct task_struct *tsk, unsigned long addr, void *buf, int len, int write);
 extern int access_remote_vm(struct mm_struct *mm, unsigned long addr,
 		void *buf, int len, int write);
@@ -1210,9 +1222,82 @@ static inline pmd_t *pmd_alloc(struct mm_struct *mm, pud_t *pud, unsigned long a
 #define pte_lockptr(mm, pmd)	({(void)(pmd); &(mm)->page_table_lock;})
 #endif /* USE_SPLIT_PTLOCKS */
 
+#ifdef CONFIG_FORK_SHARE_PTE
+/*
+ * fork() may let the child map the page tables of the parent's private
+ * anonymous memory instead of copying them (see share_pte_table()).
+ * page->index of such a page table counts the mms mapping it beyond the
+ * first, and is only changed under its page table lock.
+ */
+#define pgtable_share_init(page)	((page)->index = 0)
+
+static inline int pgtable_shared(struct page *table)
+{
+	return table->index != 0;
+}
+
+static inline int pte_table_shared(pmd_t *pmd)
+{
+	return pgtable_shared(pmd_page(*pmd));
+}
+
+extern int sysctl_fork_share_pte;
+extern int unshare_pte_table(struct vm_area_struct *vma, pmd_t *pmd,
+			     unsigned long address);
+extern int try_unshare_pte_table(struct vm_area_struct *vma,
+				 unsigned long address);
+extern int unshare_pte_range(struct vm_area_struct *vma,
+			     unsigned long start, unsigned long end);
+
+/*
+ * Make sure no page table shared by fork() straddles @address, so that
+ * it can become a vma boundary or the edge of a partial unmap.
+ */
+static inline int unshare_pte_boundary(struct vm_area_struct *vma,
+				       unsigned long address)
+{
+	if (!(address & ~PMD_MASK))
+		return 0;
+	return unshare_pte_range(vma, address, address + 1);
+}
+#else
+#define pgtable_share_init(page)	do {} while (0)
+#define pgtable_shared(table)		0
+
+static inline int pte_table_shared(pmd_t *pmd)
+{
+	return 0;
+}
+
+static inline int unshare_pte_table(struct vm_area_struct *vma, pmd_t *pmd,
+				    unsigned long address)
+{
+	return 0;
+}
+
+static inline int try_unshare_pte_table(struct vm_area_struct *vma,
+					unsigned long address)
+{
+	return 0;
+}
+
+static inline int unshare_pte_range(struct vm_area_struct *vma,
+				    unsigned long start, unsigned long end)
+{
+	return 0;
+}
+
+static inline int unshare_pte_boundary(struct vm_area_struct *vma,
+				       unsigned long address)
+{
+	return 0;
+}
+#endif /* CONFIG_FORK_SHARE_PTE */
+
 static inline void pgtable_page_ctor(struct page *page)
 {
 	pte_lock_init(page);
+	pgtable_share_init(page);
 	inc_zone_page_state(page, NR_PAGETABLE);
 }
 
@@ -1428,6 +1513,7 @@ extern void truncate_inode_pages_range(struct address_space *,
 
 /* generic vm_area_ops exported for stackable file systems */
 extern int filemap_fault(struct vm_area_struct *, struct vm_fault *);
+extern void filemap_map_pages(struct vm_area_struct *, struct vm_fault *);
 
 /* mm/page-writeback.c */
 int write_one_page(struct page *page, int wait);
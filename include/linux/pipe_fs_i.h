@@ -28,6 +28,10 @@ struct pipe_buffer {
 
 /**
  *	struct pipe_inode_info - a linux kernel pipe
+ *	@rd_mutex: serializes the readers of the pipe
+ *	@wr_mutex: serializes the writers of the pipe
+ *	@ring_lock: protects @nrbufs, @curbuf and the length of the last
+ *		buffer between a reader and a writer running concurrently
  *	@wait: reader/writer wait point in case of empty/full pipe
  *	@nrbufs: the number of non-empty pipe buffers in this pipe
  *	@buffers: total number of buffers (should be a power of 2)
@@ -44,6 +48,9 @@ struct pipe_buffer {
  *	@bufs: the circular array of pipe buffers
  **/
 struct pipe_inode_info {
+	struct mutex rd_mutex;
+	struct mutex wr_mutex;
+	spinlock_t ring_lock;
 	wait_queue_head_t wait;
 	unsigned int nrbufs, curbuf, buffers;
 	unsigned int readers;
@@ -144,7 +151,7 @@ extern unsigned int pipe_max_size, pipe_min_size;
 int pipe_proc_fn(struct ctl_table *, int, void __user *, size_t *, loff_t *);
 
 
-/* Drop the inode semaphore and wait for a pipe event, atomically */
+/* Drop the pipe lock and wait for a pipe event, atomically */
 void pipe_wait(struct pipe_inode_info *pipe);
 
 struct pipe_inode_info * alloc_pipe_info(struct inode * inode);
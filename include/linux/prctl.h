@@ -102,4 +102,13 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Give the process private futexes of this mm a hash table of their own,
+ * with arg2 buckets (0 means "use default").  Only allowed while the
+ * process is single threaded.  PR_GET_FUTEX_HASH returns the number of
+ * buckets, or 0 if the global futex hash is used.
+ */
+#define PR_SET_FUTEX_HASH	35
+#define PR_GET_FUTEX_HASH	36
+
 #endif /* _LINUX_PRCTL_H */
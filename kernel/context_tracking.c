@@ -0,0 +1,124 @@
+/*
+ * Context tracking: Probe on high level context boundaries such as kernel
+ * and userspace. This includes syscalls and exceptions entry/exit.
+ *
+ * This is used by RCU to remove its dependency on the timer tick while a CPU
+ * runs in userspace, and by full dynticks to account cputime on these
+ * boundaries rather than from the tick.
+ *
+ * Only the CPUs flagged with context_tracking_cpu_set() pay for the
+ * probes: the TIF_NOHZ flag that sends syscalls to the slow path is only
+ * set on tasks while they run on such a CPU.
+ */
+
+#include <linux/context_tracking.h>
+#include <linux/kernel_stat.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/hardirq.h>
+
+DEFINE_PER_CPU(struct context_tracking, context_tracking);
+
+void context_tracking_cpu_set(int cpu)
+{
+	per_cpu(context_tracking, cpu).active = true;
+}
+
+/**
+ * user_enter - Inform the context tracking that the CPU is going to
+ *              enter userspace mode.
+ *
+ * This function must be called right before we switch from the kernel
+ * to userspace, when it's guaranteed the remaining kernel instructions
+ * to execute won't use any RCU read side critical section because this
+ * function sets RCU in extended quiescent state.
+ */
+void user_enter(void)
+{
+	unsigned long flags;
+
+	/*
+	 * Some contexts may involve an exception occuring in an irq,
+	 * leading to that nesting:
+	 * rcu_irq_enter() rcu_exit_nohz() rcu_enter_nohz() rcu_irq_exit()
+	 * This would mess up the dyntick_nesting count though. And
+	 * rcu_irq_*() helpers are enough to protect RCU uses inside the
+	 * exception. So just return immediately if we detect we are in
+	 * an IRQ.
+	 */
+	if (in_interrupt())
+		return;
+
+	WARN_ON_ONCE(!current->mm);
+
+	local_irq_save(flags);
+	if (__this_cpu_read(context_tracking.active) &&
+	    __this_cpu_read(context_tracking.state) != IN_USER) {
+		/*
+		 * At this stage, only low level arch entry code remains and
+		 * then we'll run in userspace. We can assume there won't be
+		 * any RCU read-side critical section until the next call to
+		 * user_exit() or rcu_irq_enter(). Let's remove RCU's
+		 * dependency on the tick.
+		 */
+		vtime_account_system(current);
+		__this_cpu_write(context_tracking.state, IN_USER);
+		rcu_enter_nohz();
+	}
+	local_irq_restore(flags);
+}
+
+/**
+ * user_exit - Inform the context tracking that the CPU is
+ *             exiting userspace mode and entering the kernel.
+ *
+ * This function must be called after we entered the kernel from userspace
+ * before any use of RCU read side critical section. This potentially
+ * includes any high level kernel code like syscalls, exceptions, signal
+ * handling, etc...
+ *
+ * This call supports re-entrancy. This way it can be called from any
+ * exception handler without needing to know if we came from userspace
+ * or not.
+ */
+void user_exit(void)
+{
+	unsigned long flags;
+
+	if (in_interrupt())
+		return;
+
+	local_irq_save(flags);
+	if (__this_cpu_read(context_tracking.state) == IN_USER) {
+		/*
+		 * We are going to run code that may use RCU. Inform
+		 * RCU core about that (ie: we may need the tick again).
+		 */
+		rcu_exit_nohz();
+		vtime_account_user(current);
+		__this_cpu_write(context_tracking.state, IN_KERNEL);
+	}
+	local_irq_restore(flags);
+}
+
+/**
+ * context_tracking_task_switch - context switch the syscall callbacks
+ * @prev: the task that is being switched out
+ * @next: the task that is being switched in
+ *
+ * The context tracking uses the syscall slow path to implement its user-kernel
+ * boundaries probes on syscalls. This way it doesn't impact the syscall fast
+ * path on CPUs that don't do context tracking.
+ *
+ * But we need to clear the flag on the previous task because it may later
+ * migrate to some CPU that doesn't do the context tracking. As such the TIF
+ * flag may not be desired there.
+ */
+void context_tracking_task_switch(struct task_struct *prev,
+				  struct task_struct *next)
+{
+	if (__this_cpu_read(context_tracking.active)) {
+		clear_tsk_thread_flag(prev, TIF_NOHZ);
+		set_tsk_thread_flag(next, TIF_NOHZ);
+	}
+}
@@ -59,6 +59,8 @@
 #include <linux/magic.h>
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
+#include <linux/bootmem.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -66,7 +68,6 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
 
 /*
  * Futex flags used to encode options to functions and preserve them across
@@ -140,24 +141,49 @@ static const struct futex_q futex_q_init = {
 /*
  * Hash buckets are shared by all the futex_keys that hash to the same
  * location.  Each key may have multiple futex_q structures, one for each task
- * waiting on a futex.
+ * waiting on a futex.  Buckets are cacheline aligned so that contention
+ * on one bucket lock does not slow down its neighbours.
  */
 struct futex_hash_bucket {
 	spinlock_t lock;
 	struct plist_head chain;
-};
+} ____cacheline_aligned_in_smp;
+
+/*
+ * The global hash is sized at boot in proportion to the number of
+ * possible cpus; it is always a power of two.
+ */
+static unsigned long __read_mostly futex_hashsize;
+static struct futex_hash_bucket *futex_queues;
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/*
+ * Bounds on the size of a per-mm private hash, see futex_set_private_hash().
+ */
+#define FUTEX_PRIVATE_HASH_MIN	16
+#define FUTEX_PRIVATE_HASH_MAX	4096
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
+ *
+ * Process private keys go to the private hash of their mm if it has one,
+ * so that futex storms in one process do not contend on the buckets used
+ * by everybody else.  The private hash only ever changes while the mm is
+ * used by a single thread, see futex_set_private_hash().
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+
+	if (!(key->both.offset & (FUT_OFF_INODE|FUT_OFF_MMSHARED))) {
+		struct mm_struct *mm = key->private.mm;
+		struct futex_hash_bucket *fh = ACCESS_ONCE(mm->futex_hash);
+
+		if (fh)
+			return &fh[hash & (mm->futex_hash_size - 1)];
+	}
+	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
 /*
@@ -2708,10 +2734,82 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 	return do_futex(uaddr, op, val, tp, uaddr2, val2, val3);
 }
 
+/**
+ * futex_set_private_hash() - Give the current mm a futex hash of its own
+ * @slots:	number of hash buckets, 0 picks a default based on the cpu count
+ *
+ * From now on the process private futexes of the current mm are hashed
+ * into their own table instead of the global one shared by every process.
+ * The switch is only allowed while the mm is used by a single thread, so
+ * that no private futex can be queued in the global hash at that time;
+ * the table cannot be changed once set up.  It is not inherited across
+ * fork() or exec().
+ *
+ * Returns the number of buckets on success, a negative error otherwise.
+ */
+int futex_set_private_hash(unsigned long slots)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_hash_bucket *fh;
+	unsigned long i;
+
+	if (!mm)
+		return -EINVAL;
+
+	if (!slots)
+		slots = 4 * num_possible_cpus();
+	slots = clamp_t(unsigned long, slots, FUTEX_PRIVATE_HASH_MIN,
+			FUTEX_PRIVATE_HASH_MAX);
+	slots = roundup_pow_of_two(slots);
+
+	if (mm->futex_hash || !current_is_single_threaded())
+		return -EBUSY;
+
+	fh = kmalloc(slots * sizeof(*fh), GFP_KERNEL);
+	if (!fh)
+		return -ENOMEM;
+
+	for (i = 0; i < slots; i++) {
+		plist_head_init(&fh[i].chain);
+		spin_lock_init(&fh[i].lock);
+	}
+
+	mm->futex_hash_size = slots;
+	/* publish the initialized table for threads created later on */
+	smp_wmb();
+	mm->futex_hash = fh;
+
+	return slots;
+}
+
+/*
+ * Returns the number of buckets in the private futex hash of the current
+ * mm, or 0 if its private futexes use the global hash.
+ */
+int futex_get_private_hash(void)
+{
+	struct mm_struct *mm = current->mm;
+
+	if (!mm || !mm->futex_hash)
+		return 0;
+	return mm->futex_hash_size;
+}
+
+/*
+ * Called when the last reference to @mm is dropped; nobody can be
+ * queued on its private hash anymore.
+ */
+void futex_free_private_hash(struct mm_struct *mm)
+{
+	kfree(mm->futex_hash);
+	mm->futex_hash = NULL;
+}
+
 static int __init futex_init(void)
 {
+	unsigned int futex_shift;
+	unsigned long i;
 	u32 curval;
-	int i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2726,7 +2824,19 @@ static int __init futex_init(void)
 	if (cmpxchg_futex_value_locked(&curval, NULL, 0, 0) == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
+#if CONFIG_BASE_SMALL
+	futex_hashsize = 16;
+#else
+	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+
+	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
+					       futex_hashsize, 0, 0,
+					       &futex_shift, NULL,
+					       futex_hashsize);
+	futex_hashsize = 1UL << futex_shift;
+
+	for (i = 0; i < futex_hashsize; i++) {
 		plist_head_init(&futex_queues[i].chain);
 		spin_lock_init(&futex_queues[i].lock);
 	}
@@ -0,0 +1,483 @@
+/*
+ * Module-based torture test and throughput benchmark for sleeping and
+ * spinning locks, modelled on the RCU torture test.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * See also:  Documentation/locktorture.txt
+ */
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/sched.h>
+#include <linux/atomic.h>
+#include <linux/moduleparam.h>
+#include <linux/delay.h>
+#include <linux/jiffies.h>
+#include <linux/slab.h>
+
+MODULE_LICENSE("GPL");
+
+static int nwriters_stress = -1; /* # writer threads, defaults to 2*ncpus */
+static int nreaders_stress = -1; /* # reader threads, defaults to ncpus */
+static int write_hold = 1;	/* Write-side critical section (us). */
+static int read_hold = 1;	/* Read-side critical section (us). */
+static int stat_interval = 60;	/* Interval between stats, in seconds. */
+				/*  0 means "only at end of test". */
+static int verbose;		/* Print more debug info. */
+static char *torture_type = "rwsem_lock"; /* What lock to torture. */
+
+module_param(nwriters_stress, int, 0444);
+MODULE_PARM_DESC(nwriters_stress, "Number of write-locking stress-test threads");
+module_param(nreaders_stress, int, 0444);
+MODULE_PARM_DESC(nreaders_stress, "Number of read-locking stress-test threads");
+module_param(write_hold, int, 0444);
+MODULE_PARM_DESC(write_hold, "Write-side critical section length (us)");
+module_param(read_hold, int, 0444);
+MODULE_PARM_DESC(read_hold, "Read-side critical section length (us)");
+module_param(stat_interval, int, 0444);
+MODULE_PARM_DESC(stat_interval, "Number of seconds between stats printk()s");
+module_param(verbose, bool, 0444);
+MODULE_PARM_DESC(verbose, "Enable verbose debugging printk()s");
+module_param(torture_type, charp, 0444);
+MODULE_PARM_DESC(torture_type,
+		 "Type of lock to torture (spin_lock, mutex_lock, rwsem_lock)");
+
+#define TORTURE_FLAG "-torture:"
+#define PRINTK_STRING(s) \
+	do { printk(KERN_ALERT "%s" TORTURE_FLAG s "\n", torture_type); } while (0)
+#define VERBOSE_PRINTK_STRING(s) \
+	do { if (verbose) printk(KERN_ALERT "%s" TORTURE_FLAG s "\n", torture_type); } while (0)
+
+static int nrealwriters;
+static int nrealreaders;
+static struct task_struct **writer_tasks;
+static struct task_struct **reader_tasks;
+static struct task_struct *stats_task;
+
+/*
+ * Per-thread counters, summed up by the statistics code.  Each thread
+ * only ever writes its own slot, so no atomics are needed here.
+ */
+struct lock_stress_stats {
+	long n_lock_fail;
+	long n_lock_acquired;
+} ____cacheline_aligned_in_smp;
+
+static struct lock_stress_stats *writer_stats;
+static struct lock_stress_stats *reader_stats;
+
+static int lock_is_write_held;
+static atomic_t lock_is_read_held;
+static unsigned long lock_torture_start;	/* jiffies at test start */
+
+/*
+ * Operations vector for selecting different types of locks.
+ * Exclusive locks leave the read-side hooks NULL.
+ */
+struct lock_torture_ops {
+	void (*init)(void);
+	void (*writelock)(void);
+	void (*write_delay)(void);
+	void (*writeunlock)(void);
+	void (*readlock)(void);
+	void (*read_delay)(void);
+	void (*readunlock)(void);
+	const char *name;
+};
+
+static struct lock_torture_ops *cur_ops;
+
+static void torture_write_delay(void)
+{
+	if (write_hold > 0)
+		udelay(write_hold);
+}
+
+static void torture_read_delay(void)
+{
+	if (read_hold > 0)
+		udelay(read_hold);
+}
+
+/*
+ * Spinlock definitions.
+ */
+
+static DEFINE_SPINLOCK(torture_spinlock);
+
+static void torture_spin_lock_write_lock(void) __acquires(torture_spinlock)
+{
+	spin_lock(&torture_spinlock);
+}
+
+static void torture_spin_lock_write_unlock(void) __releases(torture_spinlock)
+{
+	spin_unlock(&torture_spinlock);
+}
+
+static struct lock_torture_ops spin_lock_ops = {
+	.writelock	= torture_spin_lock_write_lock,
+	.write_delay	= torture_write_delay,
+	.writeunlock	= torture_spin_lock_write_unlock,
+	.name		= "spin_lock"
+};
+
+/*
+ * Mutex definitions.
+ */
+
+static DEFINE_MUTEX(torture_mutex);
+
+static void torture_mutex_lock(void) __acquires(torture_mutex)
+{
+	mutex_lock(&torture_mutex);
+}
+
+static void torture_mutex_unlock(void) __releases(torture_mutex)
+{
+	mutex_unlock(&torture_mutex);
+}
+
+static struct lock_torture_ops mutex_lock_ops = {
+	.writelock	= torture_mutex_lock,
+	.write_delay	= torture_write_delay,
+	.writeunlock	= torture_mutex_unlock,
+	.name		= "mutex_lock"
+};
+
+/*
+ * Read-write semaphore definitions.
+ */
+
+static DECLARE_RWSEM(torture_rwsem);
+
+static void torture_rwsem_down_write(void) __acquires(torture_rwsem)
+{
+	down_write(&torture_rwsem);
+}
+
+static void torture_rwsem_up_write(void) __releases(torture_rwsem)
+{
+	up_write(&torture_rwsem);
+}
+
+static void torture_rwsem_down_read(void) __acquires(torture_rwsem)
+{
+	down_read(&torture_rwsem);
+}
+
+static void torture_rwsem_up_read(void) __releases(torture_rwsem)
+{
+	up_read(&torture_rwsem);
+}
+
+static struct lock_torture_ops rwsem_lock_ops = {
+	.writelock	= torture_rwsem_down_write,
+	.write_delay	= torture_write_delay,
+	.writeunlock	= torture_rwsem_up_write,
+	.readlock	= torture_rwsem_down_read,
+	.read_delay	= torture_read_delay,
+	.readunlock	= torture_rwsem_up_read,
+	.name		= "rwsem_lock"
+};
+
+/*
+ * Lock torture writer kthread.  Repeatedly acquires and releases
+ * the lock, checking for exclusion violations along the way.
+ */
+static int lock_torture_writer(void *arg)
+{
+	struct lock_stress_stats *lwsp = arg;
+
+	VERBOSE_PRINTK_STRING("lock_torture_writer task started");
+	set_user_nice(current, 19);
+
+	do {
+		cur_ops->writelock();
+		if (WARN_ON_ONCE(lock_is_write_held ||
+				 atomic_read(&lock_is_read_held)))
+			lwsp->n_lock_fail++;
+		lock_is_write_held = 1;
+		lwsp->n_lock_acquired++;
+		cur_ops->write_delay();
+		lock_is_write_held = 0;
+		cur_ops->writeunlock();
+		cond_resched();
+	} while (!kthread_should_stop());
+	VERBOSE_PRINTK_STRING("lock_torture_writer task stopping");
+	return 0;
+}
+
+/*
+ * Lock torture reader kthread.  Repeatedly acquires and releases
+ * the lock for read, checking that no writer got in alongside.
+ */
+static int lock_torture_reader(void *arg)
+{
+	struct lock_stress_stats *lrsp = arg;
+
+	VERBOSE_PRINTK_STRING("lock_torture_reader task started");
+	set_user_nice(current, 19);
+
+	do {
+		cur_ops->readlock();
+		atomic_inc(&lock_is_read_held);
+		if (WARN_ON_ONCE(lock_is_write_held))
+			lrsp->n_lock_fail++;
+		lrsp->n_lock_acquired++;
+		cur_ops->read_delay();
+		atomic_dec(&lock_is_read_held);
+		cur_ops->readunlock();
+		cond_resched();
+	} while (!kthread_should_stop());
+	VERBOSE_PRINTK_STRING("lock_torture_reader task stopping");
+	return 0;
+}
+
+/*
+ * Sum up the per-thread counters and report them along with the
+ * throughput since the start of the test.
+ */
+static void __lock_torture_print_stats(const char *what,
+				       struct lock_stress_stats *statp, int n,
+				       unsigned long secs, long *fail)
+{
+	long sum = 0, fails = 0;
+	long min = 0, max = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (i == 0 || statp[i].n_lock_acquired < min)
+			min = statp[i].n_lock_acquired;
+		if (statp[i].n_lock_acquired > max)
+			max = statp[i].n_lock_acquired;
+		sum += statp[i].n_lock_acquired;
+		fails += statp[i].n_lock_fail;
+	}
+	*fail += fails;
+	printk(KERN_ALERT "%s" TORTURE_FLAG " %s: Total: %ld Max/Min: %ld/%ld "
+	       "%s Fail: %ld ops/sec: %lu\n", torture_type, what, sum, max, min,
+	       max / 2 > min ? "???" : "", fails, secs ? sum / secs : 0);
+}
+
+static long lock_torture_stats_print(void)
+{
+	unsigned long secs = (jiffies - lock_torture_start) / HZ;
+	long fail = 0;
+
+	__lock_torture_print_stats("Writes", writer_stats, nrealwriters,
+				   secs, &fail);
+	if (cur_ops->readlock)
+		__lock_torture_print_stats("Reads", reader_stats, nrealreaders,
+					   secs, &fail);
+	return fail;
+}
+
+/*
+ * Periodically prints torture statistics, if periodic statistics printing
+ * was specified via the stat_interval module parameter.
+ */
+static int lock_torture_stats(void *arg)
+{
+	VERBOSE_PRINTK_STRING("lock_torture_stats task started");
+	do {
+		schedule_timeout_interruptible(stat_interval * HZ);
+		lock_torture_stats_print();
+	} while (!kthread_should_stop());
+	VERBOSE_PRINTK_STRING("lock_torture_stats task stopping");
+	return 0;
+}
+
+static void lock_torture_print_module_parms(const char *tag)
+{
+	printk(KERN_ALERT "%s" TORTURE_FLAG "--- %s: nwriters_stress=%d "
+	       "nreaders_stress=%d write_hold=%d read_hold=%d "
+	       "stat_interval=%d verbose=%d\n",
+	       torture_type, tag, nrealwriters, nrealreaders, write_hold,
+	       read_hold, stat_interval, verbose);
+}
+
+static void lock_torture_stop_tasks(struct task_struct **tasks, int n)
+{
+	int i;
+
+	if (!tasks)
+		return;
+	for (i = 0; i < n; i++) {
+		if (tasks[i])
+			kthread_stop(tasks[i]);
+		tasks[i] = NULL;
+	}
+	kfree(tasks);
+}
+
+static void lock_torture_cleanup(void)
+{
+	long fail = 0;
+
+	lock_torture_stop_tasks(writer_tasks, nrealwriters);
+	writer_tasks = NULL;
+	lock_torture_stop_tasks(reader_tasks, nrealreaders);
+	reader_tasks = NULL;
+
+	if (stats_task) {
+		VERBOSE_PRINTK_STRING("Stopping lock_torture_stats task");
+		kthread_stop(stats_task);
+	}
+	stats_task = NULL;
+
+	/* -After- the stats thread is stopped! */
+	if (writer_stats)
+		fail = lock_torture_stats_print();
+	kfree(writer_stats);
+	writer_stats = NULL;
+	kfree(reader_stats);
+	reader_stats = NULL;
+
+	if (fail)
+		lock_torture_print_module_parms("End of test: FAILURE");
+	else
+		lock_torture_print_module_parms("End of test: SUCCESS");
+}
+
+static struct task_struct **lock_torture_start_tasks(int (*fn)(void *),
+						     struct lock_stress_stats *statp,
+						     int n, const char *name)
+{
+	struct task_struct **tasks;
+	int i;
+
+	tasks = kzalloc(n * sizeof(tasks[0]), GFP_KERNEL);
+	if (!tasks)
+		return ERR_PTR(-ENOMEM);
+
+	for (i = 0; i < n; i++) {
+		tasks[i] = kthread_run(fn, &statp[i], "%s", name);
+		if (IS_ERR(tasks[i])) {
+			int err = PTR_ERR(tasks[i]);
+
+			tasks[i] = NULL;
+			lock_torture_stop_tasks(tasks, n);
+			return ERR_PTR(err);
+		}
+	}
+	return tasks;
+}
+
+static int __init lock_torture_init(void)
+{
+	int i;
+	int firsterr = 0;
+	static struct lock_torture_ops *torture_ops[] = {
+		&spin_lock_ops, &mutex_lock_ops, &rwsem_lock_ops,
+	};
+
+	/* Process args and tell the world that the torturer is on the job. */
+	for (i = 0; i < ARRAY_SIZE(torture_ops); i++) {
+		cur_ops = torture_ops[i];
+		if (strcmp(torture_type, cur_ops->name) == 0)
+			break;
+	}
+	if (i == ARRAY_SIZE(torture_ops)) {
+		printk(KERN_ALERT "lock-torture: invalid torture type: \"%s\"\n",
+		       torture_type);
+		printk(KERN_ALERT "lock-torture types:");
+		for (i = 0; i < ARRAY_SIZE(torture_ops); i++)
+			printk(KERN_ALERT " %s", torture_ops[i]->name);
+		printk(KERN_ALERT "\n");
+		return -EINVAL;
+	}
+	if (cur_ops->init)
+		cur_ops->init();
+
+	if (nwriters_stress >= 0)
+		nrealwriters = nwriters_stress;
+	else
+		nrealwriters = 2 * num_online_cpus();
+
+	if (!cur_ops->readlock)
+		nrealreaders = 0;
+	else if (nreaders_stress >= 0)
+		nrealreaders = nreaders_stress;
+	else
+		nrealreaders = num_online_cpus();
+
+	if (nrealwriters + nrealreaders == 0) {
+		printk(KERN_ALERT "lock-torture: no stress-test threads\n");
+		return -EINVAL;
+	}
+	lock_torture_print_module_parms("Start of test");
+
+	/* Set up the stats and the stress-test kthreads. */
+
+	writer_stats = kzalloc(nrealwriters * sizeof(writer_stats[0]),
+			       GFP_KERNEL);
+	reader_stats = kzalloc(nrealreaders * sizeof(reader_stats[0]),
+			       GFP_KERNEL);
+	if ((nrealwriters && !writer_stats) ||
+	    (nrealreaders && !reader_stats)) {
+		VERBOSE_PRINTK_STRING("out of memory");
+		firsterr = -ENOMEM;
+		goto unwind;
+	}
+
+	lock_torture_start = jiffies;
+
+	writer_tasks = lock_torture_start_tasks(lock_torture_writer,
+						writer_stats, nrealwriters,
+						"lock_torture_writer");
+	if (IS_ERR(writer_tasks)) {
+		firsterr = PTR_ERR(writer_tasks);
+		writer_tasks = NULL;
+		PRINTK_STRING("Failed to create writer");
+		goto unwind;
+	}
+
+	reader_tasks = lock_torture_start_tasks(lock_torture_reader,
+						reader_stats, nrealreaders,
+						"lock_torture_reader");
+	if (IS_ERR(reader_tasks)) {
+		firsterr = PTR_ERR(reader_tasks);
+		reader_tasks = NULL;
+		PRINTK_STRING("Failed to create reader");
+		goto unwind;
+	}
+
+	if (stat_interval > 0) {
+		stats_task = kthread_run(lock_torture_stats, NULL,
+					 "lock_torture_stats");
+		if (IS_ERR(stats_task)) {
+			firsterr = PTR_ERR(stats_task);
+			stats_task = NULL;
+			PRINTK_STRING("Failed to create stats");
+			goto unwind;
+		}
+	}
+	return 0;
+
+unwind:
+	lock_torture_cleanup();
+	return firsterr;
+}
+
+module_init(lock_torture_init);
+module_exit(lock_torture_cleanup);
@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/wait.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS and CONFIG_RCU_FANOUT.
@@ -298,6 +299,25 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 6) Callback offloading. */
+	struct rcu_head *nocb_head;	/* CBs waiting for kthread. */
+	struct rcu_head **nocb_tail;
+	atomic_long_t nocb_q_count;	/* # CBs waiting for kthread */
+	long nocb_p_count;		/* # CBs being handled by kthread */
+	bool nocb_defer_wakeup;		/* Wake kthread from softirq. */
+	struct rcu_head *nocb_gp_head;	/* CBs waiting for the kthread's */
+	struct rcu_head **nocb_gp_tail;	/*  grace period. */
+	struct rcu_data *nocb_leader;	/* First CPU of our group, */
+					/*  NULL if not offloaded. */
+	struct rcu_data *nocb_next_follower;
+					/* Next CPU in our group. */
+	/* The following fields are used by the leader only. */
+	wait_queue_head_t nocb_wq;	/* For the kthread to sleep on. */
+	struct task_struct *nocb_kthread;
+	struct rcu_state *rsp;
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 };
 
@@ -394,6 +414,7 @@ struct rcu_state {
 	unsigned long gp_max;			/* Maximum GP duration in */
 						/*  jiffies. */
 	char *name;				/* Name of structure. */
+	char abbr;				/* Abbreviated name. */
 };
 
 /* Return values for rcu_preempt_offline_tasks(). */
@@ -466,5 +487,13 @@ static void rcu_yield(void (*f)(unsigned long), unsigned long arg);
 #endif /* #ifdef CONFIG_RCU_BOOST */
 static void rcu_cpu_kthread_setrt(int cpu, int to_rt);
 static void __cpuinit rcu_prepare_kthreads(int cpu);
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *rhp,
+			     bool irqs_disabled);
+static bool rcu_nocb_need_deferred_wakeup(struct rcu_data *rdp);
+static void rcu_nocb_do_deferred_wakeup(struct rcu_data *rdp);
+static int rcu_nocb_needs_cpu(int cpu);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_state *rsp,
+						  struct rcu_data *rdp);
+static void __init rcu_init_nocb(void);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
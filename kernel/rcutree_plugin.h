@@ -26,6 +26,7 @@
 
 #include <linux/delay.h>
 #include <linux/stop_machine.h>
+#include <linux/tick.h>
 
 /*
  * Check the RCU kernel configuration parameters and print informative
@@ -64,7 +65,8 @@ static void __init rcu_bootup_announce_oddness(void)
 
 #ifdef CONFIG_TREE_PREEMPT_RCU
 
-struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt_state);
+struct rcu_state rcu_preempt_state =
+	RCU_STATE_INITIALIZER(rcu_preempt_state, 'p');
 DEFINE_PER_CPU(struct rcu_data, rcu_preempt_data);
 static struct rcu_state *rcu_state = &rcu_preempt_state;
 
@@ -2008,3 +2010,344 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload callback processing from the boot-parameter-specified CPUs
+ * (rcu_nocbs=) to kthreads.  call_rcu() on such a CPU appends the
+ * callback to a lockless per-CPU list and, if the list was empty, wakes
+ * up the rcuo kthread of the group of CPUs it belongs to.  The kthread
+ * then waits for a grace period on behalf of the whole group and invokes
+ * the callbacks.  The offloaded CPUs therefore never run callbacks and
+ * never need the RCU core to advance them, while the kthreads can be
+ * placed on housekeeping CPUs.  The boot CPU is never offloaded, so that
+ * there is always a CPU for the rcuo kthreads to run on.
+ */
+
+static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
+static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
+static int rcu_nocb_group_size;	    /* CPUs per rcuo kthread, 0 = sqrt. */
+module_param(rcu_nocb_group_size, int, 0444);
+
+/* Parse the boot-time rcu_nocbs= CPU list from the kernel parameters. */
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/*
+ * Enqueue the specified callback onto the specified CPU's offload list,
+ * returning false if that CPU doesn't offload its callbacks.  Only the
+ * first callback of an empty list needs to wake up the kthread; with
+ * irqs disabled the caller might hold a scheduler lock, so leave that
+ * to the RCU softirq instead.  Called with irqs disabled.
+ */
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *rhp,
+			     bool irqs_disabled)
+{
+	struct rcu_head **old_rhpp;
+
+	if (!rdp->nocb_leader)
+		return false;
+
+	old_rhpp = xchg(&rdp->nocb_tail, &rhp->next);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+	atomic_long_inc(&rdp->nocb_q_count);
+
+	if (old_rhpp != &rdp->nocb_head)
+		return true;
+	if (irqs_disabled)
+		ACCESS_ONCE(rdp->nocb_defer_wakeup) = true;
+	else
+		wake_up(&rdp->nocb_leader->nocb_wq);
+	return true;
+}
+
+static bool rcu_nocb_need_deferred_wakeup(struct rcu_data *rdp)
+{
+	return ACCESS_ONCE(rdp->nocb_defer_wakeup);
+}
+
+static void rcu_nocb_do_deferred_wakeup(struct rcu_data *rdp)
+{
+	if (!rcu_nocb_need_deferred_wakeup(rdp))
+		return;
+	ACCESS_ONCE(rdp->nocb_defer_wakeup) = false;
+	wake_up(&rdp->nocb_leader->nocb_wq);
+}
+
+/*
+ * A pending deferred wakeup keeps the tick alive until the RCU softirq
+ * has taken care of it.  The callbacks themselves don't need this CPU.
+ */
+static int rcu_nocb_needs_cpu(int cpu)
+{
+	return rcu_nocb_need_deferred_wakeup(&per_cpu(rcu_sched_data, cpu)) ||
+	       rcu_nocb_need_deferred_wakeup(&per_cpu(rcu_bh_data, cpu)) ||
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	       rcu_nocb_need_deferred_wakeup(&per_cpu(rcu_preempt_data, cpu)) ||
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	       0;
+}
+
+/* Does any CPU of the group led by the specified rcu_data have callbacks? */
+static bool rcu_nocb_group_has_cbs(struct rcu_data *leader)
+{
+	struct rcu_data *rdp;
+
+	for (rdp = leader; rdp; rdp = rdp->nocb_next_follower)
+		if (ACCESS_ONCE(rdp->nocb_head))
+			return true;
+	return false;
+}
+
+/*
+ * Wait for a grace period of the specified flavor.  This cannot simply
+ * use the flavor's call_rcu(), as an rcuo kthread that has been affined
+ * to an offloaded CPU would then wait for its own (or another group's)
+ * callback list.  Queue the wakeup on the current CPU's regular list
+ * instead, which is serviced by the RCU softirq on every CPU.
+ */
+static void rcu_nocb_wait_gp(struct rcu_state *rsp)
+{
+	struct rcu_synchronize rcu;
+	struct rcu_data *rdp;
+	unsigned long flags;
+
+	init_rcu_head_on_stack(&rcu.head);
+	init_completion(&rcu.completion);
+	debug_rcu_head_queue(&rcu.head);
+	rcu.head.func = wakeme_after_rcu;
+	rcu.head.next = NULL;
+
+	smp_mb(); /* Order prior callback grabbing with the new callback. */
+
+	local_irq_save(flags);
+	rdp = this_cpu_ptr(rsp->rda);
+	*rdp->nxttail[RCU_NEXT_TAIL] = &rcu.head;
+	rdp->nxttail[RCU_NEXT_TAIL] = &rcu.head.next;
+	rdp->qlen++;
+	local_irq_restore(flags);
+
+	wait_for_completion(&rcu.completion);
+	destroy_rcu_head_on_stack(&rcu.head);
+}
+
+/* Invoke the callbacks of the specified CPU that waited for a GP. */
+static void rcu_nocb_invoke(struct rcu_data *rdp)
+{
+	struct rcu_head *list = rdp->nocb_gp_head;
+	struct rcu_head **tail = rdp->nocb_gp_tail;
+	struct rcu_head *next;
+	long count = 0;
+
+	while (list) {
+		next = list->next;
+		/* Wait for a racing call_rcu() to finish its enqueue. */
+		while (next == NULL && &list->next != tail) {
+			cpu_relax();
+			next = ACCESS_ONCE(list->next);
+		}
+		debug_rcu_head_unqueue(list);
+		local_bh_disable();
+		__rcu_reclaim(list);
+		local_bh_enable();
+		list = next;
+		count++;
+		cond_resched();
+	}
+	rdp->nocb_gp_head = NULL;
+	ACCESS_ONCE(rdp->nocb_p_count) -= count;
+	ACCESS_ONCE(rdp->n_cbs_invoked) += count;
+}
+
+/*
+ * Per-group kthread: wait for callbacks on any CPU of the group, move
+ * them all aside, wait for one grace period covering all of them and
+ * finally invoke them.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *leader = arg;
+	struct rcu_data *rdp;
+	struct rcu_head *list;
+
+	for (;;) {
+		wait_event_interruptible(leader->nocb_wq,
+					 rcu_nocb_group_has_cbs(leader));
+
+		for (rdp = leader; rdp; rdp = rdp->nocb_next_follower) {
+			list = ACCESS_ONCE(rdp->nocb_head);
+			if (!list)
+				continue;
+			ACCESS_ONCE(rdp->nocb_head) = NULL;
+			rdp->nocb_gp_head = list;
+			rdp->nocb_gp_tail = xchg(&rdp->nocb_tail,
+						 &rdp->nocb_head);
+			ACCESS_ONCE(rdp->nocb_p_count) +=
+				atomic_long_xchg(&rdp->nocb_q_count, 0);
+		}
+
+		rcu_nocb_wait_gp(leader->rsp);
+
+		for (rdp = leader; rdp; rdp = rdp->nocb_next_follower)
+			if (rdp->nocb_gp_head)
+				rcu_nocb_invoke(rdp);
+	}
+	return 0;
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_state *rsp,
+						  struct rcu_data *rdp)
+{
+	rdp->nocb_tail = &rdp->nocb_head;
+	rdp->rsp = rsp;
+}
+
+/*
+ * Split the offloaded CPUs of the specified flavor into groups of
+ * rcu_nocb_group_size CPUs, each served by the kthread of its first CPU.
+ */
+static void __init rcu_organize_nocb_kthreads(struct rcu_state *rsp)
+{
+	int cpu;
+	int nr = 0;
+	int group_size = rcu_nocb_group_size;
+	struct rcu_data *rdp;
+	struct rcu_data *leader = NULL;
+	struct rcu_data *prev = NULL;
+
+	if (group_size <= 0)
+		group_size = int_sqrt(nr_cpu_ids);
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		if (nr++ % group_size == 0) {
+			leader = rdp;
+			init_waitqueue_head(&rdp->nocb_wq);
+		} else {
+			prev->nocb_next_follower = rdp;
+		}
+		rdp->nocb_leader = leader;
+		prev = rdp;
+	}
+}
+
+static char __initdata nocb_buf[NR_CPUS * 5];
+
+static void __init rcu_init_nocb(void)
+{
+	int cpu = smp_processor_id();
+
+#ifdef CONFIG_NO_HZ_FULL
+	/* Full dynticks CPUs don't want to run callbacks either. */
+	if (tick_nohz_full_running) {
+		if (!have_rcu_nocb_mask) {
+			zalloc_cpumask_var(&rcu_nocb_mask, GFP_KERNEL);
+			have_rcu_nocb_mask = true;
+		}
+		cpumask_or(rcu_nocb_mask, rcu_nocb_mask, tick_nohz_full_mask);
+	}
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
+
+	if (!have_rcu_nocb_mask)
+		return;
+
+	if (cpumask_test_cpu(cpu, rcu_nocb_mask)) {
+		printk(KERN_INFO "\tBoot CPU %d can't offload its callbacks.\n",
+		       cpu);
+		cpumask_clear_cpu(cpu, rcu_nocb_mask);
+	}
+	cpumask_and(rcu_nocb_mask, rcu_nocb_mask, cpu_possible_mask);
+	if (cpumask_empty(rcu_nocb_mask))
+		return;
+
+	cpulist_scnprintf(nocb_buf, sizeof(nocb_buf), rcu_nocb_mask);
+	printk(KERN_INFO "\tOffload RCU callbacks from CPUs: %s.\n", nocb_buf);
+
+	rcu_organize_nocb_kthreads(&rcu_sched_state);
+	rcu_organize_nocb_kthreads(&rcu_bh_state);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_organize_nocb_kthreads(&rcu_preempt_state);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+}
+
+/*
+ * Spawn the rcuo kthreads of the specified flavor, initially affined to
+ * the CPUs that don't offload their callbacks.
+ */
+static void __init rcu_spawn_nocb_kthreads_one(struct rcu_state *rsp,
+					       const struct cpumask *cm)
+{
+	int cpu;
+	struct rcu_data *rdp;
+	struct task_struct *t;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		if (rdp->nocb_leader != rdp)
+			continue;
+		t = kthread_create(rcu_nocb_kthread, rdp,
+				   "rcuo%c/%d", rsp->abbr, cpu);
+		BUG_ON(IS_ERR(t));
+		set_cpus_allowed_ptr(t, cm);
+		rdp->nocb_kthread = t;
+		wake_up_process(t);
+	}
+}
+
+static int __init rcu_spawn_nocb_kthreads(void)
+{
+	cpumask_var_t cm;
+
+	if (!have_rcu_nocb_mask || cpumask_empty(rcu_nocb_mask))
+		return 0;
+	if (!alloc_cpumask_var(&cm, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_andnot(cm, cpu_possible_mask, rcu_nocb_mask);
+	rcu_spawn_nocb_kthreads_one(&rcu_sched_state, cm);
+	rcu_spawn_nocb_kthreads_one(&rcu_bh_state, cm);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads_one(&rcu_preempt_state, cm);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	free_cpumask_var(cm);
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *rhp,
+			     bool irqs_disabled)
+{
+	return false;
+}
+
+static bool rcu_nocb_need_deferred_wakeup(struct rcu_data *rdp)
+{
+	return false;
+}
+
+static void rcu_nocb_do_deferred_wakeup(struct rcu_data *rdp)
+{
+}
+
+static int rcu_nocb_needs_cpu(int cpu)
+{
+	return 0;
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_state *rsp,
+						  struct rcu_data *rdp)
+{
+}
+
+static void __init rcu_init_nocb(void)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -68,7 +68,14 @@ SCHED_FEAT(NONTASK_POWER, 1)
 /*
  * Queue remote wakeups on the target CPU and process them
  * using the scheduler IPI. Reduces rq->lock contention/bounces.
+ * Only done when waker and wakee do not share a last level cache.
  */
 SCHED_FEAT(TTWU_QUEUE, 1)
 
+/*
+ * Bound the select_idle_sibling() scan of the LLC domain by the ratio of
+ * the average idle time to the average scan cost.
+ */
+SCHED_FEAT(SIS_PROP, 1)
+
 SCHED_FEAT(FORCE_SD_OVERLAP, 0)
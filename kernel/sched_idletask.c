@@ -24,6 +24,9 @@ static struct task_struct *pick_next_task_idle(struct rq *rq)
 {
 	schedstat_inc(rq, sched_goidle);
 	calc_load_account_idle(rq);
+#ifdef CONFIG_SMP
+	update_idle_core(rq);
+#endif
 	return rq->idle;
 }
 
@@ -4,7 +4,17 @@
  * bump this up when changing the output format or the meaning of an existing
  * format, so that tools can adapt (or abort)
  */
-#define SCHEDSTAT_VERSION 15
+#define SCHEDSTAT_VERSION 17
+
+static void seq_lat_hist(struct seq_file *seq, const char *name, u64 *hist)
+{
+	int i;
+
+	seq_printf(seq, "%s", name);
+	for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+		seq_printf(seq, " %llu", (unsigned long long)hist[i]);
+	seq_putc(seq, '\n');
+}
 
 static int show_schedstat(struct seq_file *seq, void *v)
 {
@@ -26,15 +36,24 @@ static int show_schedstat(struct seq_file *seq, void *v)
 
 		/* runqueue-specific stats */
 		seq_printf(seq,
-		    "cpu%d %u %u %u %u %u %u %llu %llu %lu",
+		    "cpu%d %u %u %u %u %u %u %llu %llu %lu %u %u %llu"
+		    " %u %u %u %u %u %llu",
 		    cpu, rq->yld_count,
 		    rq->sched_switch, rq->sched_count, rq->sched_goidle,
 		    rq->ttwu_count, rq->ttwu_local,
 		    rq->rq_cpu_time,
-		    rq->rq_sched_info.run_delay, rq->rq_sched_info.pcount);
+		    rq->rq_sched_info.run_delay, rq->rq_sched_info.pcount,
+		    rq->ttwu_queued, rq->ttwu_direct,
+		    (unsigned long long)rq->lat_stats.nr_migrations,
+		    rq->sis_search, rq->sis_idle_core, rq->sis_idle_cpu,
+		    rq->sis_failed, rq->sis_scanned, rq->sis_scan_cost);
 
 		seq_printf(seq, "\n");
 
+		/* latency histograms */
+		seq_lat_hist(seq, "wakeup_lat", rq->lat_stats.wakeup);
+		seq_lat_hist(seq, "preempt_lat", rq->lat_stats.preempt);
+
 #ifdef CONFIG_SMP
 		/* domain-specific stats */
 		rcu_read_lock();
@@ -73,7 +92,7 @@ static int show_schedstat(struct seq_file *seq, void *v)
 
 static int schedstat_open(struct inode *inode, struct file *file)
 {
-	unsigned int size = PAGE_SIZE * (1 + num_online_cpus() / 32);
+	unsigned int size = PAGE_SIZE * (1 + num_online_cpus() / 8);
 	char *buf = kmalloc(size, GFP_KERNEL);
 	struct seq_file *m;
 	int res;
@@ -132,6 +151,73 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 	if (rq)
 		rq->rq_sched_info.run_delay += delta;
 }
+
+#ifdef CONFIG_CGROUP_SCHED
+static inline struct sched_lat_stats *
+tg_lat_stats(struct task_group *tg, int cpu)
+{
+	if (tg == &root_task_group)
+		return &cpu_rq(cpu)->lat_stats;
+	return per_cpu_ptr(tg->lat_stats, cpu);
+}
+#endif
+
+static inline void
+__sched_lat_account(struct sched_lat_stats *ls, u64 delay, int preempted,
+		    int queued, u64 nr_migrations)
+{
+	if (queued) {
+		u64 *hist = preempted ? ls->preempt : ls->wakeup;
+
+		hist[min(fls64(delay >> 10), SCHED_LAT_BUCKETS - 1)]++;
+	}
+	ls->nr_migrations += nr_migrations;
+}
+
+/*
+ * Called when a task hits the cpu, @delta being the wait on this cpu's
+ * queue and @queued whether the task was waiting at all.  Waits on other
+ * cpus were collected by sched_lat_dequeued() as the task got moved.
+ *
+ * Expects runqueue lock to be held for atomicity of update
+ */
+static void
+sched_lat_arrive(struct task_struct *t, unsigned long long delta, int queued)
+{
+	struct sched_statistics *stats = &t->se.statistics;
+	struct rq *rq = task_rq(t);
+	u64 delay = stats->lat_delay + delta;
+	u64 nr_migrations = t->se.nr_migrations - stats->lat_nr_migrations;
+	int preempted = stats->lat_preempted;
+#ifdef CONFIG_CGROUP_SCHED
+	struct task_group *tg;
+
+	for (tg = task_group(t); tg != &root_task_group; tg = tg->parent)
+		__sched_lat_account(per_cpu_ptr(tg->lat_stats, cpu_of(rq)),
+				    delay, preempted, queued, nr_migrations);
+#endif
+	__sched_lat_account(&rq->lat_stats, delay, preempted, queued,
+			    nr_migrations);
+
+	stats->lat_delay = 0;
+	stats->lat_nr_migrations = t->se.nr_migrations;
+	stats->lat_preempted = 0;
+}
+
+static inline void
+sched_lat_dequeued(struct task_struct *t, unsigned long long delta)
+{
+	t->se.statistics.lat_delay += delta;
+}
+
+/*
+ * The task leaves the cpu while still runnable: it got preempted or
+ * yielded, rather than went to sleep.
+ */
+static inline void sched_lat_preempted(struct task_struct *t)
+{
+	t->se.statistics.lat_preempted = 1;
+}
 # define schedstat_inc(rq, field)	do { (rq)->field++; } while (0)
 # define schedstat_add(rq, field, amt)	do { (rq)->field += (amt); } while (0)
 # define schedstat_set(var, val)	do { var = (val); } while (0)
@@ -145,6 +231,14 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 static inline void
 rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 {}
+static inline void
+sched_lat_arrive(struct task_struct *t, unsigned long long delta, int queued)
+{}
+static inline void
+sched_lat_dequeued(struct task_struct *t, unsigned long long delta)
+{}
+static inline void sched_lat_preempted(struct task_struct *t)
+{}
 # define schedstat_inc(rq, field)	do { } while (0)
 # define schedstat_add(rq, field, amt)	do { } while (0)
 # define schedstat_set(var, val)	do { } while (0)
@@ -173,6 +267,7 @@ static inline void sched_info_dequeued(struct task_struct *t)
 	t->sched_info.run_delay += delta;
 
 	rq_sched_info_dequeued(task_rq(t), delta);
+	sched_lat_dequeued(t, delta);
 }
 
 /*
@@ -183,8 +278,9 @@ static inline void sched_info_dequeued(struct task_struct *t)
 static void sched_info_arrive(struct task_struct *t)
 {
 	unsigned long long now = task_rq(t)->clock, delta = 0;
+	int queued = t->sched_info.last_queued != 0;
 
-	if (t->sched_info.last_queued)
+	if (queued)
 		delta = now - t->sched_info.last_queued;
 	sched_info_reset_dequeued(t);
 	t->sched_info.run_delay += delta;
@@ -192,6 +288,7 @@ static void sched_info_arrive(struct task_struct *t)
 	t->sched_info.pcount++;
 
 	rq_sched_info_arrive(task_rq(t), delta);
+	sched_lat_arrive(t, delta, queued);
 }
 
 /*
@@ -220,8 +317,10 @@ static inline void sched_info_depart(struct task_struct *t)
 
 	rq_sched_info_depart(task_rq(t), delta);
 
-	if (t->state == TASK_RUNNING)
+	if (t->state == TASK_RUNNING) {
+		sched_lat_preempted(t);
 		sched_info_queued(t);
+	}
 }
 
 /*
@@ -347,6 +347,10 @@ void irq_exit(void)
 	if (!in_interrupt() && local_softirq_pending())
 		invoke_softirq();
 
+	/* Full dynticks: the irq may have changed the need for the tick */
+	if (!in_interrupt())
+		tick_nohz_full_check();
+
 	rcu_irq_exit();
 #ifdef CONFIG_NO_HZ
 	/* Make sure that timer wheel updates are propagated */
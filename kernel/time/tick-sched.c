@@ -20,6 +20,9 @@
 #include <linux/profile.h>
 #include <linux/sched.h>
 #include <linux/module.h>
+#include <linux/perf_event.h>
+#include <linux/posix-timers.h>
+#include <linux/context_tracking.h>
 
 #include <asm/irq_regs.h>
 
@@ -123,6 +126,41 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_FULL
+cpumask_var_t tick_nohz_full_mask;
+bool tick_nohz_full_running;
+
+static void tick_nohz_full_restart(struct tick_sched *ts, ktime_t now);
+
+/*
+ * Parse the boot-time nohz_full cpu list. The CPU we boot on keeps the
+ * timekeeping duty, so it can never be part of it.
+ */
+static int __init tick_nohz_full_setup(char *str)
+{
+	int cpu;
+
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		printk(KERN_WARNING "NOHZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+
+	cpu = smp_processor_id();
+	if (cpumask_test_cpu(cpu, tick_nohz_full_mask)) {
+		printk(KERN_WARNING "NOHZ: Clearing %d from nohz_full range "
+		       "for timekeeping\n", cpu);
+		cpumask_clear_cpu(cpu, tick_nohz_full_mask);
+	}
+
+	if (!cpumask_empty(tick_nohz_full_mask))
+		tick_nohz_full_running = true;
+
+	return 1;
+}
+__setup("nohz_full=", tick_nohz_full_setup);
+#endif
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -276,6 +314,16 @@ void tick_nohz_stop_sched_tick(int inidle)
 	if (!inidle && !ts->inidle)
 		goto end;
 
+#ifdef CONFIG_NO_HZ_FULL
+	/*
+	 * A full dynticks CPU may enter idle with the tick already stopped
+	 * while it was busy. Bring it back first, so that the idle
+	 * bookkeeping below starts from a regular periodic tick.
+	 */
+	if (ts->tick_stopped && !ts->inidle)
+		tick_nohz_full_restart(ts, ktime_get());
+#endif
+
 	/*
 	 * Set ts->inidle unconditionally. Even if the system did not
 	 * switch to NOHZ mode the cpu frequency governers rely on the
@@ -339,6 +387,13 @@ void tick_nohz_stop_sched_tick(int inidle)
 	if (!ts->tick_stopped && delta_jiffies == 1)
 		goto out;
 
+	/*
+	 * Full dynticks CPUs rely on the timekeeping CPU for jiffies and
+	 * may not take the duty over, so it keeps its tick even in idle.
+	 */
+	if (tick_nohz_full_enabled() && cpu == tick_do_timer_cpu)
+		goto out;
+
 	/* Schedule the tick, if we are at least one jiffie off */
 	if ((long)delta_jiffies >= 1) {
 
@@ -552,6 +607,208 @@ void tick_nohz_restart_sched_tick(void)
 	local_irq_enable();
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+static void tick_nohz_full_restart(struct tick_sched *ts, ktime_t now)
+{
+	ts->tick_stopped = 0;
+	tick_nohz_restart(ts, now);
+}
+
+/*
+ * The tick may only be stopped on a busy CPU when nothing depends on it:
+ * no other task to preempt to, no cpu timers or perf events to sample and
+ * a stable sched_clock.
+ */
+static bool can_stop_full_tick(void)
+{
+	WARN_ON_ONCE(!irqs_disabled());
+
+	if (!sched_can_stop_tick())
+		return false;
+
+	if (!posix_cpu_timers_can_stop_tick(current))
+		return false;
+
+	if (!perf_event_can_stop_tick())
+		return false;
+
+#ifdef CONFIG_HAVE_UNSTABLE_SCHED_CLOCK
+	/* sched_clock_tick() needs us */
+	if (!sched_clock_stable)
+		return false;
+#endif
+
+	return true;
+}
+
+static void tick_nohz_full_stop_tick(struct tick_sched *ts, int cpu)
+{
+	struct clock_event_device *dev = __get_cpu_var(tick_cpu_device).evtdev;
+	unsigned long seq, last_jiffies, next_jiffies, delta_jiffies;
+	ktime_t last_update, expires;
+	u64 time_delta;
+
+	/* Read jiffies and the time when jiffies were updated last */
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		last_update = last_jiffies_update;
+		last_jiffies = jiffies;
+	} while (read_seqretry(&xtime_lock, seq));
+
+	if (rcu_needs_cpu(cpu) || printk_needs_cpu(cpu) ||
+	    arch_needs_cpu(cpu) || local_softirq_pending()) {
+		next_jiffies = last_jiffies + 1;
+		delta_jiffies = 1;
+	} else {
+		/* Get the next timer wheel timer */
+		next_jiffies = get_next_timer_interrupt(last_jiffies);
+		delta_jiffies = next_jiffies - last_jiffies;
+	}
+
+	/* Nothing to gain if the next tick is due anyway */
+	if ((long)delta_jiffies <= 1) {
+		if (ts->tick_stopped)
+			tick_nohz_full_restart(ts, ktime_get());
+		return;
+	}
+
+	/*
+	 * Unlike idle, a busy CPU still needs a tick once per second to
+	 * keep the scheduler statistics and the RCU state moving.
+	 */
+	time_delta = NSEC_PER_SEC;
+	if (delta_jiffies < NEXT_TIMER_MAX_DELTA)
+		time_delta = min_t(u64, time_delta,
+				   tick_period.tv64 * delta_jiffies);
+	expires = ktime_add_ns(last_update, time_delta);
+
+	/* Skip reprogram of event if its not changed */
+	if (ts->tick_stopped && ktime_equal(expires, dev->next_event))
+		return;
+
+	if (!ts->tick_stopped) {
+		ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
+		ts->tick_stopped = 1;
+	}
+
+	if (ts->nohz_mode == NOHZ_MODE_HIGHRES) {
+		hrtimer_start(&ts->sched_timer, expires,
+			      HRTIMER_MODE_ABS_PINNED);
+		/* Check, if the timer was already in the past */
+		if (hrtimer_active(&ts->sched_timer))
+			return;
+	} else if (!tick_program_event(expires, 0))
+		return;
+
+	/* We are past the event already, just keep ticking */
+	tick_nohz_full_restart(ts, ktime_get());
+}
+
+/**
+ * tick_nohz_full_check - re-evaluate the tick of a busy full dynticks CPU
+ *
+ * Stop the tick when the current task can run without it, restart it
+ * when something started to depend on it. Called with interrupts disabled
+ * from irq_exit(), after a context switch and from the kick IPI.
+ */
+void tick_nohz_full_check(void)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (!tick_nohz_full_cpu(cpu) || ts->inidle || idle_cpu(cpu))
+		return;
+
+	if (unlikely(ts->nohz_mode == NOHZ_MODE_INACTIVE))
+		return;
+
+	if (can_stop_full_tick())
+		tick_nohz_full_stop_tick(ts, cpu);
+	else if (ts->tick_stopped)
+		tick_nohz_full_restart(ts, ktime_get());
+}
+
+static void nohz_full_kick_ipi(void *info)
+{
+	tick_nohz_full_check();
+}
+
+/*
+ * Kick all full dynticks CPUs in order to force these to re-evaluate
+ * their dependency on the tick and restart it if necessary.
+ */
+void tick_nohz_full_kick_all(void)
+{
+	unsigned long flags;
+
+	if (!tick_nohz_full_running)
+		return;
+
+	preempt_disable();
+	smp_call_function_many(tick_nohz_full_mask,
+			       nohz_full_kick_ipi, NULL, false);
+	local_irq_save(flags);
+	tick_nohz_full_check();
+	local_irq_restore(flags);
+	preempt_enable();
+}
+
+/*
+ * Re-evaluate the need for the tick as we switch the current task.
+ * The new task may have cpu timers or perf events that need it.
+ */
+void tick_nohz_task_switch(void)
+{
+	unsigned long flags;
+
+	if (!tick_nohz_full_cpu(smp_processor_id()))
+		return;
+
+	local_irq_save(flags);
+	tick_nohz_full_check();
+	local_irq_restore(flags);
+}
+
+static int __cpuinit tick_nohz_cpu_down_callback(struct notifier_block *nfb,
+						 unsigned long action,
+						 void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_DOWN_PREPARE:
+		/*
+		 * If we handle the timekeeping duty for full dynticks CPUs,
+		 * we can't safely shutdown that CPU.
+		 */
+		if (tick_do_timer_cpu == cpu)
+			return NOTIFY_BAD;
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static char __initdata nohz_full_buf[NR_CPUS + 1];
+
+static int __init tick_nohz_init(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_running)
+		return 0;
+
+	for_each_cpu(cpu, tick_nohz_full_mask)
+		context_tracking_cpu_set(cpu);
+
+	cpu_notifier(tick_nohz_cpu_down_callback, 0);
+	cpulist_scnprintf(nohz_full_buf, sizeof(nohz_full_buf),
+			  tick_nohz_full_mask);
+	printk(KERN_INFO "NOHZ: Full dynticks CPUs: %s.\n", nohz_full_buf);
+	return 0;
+}
+early_initcall(tick_nohz_init);
+#endif /* CONFIG_NO_HZ_FULL */
+
 static int tick_nohz_reprogram(struct tick_sched *ts, ktime_t now)
 {
 	hrtimer_forward(&ts->sched_timer, now, tick_period);
@@ -575,9 +832,10 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	 * concurrency: This happens only when the cpu in charge went
 	 * into a long sleep. If two cpus happen to assign themself to
 	 * this duty, then the jiffies update is still serialized by
-	 * xtime_lock.
+	 * xtime_lock. Full dynticks CPUs never take it over.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 
 	/* Check, if the jiffies need an update */
@@ -592,7 +850,7 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	 * of idle" jiffy stamp so the idle accounting adjustment we
 	 * do when we go busy again does not account too much ticks.
 	 */
-	if (ts->tick_stopped) {
+	if (ts->tick_stopped && ts->inidle) {
 		touch_softlockup_watchdog();
 		ts->idle_jiffies++;
 	}
@@ -685,7 +943,8 @@ static inline void tick_check_nohz(int cpu)
 	now = ktime_get();
 	if (ts->idle_active)
 		tick_nohz_stop_idle(cpu, now);
-	if (ts->tick_stopped) {
+	/* a busy full dynticks CPU gets its jiffies from the timekeeper */
+	if (ts->tick_stopped && ts->inidle) {
 		tick_nohz_update_jiffies(now);
 		tick_nohz_kick_tick(cpu, now);
 	}
@@ -729,9 +988,10 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	 * concurrency: This happens only when the cpu in charge went
 	 * into a long sleep. If two cpus happen to assign themself to
 	 * this duty, then the jiffies update is still serialized by
-	 * xtime_lock.
+	 * xtime_lock. Full dynticks CPUs never take it over.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
@@ -752,7 +1012,7 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 		 * idle" jiffy stamp so the idle accounting adjustment we do
 		 * when we go busy again does not account too much ticks.
 		 */
-		if (ts->tick_stopped) {
+		if (ts->tick_stopped && ts->inidle) {
 			touch_softlockup_watchdog();
 			ts->idle_jiffies++;
 		}
@@ -17,8 +17,8 @@
  * This is the generic async execution mechanism.  Work items as are
  * executed in process context.  The worker pool is shared and
  * automatically managed.  There is one worker pool for each CPU and
- * one extra for works which are better served by workers which are
- * not bound to any specific CPU.
+ * a set of pools, keyed by their attributes, for works which are
+ * better served by workers which are not bound to any specific CPU.
  *
  * Please read Documentation/workqueue.txt for details.
  */
@@ -41,6 +41,10 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/delay.h>
+#include <linux/device.h>
+#include <linux/moduleparam.h>
+#include <linux/nodemask.h>
 
 #include "workqueue_sched.h"
 
@@ -91,6 +95,17 @@ enum {
 	 * all cpus.  Give -20.
 	 */
 	RESCUER_NICE_LEVEL	= -20,
+
+	/*
+	 * Unbound gcwqs (worker pools) are identified by ids above the
+	 * special cpu numbers.  They're created on demand for each
+	 * distinct set of workqueue_attrs and never destroyed.
+	 */
+	WQ_UNBOUND_POOL_FIRST	= WORK_CPU_LAST + 1,
+	WQ_MAX_UNBOUND_POOLS	= 256,
+
+	/* how long apply_workqueue_attrs() waits for active works */
+	WQ_REBIND_TIMEOUT	= 10 * HZ,
 };
 
 /*
@@ -112,9 +127,12 @@ enum {
  * F: wq->flush_mutex protected.
  *
  * W: workqueue_lock protected.
+ *
+ * M: wq_pool_mutex protected.
  */
 
 struct global_cwq;
+struct wq_device;
 
 /*
  * The poor guys doing the actual heavy lifting.  All on-duty workers
@@ -142,13 +160,17 @@ struct worker {
 /*
  * Global per-cpu workqueue.  There's one and only one for each cpu
  * and all works are queued and processed here regardless of their
- * target workqueues.
+ * target workqueues.  Unbound workqueues are served by gcwqs which
+ * aren't associated with any cpu; those are keyed by @attrs and their
+ * @cpu is an id at or above WQ_UNBOUND_POOL_FIRST.
  */
 struct global_cwq {
 	spinlock_t		lock;		/* the gcwq lock */
 	struct list_head	worklist;	/* L: list of pending works */
 	unsigned int		cpu;		/* I: the associated cpu */
 	unsigned int		flags;		/* L: GCWQ_* flags */
+	int			node;		/* I: preferred NUMA node */
+	struct workqueue_attrs	*attrs;		/* I: unbound pool attributes */
 
 	int			nr_workers;	/* L: total number of workers */
 	int			nr_idle;	/* L: currently idle ones */
@@ -186,6 +208,14 @@ struct cpu_workqueue_struct {
 	struct list_head	delayed_works;	/* L: delayed works */
 };
 
+/*
+ * Unbound workqueues carry an array of cwqs, one for each NUMA node,
+ * instead of percpu ones.  Each is aligned the same way.
+ */
+#define CWQ_ALIGN	max_t(size_t, 1 << WORK_STRUCT_FLAG_BITS,	\
+			      __alignof__(unsigned long long))
+#define CWQ_STRIDE	ALIGN(sizeof(struct cpu_workqueue_struct), CWQ_ALIGN)
+
 /*
  * Structure used to wait for workqueue flush.
  */
@@ -242,6 +272,8 @@ struct workqueue_struct {
 
 	int			nr_drainers;	/* W: drain in progress */
 	int			saved_max_active; /* W: saved cwq max_active */
+	struct workqueue_attrs	*unbound_attrs;	/* M: only for unbound wqs */
+	struct wq_device	*wq_dev;	/* I: for sysfs interface */
 	const char		*name;		/* I: workqueue name */
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map	lockdep_map;
@@ -266,6 +298,33 @@ EXPORT_SYMBOL_GPL(system_freezable_wq);
 	for (i = 0; i < BUSY_WORKER_HASH_SIZE; i++)			\
 		hlist_for_each_entry(worker, pos, &gcwq->busy_hash[i], hentry)
 
+/*
+ * Unbound gcwqs.  They're looked up and created under wq_pool_mutex
+ * and published to lockless readers by bumping nr_unbound_gcwqs after
+ * the pointer is visible.  As gcwqs are never destroyed, a published
+ * pointer stays valid forever.
+ */
+static DEFINE_MUTEX(wq_pool_mutex);
+static struct global_cwq *unbound_gcwqs[WQ_MAX_UNBOUND_POOLS];
+static int nr_unbound_gcwqs;
+
+/*
+ * Unbound workqueues have a cwq for each NUMA node which feeds a gcwq
+ * whose workers are restricted to the CPUs of that node.  This can be
+ * turned off with workqueue.disable_numa.
+ */
+static bool wq_disable_numa;
+module_param_named(disable_numa, wq_disable_numa, bool, 0444);
+
+static bool wq_numa_enabled;		/* I: per-node unbound cwqs */
+static cpumask_var_t *wq_numa_possible_cpumask; /* I: possible CPUs of each node */
+static cpumask_var_t wq_numa_cwq_cpus;	/* I: first possible CPU of each node */
+
+static bool wq_single_unbound_cwq(struct workqueue_struct *wq)
+{
+	return !wq_numa_enabled || (wq->flags & WQ_ORDERED);
+}
+
 static inline int __next_gcwq_cpu(int cpu, const struct cpumask *mask,
 				  unsigned int sw)
 {
@@ -275,44 +334,51 @@ static inline int __next_gcwq_cpu(int cpu, const struct cpumask *mask,
 			if (cpu < nr_cpu_ids)
 				return cpu;
 		}
-		if (sw & 2)
-			return WORK_CPU_UNBOUND;
+		cpu = WQ_UNBOUND_POOL_FIRST - 1;
 	}
+	if ((sw & 2) &&
+	    cpu + 1 < WQ_UNBOUND_POOL_FIRST + ACCESS_ONCE(nr_unbound_gcwqs))
+		return cpu + 1;
 	return WORK_CPU_NONE;
 }
 
 static inline int __next_wq_cpu(int cpu, const struct cpumask *mask,
 				struct workqueue_struct *wq)
 {
-	return __next_gcwq_cpu(cpu, mask, !(wq->flags & WQ_UNBOUND) ? 1 : 2);
+	if (wq->flags & WQ_UNBOUND)
+		mask = wq_single_unbound_cwq(wq) ? cpumask_of(0) :
+						   wq_numa_cwq_cpus;
+	return __next_gcwq_cpu(cpu, mask, 1);
 }
 
 /*
  * CPU iterators
  *
- * An extra gcwq is defined for an invalid cpu number
- * (WORK_CPU_UNBOUND) to host workqueues which are not bound to any
+ * Unbound gcwqs are identified by numbers at or above
+ * WQ_UNBOUND_POOL_FIRST to host workqueues which are not bound to any
  * specific CPU.  The following iterators are similar to
- * for_each_*_cpu() iterators but also considers the unbound gcwq.
+ * for_each_*_cpu() iterators but also consider the unbound gcwqs.
  *
- * for_each_gcwq_cpu()		: possible CPUs + WORK_CPU_UNBOUND
- * for_each_online_gcwq_cpu()	: online CPUs + WORK_CPU_UNBOUND
+ * for_each_gcwq_cpu()		: possible CPUs + unbound gcwqs
+ * for_each_online_gcwq_cpu()	: online CPUs + unbound gcwqs
  * for_each_cwq_cpu()		: possible CPUs for bound workqueues,
- *				  WORK_CPU_UNBOUND for unbound workqueues
+ *				  a CPU of each NUMA node for unbound
+ *				  workqueues, so that get_cwq() on it
+ *				  visits every cwq once
  */
 #define for_each_gcwq_cpu(cpu)						\
 	for ((cpu) = __next_gcwq_cpu(-1, cpu_possible_mask, 3);		\
-	     (cpu) < WORK_CPU_NONE;					\
+	     (cpu) != WORK_CPU_NONE;					\
 	     (cpu) = __next_gcwq_cpu((cpu), cpu_possible_mask, 3))
 
 #define for_each_online_gcwq_cpu(cpu)					\
 	for ((cpu) = __next_gcwq_cpu(-1, cpu_online_mask, 3);		\
-	     (cpu) < WORK_CPU_NONE;					\
+	     (cpu) != WORK_CPU_NONE;					\
 	     (cpu) = __next_gcwq_cpu((cpu), cpu_online_mask, 3))
 
 #define for_each_cwq_cpu(cpu, wq)					\
 	for ((cpu) = __next_wq_cpu(-1, cpu_possible_mask, (wq));	\
-	     (cpu) < WORK_CPU_NONE;					\
+	     (cpu) != WORK_CPU_NONE;					\
 	     (cpu) = __next_wq_cpu((cpu), cpu_possible_mask, (wq)))
 
 #ifdef CONFIG_DEBUG_OBJECTS_WORK
@@ -445,31 +511,41 @@ static DEFINE_PER_CPU(struct global_cwq, global_cwq);
 static DEFINE_PER_CPU_SHARED_ALIGNED(atomic_t, gcwq_nr_running);
 
 /*
- * Global cpu workqueue and nr_running counter for unbound gcwq.  The
- * gcwq is always online, has GCWQ_DISASSOCIATED set, and all its
- * workers have WORKER_UNBOUND set.
+ * nr_running counter shared by all unbound gcwqs.  Unbound gcwqs are
+ * always online, have GCWQ_DISASSOCIATED set, and all their workers
+ * have WORKER_UNBOUND set.
  */
-static struct global_cwq unbound_global_cwq;
 static atomic_t unbound_gcwq_nr_running = ATOMIC_INIT(0);	/* always 0 */
 
 static int worker_thread(void *__worker);
 
 static struct global_cwq *get_gcwq(unsigned int cpu)
 {
-	if (cpu != WORK_CPU_UNBOUND)
+	if (cpu < WQ_UNBOUND_POOL_FIRST)
 		return &per_cpu(global_cwq, cpu);
-	else
-		return &unbound_global_cwq;
+
+	/* pairs with smp_wmb() in get_unbound_gcwq() */
+	smp_rmb();
+	return unbound_gcwqs[cpu - WQ_UNBOUND_POOL_FIRST];
 }
 
 static atomic_t *get_gcwq_nr_running(unsigned int cpu)
 {
-	if (cpu != WORK_CPU_UNBOUND)
+	if (cpu < WQ_UNBOUND_POOL_FIRST)
 		return &per_cpu(gcwq_nr_running, cpu);
 	else
 		return &unbound_gcwq_nr_running;
 }
 
+static bool gcwq_is_unbound(struct global_cwq *gcwq)
+{
+	return gcwq->cpu >= WQ_UNBOUND_POOL_FIRST;
+}
+
+/*
+ * For unbound workqueues, @cpu selects the cwq of its NUMA node and
+ * WORK_CPU_UNBOUND the one of the local node.
+ */
 static struct cpu_workqueue_struct *get_cwq(unsigned int cpu,
 					    struct workqueue_struct *wq)
 {
@@ -481,8 +557,16 @@ static struct cpu_workqueue_struct *get_cwq(unsigned int cpu,
 			return wq->cpu_wq.single;
 #endif
 		}
-	} else if (likely(cpu == WORK_CPU_UNBOUND))
-		return wq->cpu_wq.single;
+	} else {
+		if (cpu == WORK_CPU_UNBOUND)
+			cpu = raw_smp_processor_id();
+		if (likely(cpu < nr_cpu_ids)) {
+			if (wq_single_unbound_cwq(wq))
+				return wq->cpu_wq.single;
+			return (void *)wq->cpu_wq.single +
+				cpu_to_node(cpu) * CWQ_STRIDE;
+		}
+	}
 	return NULL;
 }
 
@@ -564,7 +648,7 @@ static struct global_cwq *get_work_gcwq(struct work_struct *work)
 	if (cpu == WORK_CPU_NONE)
 		return NULL;
 
-	BUG_ON(cpu >= nr_cpu_ids && cpu != WORK_CPU_UNBOUND);
+	BUG_ON(cpu >= nr_cpu_ids && cpu < WQ_UNBOUND_POOL_FIRST);
 	return get_gcwq(cpu);
 }
 
@@ -982,7 +1066,7 @@ static bool is_chained_work(struct workqueue_struct *wq)
 static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 			 struct work_struct *work)
 {
-	struct global_cwq *gcwq;
+	struct global_cwq *gcwq, *last_gcwq;
 	struct cpu_workqueue_struct *cwq;
 	struct list_head *worklist;
 	unsigned int work_flags;
@@ -994,45 +1078,56 @@ static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 	if (unlikely(wq->flags & WQ_DRAINING) &&
 	    WARN_ON_ONCE(!is_chained_work(wq)))
 		return;
-
-	/* determine gcwq to use */
+retry:
+	/*
+	 * Determine cwq to use.  Unbound workqueues use the cwq of the
+	 * node @cpu is on, the local one for WORK_CPU_UNBOUND.
+	 */
 	if (!(wq->flags & WQ_UNBOUND)) {
-		struct global_cwq *last_gcwq;
-
 		if (unlikely(cpu == WORK_CPU_UNBOUND))
 			cpu = raw_smp_processor_id();
-
-		/*
-		 * It's multi cpu.  If @wq is non-reentrant and @work
-		 * was previously on a different cpu, it might still
-		 * be running there, in which case the work needs to
-		 * be queued on that cpu to guarantee non-reentrance.
-		 */
 		gcwq = get_gcwq(cpu);
-		if (wq->flags & WQ_NON_REENTRANT &&
-		    (last_gcwq = get_work_gcwq(work)) && last_gcwq != gcwq) {
-			struct worker *worker;
+	}
+	cwq = get_cwq(cpu, wq);
+	if (wq->flags & WQ_UNBOUND)
+		gcwq = ACCESS_ONCE(cwq->gcwq);
 
-			spin_lock_irqsave(&last_gcwq->lock, flags);
+	/*
+	 * If @wq is non-reentrant and @work was previously on a
+	 * different gcwq, it might still be running there, in which
+	 * case the work needs to be queued on that gcwq to guarantee
+	 * non-reentrance.  Unbound workqueues used to be served by a
+	 * single gcwq and thus are always non-reentrant.
+	 */
+	if (wq->flags & (WQ_NON_REENTRANT | WQ_UNBOUND) &&
+	    (last_gcwq = get_work_gcwq(work)) && last_gcwq != gcwq) {
+		struct worker *worker;
 
-			worker = find_worker_executing_work(last_gcwq, work);
+		spin_lock_irqsave(&last_gcwq->lock, flags);
 
-			if (worker && worker->current_cwq->wq == wq)
-				gcwq = last_gcwq;
-			else {
-				/* meh... not running there, queue here */
-				spin_unlock_irqrestore(&last_gcwq->lock, flags);
-				spin_lock_irqsave(&gcwq->lock, flags);
-			}
-		} else
+		worker = find_worker_executing_work(last_gcwq, work);
+
+		if (worker && worker->current_cwq->wq == wq) {
+			gcwq = last_gcwq;
+			cwq = worker->current_cwq;
+		} else {
+			/* meh... not running there, queue here */
+			spin_unlock_irqrestore(&last_gcwq->lock, flags);
 			spin_lock_irqsave(&gcwq->lock, flags);
-	} else {
-		gcwq = get_gcwq(WORK_CPU_UNBOUND);
+		}
+	} else
 		spin_lock_irqsave(&gcwq->lock, flags);
+
+	/*
+	 * apply_workqueue_attrs() may have switched the cwq of an
+	 * unbound workqueue to a different gcwq under us.
+	 */
+	if (unlikely(cwq->gcwq != gcwq)) {
+		spin_unlock_irqrestore(&gcwq->lock, flags);
+		goto retry;
 	}
 
-	/* gcwq determined, get cwq and queue */
-	cwq = get_cwq(gcwq->cpu, wq);
+	/* gcwq determined, queue */
 	trace_workqueue_queue_work(cpu, cwq, work);
 
 	BUG_ON(!list_empty(&work->entry));
@@ -1107,6 +1202,23 @@ static void delayed_work_timer_fn(unsigned long __data)
 	__queue_work(smp_processor_id(), cwq->wq, &dwork->work);
 }
 
+/*
+ * Find a cpu whose cwq of unbound @wq feeds the gcwq @work was last
+ * on so that the gcwq is preserved while the work is delayed.
+ */
+static unsigned int unbound_work_last_cpu(struct workqueue_struct *wq,
+					  struct work_struct *work)
+{
+	struct global_cwq *gcwq = get_work_gcwq(work);
+	unsigned int cpu;
+
+	if (gcwq)
+		for_each_cwq_cpu(cpu, wq)
+			if (get_cwq(cpu, wq)->gcwq == gcwq)
+				return cpu;
+	return WORK_CPU_UNBOUND;
+}
+
 /**
  * queue_delayed_work - queue work on a workqueue after delay
  * @wq: workqueue to use
@@ -1157,12 +1269,12 @@ int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 		if (!(wq->flags & WQ_UNBOUND)) {
 			struct global_cwq *gcwq = get_work_gcwq(work);
 
-			if (gcwq && gcwq->cpu != WORK_CPU_UNBOUND)
+			if (gcwq && !gcwq_is_unbound(gcwq))
 				lcpu = gcwq->cpu;
 			else
 				lcpu = raw_smp_processor_id();
 		} else
-			lcpu = WORK_CPU_UNBOUND;
+			lcpu = unbound_work_last_cpu(wq, work);
 
 		set_work_cwq(work, get_cwq(lcpu, wq), 0);
 
@@ -1273,6 +1385,13 @@ __acquires(&gcwq->lock)
 	struct global_cwq *gcwq = worker->gcwq;
 	struct task_struct *task = worker->task;
 
+	/* unbound gcwqs have no cpu, follow the pool's cpumask instead */
+	if (gcwq_is_unbound(gcwq)) {
+		set_cpus_allowed_ptr(task, gcwq->attrs->cpumask);
+		spin_lock_irq(&gcwq->lock);
+		return false;
+	}
+
 	while (true) {
 		/*
 		 * The following call may fail, succeed or succeed
@@ -1352,7 +1471,7 @@ static struct worker *alloc_worker(void)
  */
 static struct worker *create_worker(struct global_cwq *gcwq, bool bind)
 {
-	bool on_unbound_cpu = gcwq->cpu == WORK_CPU_UNBOUND;
+	bool on_unbound_cpu = gcwq_is_unbound(gcwq);
 	struct worker *worker = NULL;
 	int id = -1;
 
@@ -1378,11 +1497,24 @@ static struct worker *create_worker(struct global_cwq *gcwq, bool bind)
 						      cpu_to_node(gcwq->cpu),
 						      "kworker/%u:%d", gcwq->cpu, id);
 	else
-		worker->task = kthread_create(worker_thread, worker,
-					      "kworker/u:%d", id);
+		worker->task = kthread_create_on_node(worker_thread,
+						      worker, gcwq->node,
+						      "kworker/u%u:%d",
+						      gcwq->cpu - WQ_UNBOUND_POOL_FIRST,
+						      id);
 	if (IS_ERR(worker->task))
 		goto fail;
 
+	/*
+	 * Unbound workers take the pool's attributes.  This has to
+	 * happen before PF_THREAD_BOUND is set below, which makes
+	 * set_cpus_allowed_ptr() refuse anyone but the task itself.
+	 */
+	if (on_unbound_cpu) {
+		set_user_nice(worker->task, gcwq->attrs->nice);
+		set_cpus_allowed_ptr(worker->task, gcwq->attrs->cpumask);
+	}
+
 	/*
 	 * A rogue worker will become a regular one if CPU comes
 	 * online later on.  Make sure every worker has
@@ -1496,8 +1628,11 @@ static bool send_mayday(struct work_struct *work)
 
 	/* mayday mayday mayday */
 	cpu = cwq->gcwq->cpu;
-	/* WORK_CPU_UNBOUND can't be set in cpumask, use cpu 0 instead */
-	if (cpu == WORK_CPU_UNBOUND)
+	/*
+	 * Unbound gcwq ids can't be set in cpumask, use cpu 0 instead.
+	 * The rescuer of an unbound workqueue visits all its cwqs.
+	 */
+	if (gcwq_is_unbound(cwq->gcwq))
 		cpu = 0;
 	if (!mayday_test_and_set_cpu(cpu, wq->mayday_mask))
 		wake_up_process(wq->rescuer->task);
@@ -1799,7 +1934,12 @@ __releases(&gcwq->lock)
 __acquires(&gcwq->lock)
 {
 	struct cpu_workqueue_struct *cwq = get_work_cwq(work);
-	struct global_cwq *gcwq = cwq->gcwq;
+	/*
+	 * Use the worker's gcwq rather than @cwq's.  An uncolored
+	 * barrier may linger on the old gcwq after the cwq of an
+	 * unbound workqueue has been switched to a new one.
+	 */
+	struct global_cwq *gcwq = worker->gcwq;
 	struct hlist_head *bwh = busy_worker_head(gcwq, work);
 	bool cpu_intensive = cwq->wq->flags & WQ_CPU_INTENSIVE;
 	work_func_t f = work->func;
@@ -1937,6 +2077,15 @@ static int worker_thread(void *__worker)
 	/* tell the scheduler that this is a workqueue worker */
 	worker->task->flags |= PF_WQ_WORKER;
 woke_up:
+	/*
+	 * Unbound workers may have been created before all CPUs of
+	 * their pool came online.  Catch up with the pool's cpumask.
+	 */
+	if (gcwq_is_unbound(gcwq) &&
+	    unlikely(!cpumask_equal(&current->cpus_allowed,
+				    gcwq->attrs->cpumask)))
+		set_cpus_allowed_ptr(current, gcwq->attrs->cpumask);
+
 	spin_lock_irq(&gcwq->lock);
 
 	/* DIE can be set only while we're idle, checking here is enough */
@@ -2005,6 +2154,40 @@ sleep:
 	goto woke_up;
 }
 
+/* process the works of @cwq stuck on its gcwq, called by rescuer_thread() */
+static void rescue_cwq(struct worker *rescuer,
+		       struct cpu_workqueue_struct *cwq)
+{
+	struct list_head *scheduled = &rescuer->scheduled;
+	struct global_cwq *gcwq = cwq->gcwq;
+	struct work_struct *work, *n;
+
+	/* migrate to the target cpu if possible */
+	rescuer->gcwq = gcwq;
+	worker_maybe_bind_and_lock(rescuer);
+
+	/*
+	 * Slurp in all works issued via this workqueue and
+	 * process'em.
+	 */
+	BUG_ON(!list_empty(&rescuer->scheduled));
+	list_for_each_entry_safe(work, n, &gcwq->worklist, entry)
+		if (get_work_cwq(work) == cwq)
+			move_linked_works(work, scheduled, &n);
+
+	process_scheduled_works(rescuer);
+
+	/*
+	 * Leave this gcwq.  If keep_working() is %true, notify a
+	 * regular worker; otherwise, we end up with 0 concurrency
+	 * and stalling the execution.
+	 */
+	if (keep_working(gcwq))
+		wake_up_worker(gcwq);
+
+	spin_unlock_irq(&gcwq->lock);
+}
+
 /**
  * rescuer_thread - the rescuer thread function
  * @__wq: the associated workqueue
@@ -2028,9 +2211,8 @@ static int rescuer_thread(void *__wq)
 {
 	struct workqueue_struct *wq = __wq;
 	struct worker *rescuer = wq->rescuer;
-	struct list_head *scheduled = &rescuer->scheduled;
 	bool is_unbound = wq->flags & WQ_UNBOUND;
-	unsigned int cpu;
+	unsigned int cpu, tcpu;
 
 	set_user_nice(current, RESCUER_NICE_LEVEL);
 repeat:
@@ -2041,41 +2223,17 @@ repeat:
 
 	/*
 	 * See whether any cpu is asking for help.  Unbounded
-	 * workqueues use cpu 0 in mayday_mask for CPU_UNBOUND.
+	 * workqueues use cpu 0 in mayday_mask for all their cwqs.
 	 */
 	for_each_mayday_cpu(cpu, wq->mayday_mask) {
-		unsigned int tcpu = is_unbound ? WORK_CPU_UNBOUND : cpu;
-		struct cpu_workqueue_struct *cwq = get_cwq(tcpu, wq);
-		struct global_cwq *gcwq = cwq->gcwq;
-		struct work_struct *work, *n;
-
 		__set_current_state(TASK_RUNNING);
 		mayday_clear_cpu(cpu, wq->mayday_mask);
 
-		/* migrate to the target cpu if possible */
-		rescuer->gcwq = gcwq;
-		worker_maybe_bind_and_lock(rescuer);
-
-		/*
-		 * Slurp in all works issued via this workqueue and
-		 * process'em.
-		 */
-		BUG_ON(!list_empty(&rescuer->scheduled));
-		list_for_each_entry_safe(work, n, &gcwq->worklist, entry)
-			if (get_work_cwq(work) == cwq)
-				move_linked_works(work, scheduled, &n);
-
-		process_scheduled_works(rescuer);
-
-		/*
-		 * Leave this gcwq.  If keep_working() is %true, notify a
-		 * regular worker; otherwise, we end up with 0 concurrency
-		 * and stalling the execution.
-		 */
-		if (keep_working(gcwq))
-			wake_up_worker(gcwq);
-
-		spin_unlock_irq(&gcwq->lock);
+		if (!is_unbound)
+			rescue_cwq(rescuer, get_cwq(cpu, wq));
+		else
+			for_each_cwq_cpu(tcpu, wq)
+				rescue_cwq(rescuer, get_cwq(tcpu, wq));
 	}
 
 	schedule();
@@ -2882,6 +3040,399 @@ int keventd_up(void)
 	return system_wq != NULL;
 }
 
+/**
+ * free_workqueue_attrs - free a workqueue_attrs
+ * @attrs: workqueue_attrs to free
+ *
+ * Undo alloc_workqueue_attrs().
+ */
+void free_workqueue_attrs(struct workqueue_attrs *attrs)
+{
+	if (attrs) {
+		free_cpumask_var(attrs->cpumask);
+		kfree(attrs);
+	}
+}
+EXPORT_SYMBOL_GPL(free_workqueue_attrs);
+
+/**
+ * alloc_workqueue_attrs - allocate a workqueue_attrs
+ * @gfp_mask: allocation mask to use
+ *
+ * Allocate a new workqueue_attrs and initialize it with the default
+ * settings - nice level 0, all possible CPUs allowed.
+ *
+ * RETURNS:
+ * The new workqueue_attrs on success, NULL on failure.
+ */
+struct workqueue_attrs *alloc_workqueue_attrs(gfp_t gfp_mask)
+{
+	struct workqueue_attrs *attrs;
+
+	attrs = kzalloc(sizeof(*attrs), gfp_mask);
+	if (!attrs)
+		goto fail;
+	if (!alloc_cpumask_var(&attrs->cpumask, gfp_mask))
+		goto fail;
+
+	cpumask_copy(attrs->cpumask, cpu_possible_mask);
+	return attrs;
+fail:
+	free_workqueue_attrs(attrs);
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(alloc_workqueue_attrs);
+
+static void copy_workqueue_attrs(struct workqueue_attrs *to,
+				 const struct workqueue_attrs *from)
+{
+	to->nice = from->nice;
+	cpumask_copy(to->cpumask, from->cpumask);
+}
+
+static bool wqattrs_equal(const struct workqueue_attrs *a,
+			  const struct workqueue_attrs *b)
+{
+	return a->nice == b->nice && cpumask_equal(a->cpumask, b->cpumask);
+}
+
+static void init_gcwq(struct global_cwq *gcwq, unsigned int cpu)
+{
+	int i;
+
+	spin_lock_init(&gcwq->lock);
+	INIT_LIST_HEAD(&gcwq->worklist);
+	gcwq->cpu = cpu;
+	gcwq->flags |= GCWQ_DISASSOCIATED;
+	gcwq->node = NUMA_NO_NODE;
+
+	INIT_LIST_HEAD(&gcwq->idle_list);
+	for (i = 0; i < BUSY_WORKER_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&gcwq->busy_hash[i]);
+
+	init_timer_deferrable(&gcwq->idle_timer);
+	gcwq->idle_timer.function = idle_worker_timeout;
+	gcwq->idle_timer.data = (unsigned long)gcwq;
+
+	setup_timer(&gcwq->mayday_timer, gcwq_mayday_timeout,
+		    (unsigned long)gcwq);
+
+	ida_init(&gcwq->worker_ida);
+
+	gcwq->trustee_state = TRUSTEE_DONE;
+	init_waitqueue_head(&gcwq->trustee_wait);
+}
+
+/**
+ * get_unbound_gcwq - get the unbound gcwq serving @attrs
+ * @attrs: workqueue_attrs of interest
+ *
+ * Look up the unbound gcwq whose attributes match @attrs and create
+ * one along with its first worker if there's none yet.  Unbound gcwqs
+ * are never destroyed.
+ *
+ * CONTEXT:
+ * Might sleep.  Called with wq_pool_mutex held.
+ *
+ * RETURNS:
+ * The matching gcwq on success, NULL on failure.
+ */
+static struct global_cwq *get_unbound_gcwq(const struct workqueue_attrs *attrs)
+{
+	int i, node, id = nr_unbound_gcwqs;
+	struct global_cwq *gcwq;
+	struct worker *worker;
+
+	lockdep_assert_held(&wq_pool_mutex);
+
+	for (i = 0; i < id; i++)
+		if (wqattrs_equal(unbound_gcwqs[i]->attrs, attrs))
+			return unbound_gcwqs[i];
+
+	if (id >= WQ_MAX_UNBOUND_POOLS) {
+		pr_warning("workqueue: out of unbound worker pools\n");
+		return NULL;
+	}
+
+	gcwq = kzalloc(sizeof(*gcwq), GFP_KERNEL);
+	if (!gcwq)
+		return NULL;
+
+	init_gcwq(gcwq, WQ_UNBOUND_POOL_FIRST + id);
+
+	gcwq->attrs = alloc_workqueue_attrs(GFP_KERNEL);
+	if (!gcwq->attrs)
+		goto fail;
+	copy_workqueue_attrs(gcwq->attrs, attrs);
+
+	/* allocate workers on the node @attrs is confined to, if any */
+	if (wq_numa_enabled) {
+		for_each_node(node) {
+			if (cpumask_subset(attrs->cpumask,
+					   wq_numa_possible_cpumask[node])) {
+				gcwq->node = node;
+				break;
+			}
+		}
+	}
+
+	worker = create_worker(gcwq, false);
+	if (!worker)
+		goto fail;
+
+	/*
+	 * Publish under workqueue_lock so that the gcwq can't miss
+	 * freezing state transitions.
+	 */
+	spin_lock(&workqueue_lock);
+
+	spin_lock_irq(&gcwq->lock);
+	if (workqueue_freezing)
+		gcwq->flags |= GCWQ_FREEZING;
+	start_worker(worker);
+	spin_unlock_irq(&gcwq->lock);
+
+	unbound_gcwqs[id] = gcwq;
+	/* pairs with smp_rmb() in get_gcwq() */
+	smp_wmb();
+	nr_unbound_gcwqs = id + 1;
+
+	spin_unlock(&workqueue_lock);
+
+	return gcwq;
+fail:
+	free_workqueue_attrs(gcwq->attrs);
+	ida_destroy(&gcwq->worker_ida);
+	kfree(gcwq);
+	return NULL;
+}
+
+/*
+ * Look up the unbound gcwqs the cwqs of @wq map to for @attrs and
+ * store them in @gcwqs, which is indexed by NUMA node.  The gcwq for a
+ * node serves @attrs restricted to the node's CPUs, or all of @attrs
+ * if the two don't intersect.  Must be called with wq_pool_mutex held.
+ */
+static int wq_get_unbound_gcwqs(struct workqueue_struct *wq,
+				const struct workqueue_attrs *attrs,
+				struct global_cwq **gcwqs)
+{
+	struct workqueue_attrs *tmp_attrs;
+	unsigned int cpu;
+	int ret = 0;
+
+	tmp_attrs = alloc_workqueue_attrs(GFP_KERNEL);
+	if (!tmp_attrs)
+		return -ENOMEM;
+
+	for_each_cwq_cpu(cpu, wq) {
+		int node = cpu_to_node(cpu);
+
+		copy_workqueue_attrs(tmp_attrs, attrs);
+		if (!wq_single_unbound_cwq(wq)) {
+			cpumask_and(tmp_attrs->cpumask, attrs->cpumask,
+				    wq_numa_possible_cpumask[node]);
+			if (cpumask_empty(tmp_attrs->cpumask))
+				cpumask_copy(tmp_attrs->cpumask, attrs->cpumask);
+		}
+
+		gcwqs[node] = get_unbound_gcwq(tmp_attrs);
+		if (!gcwqs[node]) {
+			ret = -ENOMEM;
+			break;
+		}
+	}
+
+	free_workqueue_attrs(tmp_attrs);
+	return ret;
+}
+
+/*
+ * Set max_active of @cwq from its workqueue's saved_max_active, or to
+ * zero if the workqueue is freezable and freezing is in progress, and
+ * activate as many delayed works as allowed.
+ *
+ * CONTEXT:
+ * spin_lock(workqueue_lock) and spin_lock_irq(cwq->gcwq->lock).
+ */
+static void cwq_adjust_max_active(struct cpu_workqueue_struct *cwq)
+{
+	struct workqueue_struct *wq = cwq->wq;
+	bool activated = false;
+
+	if (wq->flags & WQ_FREEZABLE && workqueue_freezing) {
+		cwq->max_active = 0;
+		return;
+	}
+
+	cwq->max_active = wq->saved_max_active;
+
+	while (!list_empty(&cwq->delayed_works) &&
+	       cwq->nr_active < cwq->max_active) {
+		cwq_activate_first_delayed(cwq);
+		activated = true;
+	}
+
+	if (activated)
+		wake_up_worker(cwq->gcwq);
+}
+
+/* does @wq have any active works?  Peeks without locking. */
+static bool wq_has_active_works(struct workqueue_struct *wq)
+{
+	unsigned int cpu;
+
+	for_each_cwq_cpu(cpu, wq)
+		if (ACCESS_ONCE(get_cwq(cpu, wq)->nr_active))
+			return true;
+	return false;
+}
+
+/**
+ * apply_workqueue_attrs - apply new workqueue_attrs to an unbound workqueue
+ * @wq: the target workqueue
+ * @attrs: the workqueue_attrs to apply, allocated with alloc_workqueue_attrs()
+ *
+ * Apply @attrs to the unbound workqueue @wq.  The cwq of each NUMA
+ * node is switched to the gcwq serving @attrs restricted to the CPUs
+ * of the node, or to the one serving @attrs as a whole if the node
+ * has no CPU in @attrs.  gcwqs are shared among workqueues with the
+ * same attributes and created as necessary.
+ *
+ * A cwq can only be switched while it has no active works.  @wq is
+ * quiesced by dropping max_active to zero, which holds new works back
+ * on the delayed lists, and waiting for the active ones to finish.
+ * This shouldn't be called from a work item executing on @wq.
+ *
+ * CONTEXT:
+ * Might sleep.
+ *
+ * RETURNS:
+ * 0 on success, -EBUSY if @wq didn't quiesce in time, -EINVAL or
+ * -ENOMEM on other failures.
+ */
+int apply_workqueue_attrs(struct workqueue_struct *wq,
+			  const struct workqueue_attrs *attrs)
+{
+	struct workqueue_attrs *new_attrs;
+	struct global_cwq **gcwqs;
+	unsigned long timeout;
+	unsigned int cpu;
+	int ret = -ENOMEM;
+
+	if (WARN_ON(!(wq->flags & WQ_UNBOUND)))
+		return -EINVAL;
+
+	new_attrs = alloc_workqueue_attrs(GFP_KERNEL);
+	gcwqs = kcalloc(nr_node_ids, sizeof(gcwqs[0]), GFP_KERNEL);
+	if (!new_attrs || !gcwqs)
+		goto out_free;
+
+	/* only possible CPUs matter */
+	copy_workqueue_attrs(new_attrs, attrs);
+	cpumask_and(new_attrs->cpumask, new_attrs->cpumask, cpu_possible_mask);
+	ret = -EINVAL;
+	if (cpumask_empty(new_attrs->cpumask))
+		goto out_free;
+
+	mutex_lock(&wq_pool_mutex);
+
+	ret = wq_get_unbound_gcwqs(wq, new_attrs, gcwqs);
+	if (ret)
+		goto out_unlock;
+
+	/* hold back new works and wait for the active ones to finish */
+	spin_lock(&workqueue_lock);
+	wq->flags |= WQ_REBINDING;
+	for_each_cwq_cpu(cpu, wq) {
+		struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
+
+		spin_lock_irq(&cwq->gcwq->lock);
+		cwq->max_active = 0;
+		spin_unlock_irq(&cwq->gcwq->lock);
+	}
+	spin_unlock(&workqueue_lock);
+
+	timeout = jiffies + WQ_REBIND_TIMEOUT;
+	while (wq_has_active_works(wq)) {
+		if (time_after(jiffies, timeout)) {
+			pr_warning("workqueue %s: active works didn't finish, attrs not applied\n",
+				   wq->name);
+			ret = -EBUSY;
+			break;
+		}
+		msleep(10);
+	}
+
+	/*
+	 * Switch the cwqs and let them go again.  Flushers look at the
+	 * cwqs under flush_mutex, keep them out while switching.
+	 */
+	mutex_lock(&wq->flush_mutex);
+	spin_lock(&workqueue_lock);
+
+	for_each_cwq_cpu(cpu, wq) {
+		struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
+		struct global_cwq *gcwq = cwq->gcwq;
+		struct global_cwq *new_gcwq = gcwqs[cpu_to_node(cpu)];
+
+		spin_lock_irq(&gcwq->lock);
+		if (!ret && new_gcwq != gcwq) {
+			spin_lock_nested(&new_gcwq->lock, SINGLE_DEPTH_NESTING);
+			cwq->gcwq = new_gcwq;
+			spin_unlock(&gcwq->lock);
+			gcwq = new_gcwq;
+		}
+		cwq_adjust_max_active(cwq);
+		spin_unlock_irq(&gcwq->lock);
+	}
+
+	wq->flags &= ~WQ_REBINDING;
+	if (!ret)
+		copy_workqueue_attrs(wq->unbound_attrs, new_attrs);
+
+	spin_unlock(&workqueue_lock);
+	mutex_unlock(&wq->flush_mutex);
+out_unlock:
+	mutex_unlock(&wq_pool_mutex);
+out_free:
+	kfree(gcwqs);
+	free_workqueue_attrs(new_attrs);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(apply_workqueue_attrs);
+
+/* point the cwqs of the unbound @wq at the gcwqs of its attrs */
+static int init_unbound_cwqs(struct workqueue_struct *wq)
+{
+	struct global_cwq **gcwqs;
+	unsigned int cpu;
+	int ret;
+
+	gcwqs = kcalloc(nr_node_ids, sizeof(gcwqs[0]), GFP_KERNEL);
+	if (!gcwqs)
+		return -ENOMEM;
+
+	mutex_lock(&wq_pool_mutex);
+	ret = wq_get_unbound_gcwqs(wq, wq->unbound_attrs, gcwqs);
+	mutex_unlock(&wq_pool_mutex);
+
+	if (!ret)
+		for_each_cwq_cpu(cpu, wq)
+			get_cwq(cpu, wq)->gcwq = gcwqs[cpu_to_node(cpu)];
+
+	kfree(gcwqs);
+	return ret;
+}
+
+/* number of cwqs hanging off wq->cpu_wq.single */
+static int wq_nr_single_cwqs(struct workqueue_struct *wq)
+{
+	if (wq->flags & WQ_UNBOUND && !wq_single_unbound_cwq(wq))
+		return nr_node_ids;
+	return 1;
+}
+
 static int alloc_cwqs(struct workqueue_struct *wq)
 {
 	/*
@@ -2890,8 +3441,8 @@ static int alloc_cwqs(struct workqueue_struct *wq)
 	 * unsigned long long.
 	 */
 	const size_t size = sizeof(struct cpu_workqueue_struct);
-	const size_t align = max_t(size_t, 1 << WORK_STRUCT_FLAG_BITS,
-				   __alignof__(unsigned long long));
+	const size_t align = CWQ_ALIGN;
+	const size_t nr_bytes = wq_nr_single_cwqs(wq) * CWQ_STRIDE;
 #ifdef CONFIG_SMP
 	bool percpu = !(wq->flags & WQ_UNBOUND);
 #else
@@ -2904,14 +3455,14 @@ static int alloc_cwqs(struct workqueue_struct *wq)
 		void *ptr;
 
 		/*
-		 * Allocate enough room to align cwq and put an extra
+		 * Allocate enough room to align cwqs and put an extra
 		 * pointer at the end pointing back to the originally
 		 * allocated pointer which will be used for free.
 		 */
-		ptr = kzalloc(size + align + sizeof(void *), GFP_KERNEL);
+		ptr = kzalloc(nr_bytes + align + sizeof(void *), GFP_KERNEL);
 		if (ptr) {
 			wq->cpu_wq.single = PTR_ALIGN(ptr, align);
-			*(void **)(wq->cpu_wq.single + 1) = ptr;
+			*(void **)((void *)wq->cpu_wq.single + nr_bytes) = ptr;
 		}
 	}
 
@@ -2931,8 +3482,9 @@ static void free_cwqs(struct workqueue_struct *wq)
 	if (percpu)
 		free_percpu(wq->cpu_wq.pcpu);
 	else if (wq->cpu_wq.single) {
-		/* the pointer to free is stored right after the cwq */
-		kfree(*(void **)(wq->cpu_wq.single + 1));
+		/* the pointer to free is stored right after the cwqs */
+		kfree(*(void **)((void *)wq->cpu_wq.single +
+				 wq_nr_single_cwqs(wq) * CWQ_STRIDE));
 	}
 }
 
@@ -2949,6 +3501,286 @@ static int wq_clamp_max_active(int max_active, unsigned int flags,
 	return clamp_val(max_active, 1, lim);
 }
 
+#ifdef CONFIG_SYSFS
+/*
+ * Workqueues with WQ_SYSFS set are visible to userland via
+ * /sys/bus/workqueue/devices/WQ_NAME.  All visible workqueues have the
+ * following attributes.
+ *
+ *  per_cpu	RO bool	: whether the workqueue is per-cpu or unbound
+ *  max_active	RW int	: maximum number of in-flight work items
+ *
+ * Unbound workqueues have the following extra attributes.
+ *
+ *  pool_ids	RO int	: the associated gcwq ids for each node
+ *  nice	RW int	: nice value of the workers
+ *  cpumask	RW mask	: bitmask of allowed CPUs for the workers
+ */
+struct wq_device {
+	struct workqueue_struct		*wq;
+	struct device			dev;
+};
+
+static struct device *wq_root_dev;
+
+static struct workqueue_struct *dev_to_wq(struct device *dev)
+{
+	return container_of(dev, struct wq_device, dev)->wq;
+}
+
+static ssize_t wq_per_cpu_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", !(wq->flags & WQ_UNBOUND));
+}
+
+static ssize_t wq_max_active_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", wq->saved_max_active);
+}
+
+static ssize_t wq_max_active_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	int val;
+
+	if (sscanf(buf, "%d", &val) != 1 || val <= 0)
+		return -EINVAL;
+
+	workqueue_set_max_active(wq, val);
+	return count;
+}
+
+static struct device_attribute wq_sysfs_attrs[] = {
+	__ATTR(per_cpu, 0444, wq_per_cpu_show, NULL),
+	__ATTR(max_active, 0644, wq_max_active_show, wq_max_active_store),
+	__ATTR_NULL,
+};
+
+static ssize_t wq_pool_ids_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	const char *delim = "";
+	int written = 0;
+	unsigned int cpu;
+
+	spin_lock(&workqueue_lock);
+	for_each_cwq_cpu(cpu, wq) {
+		struct global_cwq *gcwq = get_cwq(cpu, wq)->gcwq;
+
+		written += scnprintf(buf + written, PAGE_SIZE - written,
+				     "%s%d:%u", delim, cpu_to_node(cpu),
+				     gcwq->cpu - WQ_UNBOUND_POOL_FIRST);
+		delim = " ";
+	}
+	spin_unlock(&workqueue_lock);
+
+	written += scnprintf(buf + written, PAGE_SIZE - written, "\n");
+	return written;
+}
+
+static ssize_t wq_nice_show(struct device *dev, struct device_attribute *attr,
+			    char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	int written;
+
+	mutex_lock(&wq_pool_mutex);
+	written = scnprintf(buf, PAGE_SIZE, "%d\n", wq->unbound_attrs->nice);
+	mutex_unlock(&wq_pool_mutex);
+
+	return written;
+}
+
+/* prepare workqueue_attrs for sysfs store operations */
+static struct workqueue_attrs *wq_sysfs_prep_attrs(struct workqueue_struct *wq)
+{
+	struct workqueue_attrs *attrs;
+
+	attrs = alloc_workqueue_attrs(GFP_KERNEL);
+	if (!attrs)
+		return NULL;
+
+	mutex_lock(&wq_pool_mutex);
+	copy_workqueue_attrs(attrs, wq->unbound_attrs);
+	mutex_unlock(&wq_pool_mutex);
+	return attrs;
+}
+
+static ssize_t wq_nice_store(struct device *dev, struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int ret;
+
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (!attrs)
+		return -ENOMEM;
+
+	if (sscanf(buf, "%d", &attrs->nice) == 1 &&
+	    attrs->nice >= -20 && attrs->nice <= 19)
+		ret = apply_workqueue_attrs(wq, attrs);
+	else
+		ret = -EINVAL;
+
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+
+static ssize_t wq_cpumask_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	int written;
+
+	mutex_lock(&wq_pool_mutex);
+	written = cpumask_scnprintf(buf, PAGE_SIZE, wq->unbound_attrs->cpumask);
+	mutex_unlock(&wq_pool_mutex);
+
+	written += scnprintf(buf + written, PAGE_SIZE - written, "\n");
+	return written;
+}
+
+static ssize_t wq_cpumask_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int ret;
+
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (!attrs)
+		return -ENOMEM;
+
+	ret = bitmap_parse(buf, count, cpumask_bits(attrs->cpumask),
+			   nr_cpumask_bits);
+	if (!ret)
+		ret = apply_workqueue_attrs(wq, attrs);
+
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+
+static struct device_attribute wq_sysfs_unbound_attrs[] = {
+	__ATTR(pool_ids, 0444, wq_pool_ids_show, NULL),
+	__ATTR(nice, 0644, wq_nice_show, wq_nice_store),
+	__ATTR(cpumask, 0644, wq_cpumask_show, wq_cpumask_store),
+	__ATTR_NULL,
+};
+
+static struct bus_type wq_subsys = {
+	.name				= "workqueue",
+	.dev_attrs			= wq_sysfs_attrs,
+};
+
+static void wq_device_release(struct device *dev)
+{
+	kfree(container_of(dev, struct wq_device, dev));
+}
+
+/**
+ * wq_sysfs_register - make a workqueue visible in sysfs
+ * @wq: the workqueue to register
+ *
+ * Expose @wq in sysfs under /sys/bus/workqueue/devices.  Called from
+ * alloc_workqueue() for workqueues with WQ_SYSFS set.  Workqueues
+ * allocated before sysfs is ready are picked up by wq_sysfs_init().
+ *
+ * RETURNS:
+ * 0 on success, -errno on failure.
+ */
+static int wq_sysfs_register(struct workqueue_struct *wq)
+{
+	struct device_attribute *attr;
+	struct wq_device *wq_dev;
+	int ret;
+
+	if (!wq_root_dev)
+		return 0;
+
+	wq_dev = kzalloc(sizeof(*wq_dev), GFP_KERNEL);
+	if (!wq_dev)
+		return -ENOMEM;
+
+	wq_dev->wq = wq;
+	wq_dev->dev.bus = &wq_subsys;
+	wq_dev->dev.parent = wq_root_dev;
+	wq_dev->dev.release = wq_device_release;
+	dev_set_name(&wq_dev->dev, "%s", wq->name);
+
+	ret = device_register(&wq_dev->dev);
+	if (ret) {
+		put_device(&wq_dev->dev);
+		return ret;
+	}
+
+	if (wq->flags & WQ_UNBOUND) {
+		for (attr = wq_sysfs_unbound_attrs; attr->attr.name; attr++) {
+			ret = device_create_file(&wq_dev->dev, attr);
+			if (ret) {
+				device_unregister(&wq_dev->dev);
+				return ret;
+			}
+		}
+	}
+
+	wq->wq_dev = wq_dev;
+	return 0;
+}
+
+static void wq_sysfs_unregister(struct workqueue_struct *wq)
+{
+	struct wq_device *wq_dev = wq->wq_dev;
+
+	if (!wq_dev)
+		return;
+
+	wq->wq_dev = NULL;
+	device_unregister(&wq_dev->dev);
+}
+
+static int __init wq_sysfs_init(void)
+{
+	struct workqueue_struct *wq;
+	struct device *root;
+	int ret;
+
+	ret = bus_register(&wq_subsys);
+	if (ret)
+		return ret;
+
+	root = root_device_register("workqueue");
+	if (IS_ERR(root))
+		return PTR_ERR(root);
+	wq_root_dev = root;
+
+	/*
+	 * Register the workqueues created so far.  Initcalls are run
+	 * one by one and nobody destroys workqueues this early, so
+	 * the list can be walked without workqueue_lock, which can't
+	 * be held across device_register() anyway.
+	 */
+	list_for_each_entry(wq, &workqueues, list)
+		if (wq->flags & WQ_SYSFS)
+			WARN_ON(wq_sysfs_register(wq));
+	return 0;
+}
+core_initcall(wq_sysfs_init);
+#else	/* CONFIG_SYSFS */
+static int wq_sysfs_register(struct workqueue_struct *wq)	{ return 0; }
+static void wq_sysfs_unregister(struct workqueue_struct *wq)	{ }
+#endif	/* CONFIG_SYSFS */
+
 struct workqueue_struct *__alloc_workqueue_key(const char *name,
 					       unsigned int flags,
 					       int max_active,
@@ -2975,6 +3807,13 @@ struct workqueue_struct *__alloc_workqueue_key(const char *name,
 	max_active = max_active ?: WQ_DFL_ACTIVE;
 	max_active = wq_clamp_max_active(max_active, flags, name);
 
+	/*
+	 * Unbound workqueues with max_active of 1 are expected to execute
+	 * works in order.  Don't split them into per-node cwqs.
+	 */
+	if (flags & WQ_UNBOUND && max_active == 1)
+		flags |= WQ_ORDERED;
+
 	wq = kzalloc(sizeof(*wq), GFP_KERNEL);
 	if (!wq)
 		goto err;
@@ -2995,16 +3834,22 @@ struct workqueue_struct *__alloc_workqueue_key(const char *name,
 
 	for_each_cwq_cpu(cpu, wq) {
 		struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
-		struct global_cwq *gcwq = get_gcwq(cpu);
 
 		BUG_ON((unsigned long)cwq & WORK_STRUCT_FLAG_MASK);
-		cwq->gcwq = gcwq;
+		if (!(flags & WQ_UNBOUND))
+			cwq->gcwq = get_gcwq(cpu);
 		cwq->wq = wq;
 		cwq->flush_color = -1;
 		cwq->max_active = max_active;
 		INIT_LIST_HEAD(&cwq->delayed_works);
 	}
 
+	if (flags & WQ_UNBOUND) {
+		wq->unbound_attrs = alloc_workqueue_attrs(GFP_KERNEL);
+		if (!wq->unbound_attrs || init_unbound_cwqs(wq))
+			goto err;
+	}
+
 	if (flags & WQ_RESCUER) {
 		struct worker *rescuer;
 
@@ -3038,12 +3883,18 @@ struct workqueue_struct *__alloc_workqueue_key(const char *name,
 
 	spin_unlock(&workqueue_lock);
 
+	if (wq->flags & WQ_SYSFS && wq_sysfs_register(wq)) {
+		destroy_workqueue(wq);
+		return NULL;
+	}
+
 	return wq;
 err:
 	if (wq) {
 		free_cwqs(wq);
 		free_mayday_mask(wq->mayday_mask);
 		kfree(wq->rescuer);
+		free_workqueue_attrs(wq->unbound_attrs);
 		kfree(wq);
 	}
 	return NULL;
@@ -3060,6 +3911,9 @@ void destroy_workqueue(struct workqueue_struct *wq)
 {
 	unsigned int cpu;
 
+	/* hide it from userland before anything else */
+	wq_sysfs_unregister(wq);
+
 	/* drain it before proceeding with destruction */
 	drain_workqueue(wq);
 
@@ -3089,6 +3943,7 @@ void destroy_workqueue(struct workqueue_struct *wq)
 	}
 
 	free_cwqs(wq);
+	free_workqueue_attrs(wq->unbound_attrs);
 	kfree(wq);
 }
 EXPORT_SYMBOL_GPL(destroy_workqueue);
@@ -3113,17 +3968,19 @@ void workqueue_set_max_active(struct workqueue_struct *wq, int max_active)
 
 	wq->saved_max_active = max_active;
 
+	/* apply_workqueue_attrs() restores max_active once it's done */
+	if (wq->flags & WQ_REBINDING)
+		goto out_unlock;
+
 	for_each_cwq_cpu(cpu, wq) {
-		struct global_cwq *gcwq = get_gcwq(cpu);
+		struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
+		struct global_cwq *gcwq = cwq->gcwq;
 
 		spin_lock_irq(&gcwq->lock);
-
-		if (!(wq->flags & WQ_FREEZABLE) ||
-		    !(gcwq->flags & GCWQ_FREEZING))
-			get_cwq(gcwq->cpu, wq)->max_active = max_active;
-
+		cwq_adjust_max_active(cwq);
 		spin_unlock_irq(&gcwq->lock);
 	}
+out_unlock:
 
 	spin_unlock(&workqueue_lock);
 }
@@ -3154,13 +4011,16 @@ EXPORT_SYMBOL_GPL(workqueue_congested);
  * @work: the work of interest
  *
  * RETURNS:
- * CPU number if @work was ever queued.  WORK_CPU_NONE otherwise.
+ * CPU number if @work was ever queued, WORK_CPU_UNBOUND if it was last
+ * on an unbound gcwq.  WORK_CPU_NONE otherwise.
  */
 unsigned int work_cpu(struct work_struct *work)
 {
 	struct global_cwq *gcwq = get_work_gcwq(work);
 
-	return gcwq ? gcwq->cpu : WORK_CPU_NONE;
+	if (!gcwq)
+		return WORK_CPU_NONE;
+	return gcwq_is_unbound(gcwq) ? WORK_CPU_UNBOUND : gcwq->cpu;
 }
 EXPORT_SYMBOL_GPL(work_cpu);
 
@@ -3635,6 +4495,7 @@ EXPORT_SYMBOL_GPL(work_on_cpu);
  */
 void freeze_workqueues_begin(void)
 {
+	struct workqueue_struct *wq;
 	unsigned int cpu;
 
 	spin_lock(&workqueue_lock);
@@ -3644,21 +4505,25 @@ void freeze_workqueues_begin(void)
 
 	for_each_gcwq_cpu(cpu) {
 		struct global_cwq *gcwq = get_gcwq(cpu);
-		struct workqueue_struct *wq;
 
 		spin_lock_irq(&gcwq->lock);
-
 		BUG_ON(gcwq->flags & GCWQ_FREEZING);
 		gcwq->flags |= GCWQ_FREEZING;
+		spin_unlock_irq(&gcwq->lock);
+	}
+
+	/* cwqs being rebound already have zero max_active */
+	list_for_each_entry(wq, &workqueues, list) {
+		if (!(wq->flags & WQ_FREEZABLE) || wq->flags & WQ_REBINDING)
+			continue;
 
-		list_for_each_entry(wq, &workqueues, list) {
+		for_each_cwq_cpu(cpu, wq) {
 			struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
 
-			if (cwq && wq->flags & WQ_FREEZABLE)
-				cwq->max_active = 0;
+			spin_lock_irq(&cwq->gcwq->lock);
+			cwq->max_active = 0;
+			spin_unlock_irq(&cwq->gcwq->lock);
 		}
-
-		spin_unlock_irq(&gcwq->lock);
 	}
 
 	spin_unlock(&workqueue_lock);
@@ -3679,6 +4544,7 @@ void freeze_workqueues_begin(void)
  */
 bool freeze_workqueues_busy(void)
 {
+	struct workqueue_struct *wq;
 	unsigned int cpu;
 	bool busy = false;
 
@@ -3686,18 +4552,16 @@ bool freeze_workqueues_busy(void)
 
 	BUG_ON(!workqueue_freezing);
 
-	for_each_gcwq_cpu(cpu) {
-		struct workqueue_struct *wq;
+	list_for_each_entry(wq, &workqueues, list) {
+		if (!(wq->flags & WQ_FREEZABLE))
+			continue;
 		/*
 		 * nr_active is monotonically decreasing.  It's safe
 		 * to peek without lock.
 		 */
-		list_for_each_entry(wq, &workqueues, list) {
+		for_each_cwq_cpu(cpu, wq) {
 			struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
 
-			if (!cwq || !(wq->flags & WQ_FREEZABLE))
-				continue;
-
 			BUG_ON(cwq->nr_active < 0);
 			if (cwq->nr_active) {
 				busy = true;
@@ -3721,6 +4585,7 @@ out_unlock:
  */
 void thaw_workqueues(void)
 {
+	struct workqueue_struct *wq;
 	unsigned int cpu;
 
 	spin_lock(&workqueue_lock);
@@ -3728,80 +4593,92 @@ void thaw_workqueues(void)
 	if (!workqueue_freezing)
 		goto out_unlock;
 
+	workqueue_freezing = false;
+
 	for_each_gcwq_cpu(cpu) {
 		struct global_cwq *gcwq = get_gcwq(cpu);
-		struct workqueue_struct *wq;
 
 		spin_lock_irq(&gcwq->lock);
-
 		BUG_ON(!(gcwq->flags & GCWQ_FREEZING));
 		gcwq->flags &= ~GCWQ_FREEZING;
+		spin_unlock_irq(&gcwq->lock);
+	}
 
-		list_for_each_entry(wq, &workqueues, list) {
-			struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
+	/* cwqs being rebound get their max_active back once that's done */
+	list_for_each_entry(wq, &workqueues, list) {
+		if (!(wq->flags & WQ_FREEZABLE) || wq->flags & WQ_REBINDING)
+			continue;
 
-			if (!cwq || !(wq->flags & WQ_FREEZABLE))
-				continue;
+		for_each_cwq_cpu(cpu, wq) {
+			struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
 
 			/* restore max_active and repopulate worklist */
-			cwq->max_active = wq->saved_max_active;
-
-			while (!list_empty(&cwq->delayed_works) &&
-			       cwq->nr_active < cwq->max_active)
-				cwq_activate_first_delayed(cwq);
+			spin_lock_irq(&cwq->gcwq->lock);
+			cwq_adjust_max_active(cwq);
+			spin_unlock_irq(&cwq->gcwq->lock);
 		}
-
-		wake_up_worker(gcwq);
-
-		spin_unlock_irq(&gcwq->lock);
 	}
-
-	workqueue_freezing = false;
 out_unlock:
 	spin_unlock(&workqueue_lock);
 }
 #endif /* CONFIG_FREEZER */
 
-static int __init init_workqueues(void)
+/*
+ * Build the NUMA node to possible CPUs mapping used to split unbound
+ * workqueues into per-node cwqs.  Leaves per-node cwqs disabled on
+ * single node machines and if the mapping looks bogus.
+ */
+static void __init wq_numa_init(void)
 {
+	cpumask_var_t *tbl;
 	unsigned int cpu;
-	int i;
+	int node;
 
-	cpu_notifier(workqueue_cpu_callback, CPU_PRI_WORKQUEUE);
+	if (num_possible_nodes() <= 1 || wq_disable_numa)
+		return;
 
-	/* initialize gcwqs */
-	for_each_gcwq_cpu(cpu) {
-		struct global_cwq *gcwq = get_gcwq(cpu);
+	tbl = kzalloc(nr_node_ids * sizeof(tbl[0]), GFP_KERNEL);
+	BUG_ON(!tbl);
 
-		spin_lock_init(&gcwq->lock);
-		INIT_LIST_HEAD(&gcwq->worklist);
-		gcwq->cpu = cpu;
-		gcwq->flags |= GCWQ_DISASSOCIATED;
+	for_each_node(node)
+		BUG_ON(!zalloc_cpumask_var_node(&tbl[node], GFP_KERNEL,
+				node_online(node) ? node : NUMA_NO_NODE));
+	BUG_ON(!zalloc_cpumask_var(&wq_numa_cwq_cpus, GFP_KERNEL));
 
-		INIT_LIST_HEAD(&gcwq->idle_list);
-		for (i = 0; i < BUSY_WORKER_HASH_SIZE; i++)
-			INIT_HLIST_HEAD(&gcwq->busy_hash[i]);
+	for_each_possible_cpu(cpu) {
+		node = cpu_to_node(cpu);
+		if (WARN_ON(node == NUMA_NO_NODE)) {
+			pr_warning("workqueue: NUMA node mapping not available for cpu%u, disabling NUMA support\n",
+				   cpu);
+			return;
+		}
+		if (cpumask_empty(tbl[node]))
+			cpumask_set_cpu(cpu, wq_numa_cwq_cpus);
+		cpumask_set_cpu(cpu, tbl[node]);
+	}
 
-		init_timer_deferrable(&gcwq->idle_timer);
-		gcwq->idle_timer.function = idle_worker_timeout;
-		gcwq->idle_timer.data = (unsigned long)gcwq;
+	wq_numa_possible_cpumask = tbl;
+	wq_numa_enabled = true;
+}
 
-		setup_timer(&gcwq->mayday_timer, gcwq_mayday_timeout,
-			    (unsigned long)gcwq);
+static int __init init_workqueues(void)
+{
+	unsigned int cpu;
 
-		ida_init(&gcwq->worker_ida);
+	cpu_notifier(workqueue_cpu_callback, CPU_PRI_WORKQUEUE);
 
-		gcwq->trustee_state = TRUSTEE_DONE;
-		init_waitqueue_head(&gcwq->trustee_wait);
-	}
+	/* initialize per-cpu gcwqs, unbound ones are created on demand */
+	for_each_possible_cpu(cpu)
+		init_gcwq(get_gcwq(cpu), cpu);
+
+	wq_numa_init();
 
 	/* create the initial worker */
-	for_each_online_gcwq_cpu(cpu) {
+	for_each_online_cpu(cpu) {
 		struct global_cwq *gcwq = get_gcwq(cpu);
 		struct worker *worker;
 
-		if (cpu != WORK_CPU_UNBOUND)
-			gcwq->flags &= ~GCWQ_DISASSOCIATED;
+		gcwq->flags &= ~GCWQ_DISASSOCIATED;
 		worker = create_worker(gcwq, true);
 		BUG_ON(!worker);
 		spin_lock_irq(&gcwq->lock);
@@ -3812,7 +4689,8 @@ static int __init init_workqueues(void)
 	system_wq = alloc_workqueue("events", 0, 0);
 	system_long_wq = alloc_workqueue("events_long", 0, 0);
 	system_nrt_wq = alloc_workqueue("events_nrt", WQ_NON_REENTRANT, 0);
-	system_unbound_wq = alloc_workqueue("events_unbound", WQ_UNBOUND,
+	system_unbound_wq = alloc_workqueue("events_unbound",
+					    WQ_UNBOUND | WQ_SYSFS,
 					    WQ_UNBOUND_MAX_ACTIVE);
 	system_freezable_wq = alloc_workqueue("events_freezable",
 					      WQ_FREEZABLE, 0);
@@ -1771,8 +1771,72 @@ page_not_uptodate:
 }
 EXPORT_SYMBOL(filemap_fault);
 
+/**
+ * filemap_map_pages - map the cached pages around a read fault
+ * @vma:	vma in which the fault was taken
+ * @vmf:	range of pages to map, see struct vm_fault
+ *
+ * Maps the pages of the range that are uptodate in the page cache and
+ * can be locked without waiting into the empty ptes.  Everything else
+ * is left alone for filemap_fault() to deal with: missing pages, pages
+ * under I/O and pages carrying the readahead mark, so that hitting one
+ * of those still kicks off asynchronous readahead.
+ *
+ * The reference the page cache lookup takes is handed over to the pte,
+ * only the pages that are skipped have it dropped again.
+ */
+void filemap_map_pages(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	unsigned long address = (unsigned long)vmf->virtual_address;
+	struct page *pages[PAGEVEC_SIZE];
+	pgoff_t index = vmf->pgoff;
+	pgoff_t size;
+	int nr, i;
+
+	size = DIV_ROUND_UP(i_size_read(mapping->host), PAGE_CACHE_SIZE);
+
+	while (index <= vmf->max_pgoff) {
+		nr = find_get_pages(mapping, index,
+				    min_t(pgoff_t, vmf->max_pgoff - index + 1,
+					  PAGEVEC_SIZE), pages);
+		if (!nr)
+			break;
+
+		for (i = 0; i < nr; i++) {
+			struct page *page = pages[i];
+			pgoff_t off = page->index - vmf->pgoff;
+			pte_t *pte = vmf->pte + off;
+
+			index = page->index + 1;
+			if (page->index > vmf->max_pgoff ||
+			    page->index >= size)
+				goto skip;
+			if (!PageUptodate(page) || PageReadahead(page) ||
+			    PageHWPoison(page))
+				goto skip;
+			if (!pte_none(*pte) || !trylock_page(page))
+				goto skip;
+			/* truncated or invalidated under us */
+			if (page->mapping != mapping || !PageUptodate(page))
+				goto unlock;
+
+			do_set_pte(vma, address + (off << PAGE_SHIFT),
+				   page, pte);
+			unlock_page(page);
+			continue;
+unlock:
+			unlock_page(page);
+skip:
+			page_cache_release(page);
+		}
+	}
+}
+EXPORT_SYMBOL(filemap_map_pages);
+
 const struct vm_operations_struct generic_file_vm_ops = {
 	.fault		= filemap_fault,
+	.map_pages	= filemap_map_pages,
 };
 
 /* This is used for a general mmap of a disk file */
@@ -1848,6 +1848,9 @@ static void collapse_huge_page(struct mm_struct *mm,
 	/* pmd can't go away or become huge under us */
 	if (!pmd_present(*pmd) || pmd_trans_huge(*pmd))
 		goto out;
+	/* nor can the pages of a page table another mm shares */
+	if (pte_table_shared(pmd))
+		goto out;
 
 	anon_vma_lock(vma->anon_vma);
 
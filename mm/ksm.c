@@ -1469,6 +1469,11 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 				 VM_NONLINEAR | VM_MIXEDMAP | VM_SAO))
 			return 0;		/* just ignore the advice */
 
+		/* ksmd changes ptes behind the back of other sharers */
+		err = unshare_pte_range(vma, start, end);
+		if (err)
+			return err;
+
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
 			err = __ksm_enter(mm);
 			if (err)
@@ -172,6 +172,13 @@ static long madvise_dontneed(struct vm_area_struct * vma,
 	if (vma->vm_flags & (VM_LOCKED|VM_HUGETLB|VM_PFNMAP))
 		return -EINVAL;
 
+	/*
+	 * Dropping a page table shared by fork() clears its pmd, which is
+	 * not allowed while faults can still find the vma: copy them.
+	 */
+	if (unshare_pte_range(vma, start, end))
+		return -ENOMEM;
+
 	if (unlikely(vma->vm_flags & VM_NONLINEAR)) {
 		struct zap_details details = {
 			.nonlinear_vma = vma,
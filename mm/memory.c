@@ -51,12 +51,14 @@
 #include <linux/delayacct.h>
 #include <linux/init.h>
 #include <linux/writeback.h>
+#include <linux/backing-dev.h>
 #include <linux/memcontrol.h>
 #include <linux/mmu_notifier.h>
 #include <linux/kallsyms.h>
 #include <linux/swapops.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
+#include <linux/debugfs.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -423,6 +425,7 @@ static void free_pte_range(struct mmu_gather *tlb, pmd_t *pmd,
 			   unsigned long addr)
 {
 	pgtable_t token = pmd_pgtable(*pmd);
+	VM_BUG_ON(pgtable_shared(token));
 	pmd_clear(pmd);
 	pte_free_tlb(tlb, token, addr);
 	tlb->mm->nr_ptes--;
@@ -987,10 +990,316 @@ again:
 	return 0;
 }
 
+#ifdef CONFIG_FORK_SHARE_PTE
+int sysctl_fork_share_pte __read_mostly = 1;
+
+/*
+ * Copying the ptes of a large anonymous mapping at fork means taking a
+ * reference and a mapcount on every page it maps, all with mmap_sem held
+ * for writing. Instead, the child maps the parent's page table itself,
+ * and whichever process first needs to change the ptes of a shared table
+ * - a fault, mprotect, mremap or a partial unmap - takes a private copy
+ * of it with unshare_pte_table(). Until then the table, and the pages it
+ * maps, count as a single mapping for rmap.
+ *
+ * To keep that simple:
+ *  - only tables lying entirely within a private anonymous vma are
+ *    shared, and vma_adjust() unshares a table before a vma boundary
+ *    can split it;
+ *  - their ptes are write-protected, so writes fault, including writes
+ *    through get_user_pages(); read faults on present ptes leave the
+ *    table shared;
+ *  - tables holding swap or migration entries are copied, and
+ *    try_to_unmap() unshares a table before unmapping a page from it,
+ *    so a shared table only holds present ptes, which stay put until it
+ *    is unshared.
+ *
+ * The mm_struct page_table_lock of the sharer is nested outside the page
+ * table lock, which must be split: both mms lock the same table.
+ */
+static inline int vma_can_share_pte(struct vm_area_struct *vma)
+{
+	if (!USE_SPLIT_PTLOCKS || !sysctl_fork_share_pte)
+		return 0;
+	if (vma->vm_file || vma->vm_ops || !vma->anon_vma)
+		return 0;
+	if (vma->vm_flags & (VM_MERGEABLE | VM_HUGETLB | VM_NONLINEAR |
+			     VM_PFNMAP | VM_INSERTPAGE | VM_MIXEDMAP))
+		return 0;
+	return is_cow_mapping(vma->vm_flags);
+}
+
+/*
+ * Let dst_mm map the page table at src_pmd, which covers the PMD_SIZE
+ * range at addr. Returns nonzero if the table has to be copied instead.
+ */
+static int share_pte_table(struct mm_struct *dst_mm, struct mm_struct *src_mm,
+			   pmd_t *dst_pmd, pmd_t *src_pmd,
+			   struct vm_area_struct *vma, unsigned long addr)
+{
+	unsigned long end = addr + PMD_SIZE;
+	pte_t *orig_pte, *pte;
+	spinlock_t *ptl;
+	int rss[NR_MM_COUNTERS];
+	int ret = 0;
+
+	init_rss_vec(rss);
+	orig_pte = pte = pte_offset_map_lock(src_mm, src_pmd, addr, &ptl);
+	arch_enter_lazy_mmu_mode();
+	do {
+		if (pte_none(*pte))
+			continue;
+		if (!pte_present(*pte)) {
+			ret = -EAGAIN;
+			break;
+		}
+		if (pte_write(*pte))
+			ptep_set_wrprotect(src_mm, addr, pte);
+		if (vm_normal_page(vma, addr, *pte))
+			rss[MM_ANONPAGES]++;
+	} while (pte++, addr += PAGE_SIZE, addr != end);
+	arch_leave_lazy_mmu_mode();
+
+	if (!ret) {
+		pmd_pgtable(*src_pmd)->index++;
+		dst_mm->nr_ptes++;
+		pmd_populate(dst_mm, dst_pmd, pmd_pgtable(*src_pmd));
+		add_mm_rss_vec(dst_mm, rss);
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+	return ret;
+}
+
+/*
+ * Copy the shared table at pmd into new and make pmd point to the copy,
+ * unless another thread has unshared it already. Consumes new if used.
+ */
+static void __unshare_pte_table(struct vm_area_struct *vma, pmd_t *pmd,
+				unsigned long address, pgtable_t *newp)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long addr = address & PMD_MASK;
+	unsigned long end = addr + PMD_SIZE;
+	pgtable_t new = *newp, table;
+	pte_t *orig_src_pte, *orig_dst_pte;
+	pte_t *src_pte, *dst_pte;
+	spinlock_t *ptl;
+
+	spin_lock(&mm->page_table_lock);
+	/* Has another thread unshared it already? */
+	if (!pmd_present(*pmd) || pmd_trans_huge(*pmd))
+		goto out;
+	table = pmd_pgtable(*pmd);
+	ptl = pte_lockptr(mm, pmd);
+	spin_lock(ptl);
+	if (!pgtable_shared(table)) {
+		spin_unlock(ptl);
+		goto out;
+	}
+
+	orig_src_pte = src_pte = pte_offset_map(pmd, addr);
+	orig_dst_pte = dst_pte = kmap_atomic(new);
+	arch_enter_lazy_mmu_mode();
+	do {
+		struct page *page;
+
+		if (pte_none(*src_pte))
+			continue;
+		page = vm_normal_page(vma, addr, *src_pte);
+		if (page) {
+			get_page(page);
+			page_dup_rmap(page);
+		}
+		set_pte_at(mm, addr, dst_pte, *src_pte);
+	} while (dst_pte++, src_pte++, addr += PAGE_SIZE, addr != end);
+	arch_leave_lazy_mmu_mode();
+	kunmap_atomic(orig_dst_pte);
+	pte_unmap(orig_src_pte);
+
+	/* See __pte_alloc() */
+	smp_wmb();
+	pmd_populate(mm, pmd, new);
+	*newp = NULL;
+	/*
+	 * Nothing in this mm may still walk the old table once the others
+	 * are free to change or free it.
+	 */
+	flush_tlb_range(vma, end - PMD_SIZE, end);
+	table->index--;
+	spin_unlock(ptl);
+out:
+	spin_unlock(&mm->page_table_lock);
+}
+
+/**
+ * unshare_pte_table - give an mm its own copy of a page table
+ * @vma: vma of the mm, covering or next to the table
+ * @pmd: pmd entry pointing to the table
+ * @address: any address the table maps
+ *
+ * The copy takes a reference and a mapcount on each page mapped, as fork
+ * would have done; the mm's rss already accounts for them. Called with
+ * mmap_sem held, may sleep. Returns 0 or -ENOMEM.
+ */
+int unshare_pte_table(struct vm_area_struct *vma, pmd_t *pmd,
+		      unsigned long address)
+{
+	pgtable_t new;
+
+	new = pte_alloc_one(vma->vm_mm, address & PMD_MASK);
+	if (!new)
+		return -ENOMEM;
+	__unshare_pte_table(vma, pmd, address, &new);
+	if (new)
+		pte_free(vma->vm_mm, new);
+	return 0;
+}
+
+/**
+ * try_unshare_pte_table - unshare the page table mapping an address
+ * @vma: vma of the mm, covering @address
+ * @address: address mapped by the table
+ *
+ * unshare_pte_table() for try_to_unmap(), which holds the anon_vma lock
+ * and the page lock, but not mmap_sem: the vma and its page tables stay
+ * put because they are still linked to the anon_vma.  Allocating with
+ * reclaim could then recurse into the same anon_vma, so the copy is
+ * allocated without sleeping, as x86's pte_alloc_one() does otherwise.
+ * Returns 0 or -ENOMEM, in which case the caller should retry later.
+ */
+int try_unshare_pte_table(struct vm_area_struct *vma, unsigned long address)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	pgtable_t new;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, address);
+	if (!pgd_present(*pgd))
+		return 0;
+	pud = pud_offset(pgd, address);
+	if (!pud_present(*pud))
+		return 0;
+	pmd = pmd_offset(pud, address);
+	if (!pmd_present(*pmd) || pmd_trans_huge(*pmd) ||
+	    !pte_table_shared(pmd))
+		return 0;
+
+	new = alloc_page(GFP_NOWAIT | __GFP_NOWARN | __GFP_ZERO);
+	if (!new)
+		return -ENOMEM;
+	pgtable_page_ctor(new);
+	__unshare_pte_table(vma, pmd, address, &new);
+	if (new)
+		pte_free(mm, new);
+	return 0;
+}
+
+/**
+ * unshare_pte_range - unshare the page tables mapping a range
+ * @vma: vma of the mm, covering or next to the range
+ * @start: start address
+ * @end: end address
+ *
+ * Called with mmap_sem held, before changing ptes in [@start, @end).
+ */
+int unshare_pte_range(struct vm_area_struct *vma,
+		      unsigned long start, unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long addr, next;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	for (addr = start; addr < end; addr = next) {
+		next = pmd_addr_end(addr, end);
+		pgd = pgd_offset(mm, addr);
+		if (!pgd_present(*pgd))
+			continue;
+		pud = pud_offset(pgd, addr);
+		if (!pud_present(*pud))
+			continue;
+		pmd = pmd_offset(pud, addr);
+		if (!pmd_present(*pmd) || pmd_trans_huge(*pmd))
+			continue;
+		if (pte_table_shared(pmd) && unshare_pte_table(vma, pmd, addr))
+			return -ENOMEM;
+	}
+	return 0;
+}
+
+/*
+ * The whole range mapped by a shared page table is being unmapped from
+ * this mm: just drop its hold on the table, the pages stay mapped by the
+ * other mms. Returns 0 if the table turned out not to be shared anymore.
+ *
+ * This clears the pmd, so it must only be reached once no fault can find
+ * the vma: from munmap, which has detached it, or on a dead mm (exit).
+ * madvise(MADV_DONTNEED) unshares the tables before zapping them.
+ */
+static int zap_shared_pte_table(struct mmu_gather *tlb,
+				struct vm_area_struct *vma, pmd_t *pmd,
+				unsigned long addr)
+{
+	struct mm_struct *mm = tlb->mm;
+	unsigned long end = addr + PMD_SIZE;
+	pgtable_t table;
+	pte_t *orig_pte, *pte;
+	spinlock_t *ptl;
+	int rss[NR_MM_COUNTERS];
+	int ret = 0;
+
+	init_rss_vec(rss);
+	spin_lock(&mm->page_table_lock);
+	table = pmd_pgtable(*pmd);
+	orig_pte = pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+	if (!pgtable_shared(table))
+		goto out;
+	do {
+		if (!pte_none(*pte) && vm_normal_page(vma, addr, *pte))
+			rss[MM_ANONPAGES]--;
+	} while (pte++, addr += PAGE_SIZE, addr != end);
+	pmd_clear(pmd);
+	/* See unshare_pte_table() */
+	flush_tlb_range(vma, end - PMD_SIZE, end);
+	table->index--;
+	mm->nr_ptes--;
+	add_mm_rss_vec(mm, rss);
+	ret = 1;
+out:
+	pte_unmap_unlock(orig_pte, ptl);
+	spin_unlock(&mm->page_table_lock);
+	return ret;
+}
+#else
+static inline int vma_can_share_pte(struct vm_area_struct *vma)
+{
+	return 0;
+}
+
+static inline int share_pte_table(struct mm_struct *dst_mm,
+				  struct mm_struct *src_mm,
+				  pmd_t *dst_pmd, pmd_t *src_pmd,
+				  struct vm_area_struct *vma, unsigned long addr)
+{
+	return -EINVAL;
+}
+
+static inline int zap_shared_pte_table(struct mmu_gather *tlb,
+				       struct vm_area_struct *vma, pmd_t *pmd,
+				       unsigned long addr)
+{
+	return 0;
+}
+#endif /* CONFIG_FORK_SHARE_PTE */
+
 static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pud_t *dst_pud, pud_t *src_pud, struct vm_area_struct *vma,
 		unsigned long addr, unsigned long end)
 {
+	int share = vma_can_share_pte(vma);
 	pmd_t *src_pmd, *dst_pmd;
 	unsigned long next;
 
@@ -1013,6 +1322,10 @@ static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src
 		}
 		if (pmd_none_or_clear_bad(src_pmd))
 			continue;
+		if (share && next - addr == PMD_SIZE &&
+		    !share_pte_table(dst_mm, src_mm, dst_pmd, src_pmd,
+				     vma, addr))
+			continue;
 		if (copy_pte_range(dst_mm, src_mm, dst_pmd, src_pmd,
 						vma, addr, next))
 			return -ENOMEM;
@@ -1237,6 +1550,20 @@ static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 		}
 		if (pmd_none_or_clear_bad(pmd))
 			continue;
+		if (unlikely(pte_table_shared(pmd))) {
+			if (next - addr == PMD_SIZE) {
+				if (zap_shared_pte_table(tlb, vma, pmd, addr))
+					continue;
+			} else {
+				/*
+				 * Only this mm's ptes may go: take a copy
+				 * of the table. Callers unmapping part of
+				 * a vma normally did so already.
+				 */
+				while (unshare_pte_table(vma, pmd, addr))
+					congestion_wait(BLK_RW_ASYNC, HZ/50);
+			}
+		}
 		next = zap_pte_range(tlb, vma, pmd, addr, next, details);
 		cond_resched();
 	} while (pmd++, addr = next, addr != end);
@@ -3129,6 +3456,110 @@ oom:
 	return VM_FAULT_OOM;
 }
 
+/**
+ * do_set_pte - map a page cache page read-only
+ * @vma: the file mapping
+ * @address: user virtual address to map it at
+ * @page: the locked page, whose reference is taken over by the pte
+ * @pte: the empty pte of @address
+ *
+ * Used by ->map_pages() implementations; the caller holds the page
+ * table lock.
+ */
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte)
+{
+	pte_t entry;
+
+	flush_icache_page(vma, page);
+	entry = mk_pte(page, vma->vm_page_prot);
+	inc_mm_counter_fast(vma->vm_mm, MM_FILEPAGES);
+	page_add_file_rmap(page);
+	set_pte_at(vma->vm_mm, address, pte, entry);
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+}
+
+/*
+ * Size of the naturally aligned window of file pages around a read
+ * fault that ->map_pages() maps if they are in the page cache already.
+ * A power of two number of pages no larger than a page table; one page
+ * disables fault-around.
+ */
+static unsigned long fault_around_bytes __read_mostly = 65536;
+
+#ifdef CONFIG_DEBUG_FS
+static int fault_around_bytes_get(void *data, u64 *val)
+{
+	*val = fault_around_bytes;
+	return 0;
+}
+
+static int fault_around_bytes_set(void *data, u64 val)
+{
+	if (val / PAGE_SIZE > PTRS_PER_PTE)
+		return -EINVAL;
+	if (val > PAGE_SIZE)
+		fault_around_bytes = rounddown_pow_of_two(val);
+	else
+		fault_around_bytes = PAGE_SIZE;
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(fault_around_bytes_fops,
+		fault_around_bytes_get, fault_around_bytes_set, "%llu\n");
+
+static int __init fault_around_debugfs(void)
+{
+	if (!debugfs_create_file("fault_around_bytes", 0644, NULL, NULL,
+				 &fault_around_bytes_fops))
+		printk(KERN_WARNING "Failed to create fault_around_bytes in debugfs\n");
+	return 0;
+}
+late_initcall(fault_around_debugfs);
+#endif
+
+/*
+ * Let ->map_pages() map the cached pages of the fault-around window
+ * of @address that fall into the vma and into the page table of @pte,
+ * which is locked.  Nothing is done if the ptes of the window are all
+ * populated, which is the case for a refault of a mapped file.
+ */
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+		pte_t *pte, pgoff_t pgoff, unsigned int flags)
+{
+	unsigned long start_addr, end_addr, nr_pages, mask;
+	struct vm_fault vmf;
+	int off;
+
+	nr_pages = ACCESS_ONCE(fault_around_bytes) >> PAGE_SHIFT;
+	mask = ~(nr_pages * PAGE_SIZE - 1) & PAGE_MASK;
+
+	start_addr = max(address & mask, vma->vm_start);
+	end_addr = min((address & mask) + nr_pages * PAGE_SIZE, vma->vm_end);
+
+	off = (address - start_addr) >> PAGE_SHIFT;
+	pte -= off;
+	pgoff -= off;
+
+	/* skip the populated ptes at the start of the window */
+	while (!pte_none(*pte)) {
+		start_addr += PAGE_SIZE;
+		if (start_addr >= end_addr)
+			return;
+		pte++;
+		pgoff++;
+	}
+
+	vmf.virtual_address = (void __user *)start_addr;
+	vmf.pte = pte;
+	vmf.pgoff = pgoff;
+	vmf.max_pgoff = pgoff + ((end_addr - start_addr) >> PAGE_SHIFT) - 1;
+	vmf.flags = flags;
+	vmf.page = NULL;
+	vma->vm_ops->map_pages(vma, &vmf);
+}
+
 /*
  * __do_fault() tries to create a new page mapping. It aggressively
  * tries to share with existing pages, but makes a separate copy if
@@ -3334,7 +3765,24 @@ static int do_linear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	pgoff_t pgoff = (((address & PAGE_MASK)
 			- vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
 
-	pte_unmap(page_table);
+	/*
+	 * On a read fault, map what is cached around the address first:
+	 * if that covers the faulting page too, we are done.
+	 */
+	if (!(flags & FAULT_FLAG_WRITE) && vma->vm_ops->map_pages &&
+	    fault_around_bytes >> PAGE_SHIFT > 1) {
+		spinlock_t *ptl = pte_lockptr(mm, pmd);
+		int mapped;
+
+		spin_lock(ptl);
+		do_fault_around(vma, address & PAGE_MASK, page_table,
+				pgoff, flags);
+		mapped = !pte_same(*page_table, orig_pte);
+		pte_unmap_unlock(page_table, ptl);
+		if (mapped)
+			return 0;
+	} else
+		pte_unmap(page_table);
 	return __do_fault(mm, vma, address, pmd, pgoff, flags, orig_pte);
 }
 
@@ -3446,6 +3894,7 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	pud_t *pud;
 	pmd_t *pmd;
 	pte_t *pte;
+	pte_t entry;
 
 	__set_current_state(TASK_RUNNING);
 
@@ -3492,6 +3941,19 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	/* if an huge pmd materialized from under us just retry later */
 	if (unlikely(pmd_trans_huge(*pmd)))
 		return 0;
+	/*
+	 * A write fault on a page table shared by fork() changes its ptes,
+	 * and so does a fault on an empty pte; a read fault on a present
+	 * one only touches the accessed bit, which can stay shared.
+	 */
+	if (unlikely(pte_table_shared(pmd))) {
+		pte = pte_offset_map(pmd, address);
+		entry = *pte;
+		pte_unmap(pte);
+		if (((flags & FAULT_FLAG_WRITE) || !pte_present(entry)) &&
+		    unshare_pte_table(vma, pmd, address))
+			return VM_FAULT_OOM;
+	}
 	/*
 	 * A regular pmd is established and it can't morph into a huge pmd
 	 * from under us anymore at this point because we hold the mmap_sem
@@ -3580,6 +4042,68 @@ int make_pages_present(unsigned long addr, unsigned long end)
 	return ret == len ? 0 : -EFAULT;
 }
 
+/**
+ * map_cached_pages - map page cache pages of a read-only file mapping
+ * @vma: the file mapping
+ * @start: first address to map
+ * @end: end of the range to map
+ *
+ * Populates the ptes of [@start, @end) with the pages of the file that
+ * are uptodate in the page cache, through the ->map_pages() operation
+ * of the mapping, without taking a fault on each of them.  Pages that
+ * are not cached or busy are skipped and will be faulted in as usual,
+ * so this never does I/O and never fails.  Used by exec for the text
+ * of the binary and its interpreter, which for common programs is
+ * shared by many processes.
+ *
+ * The caller must hold mmap_sem.
+ */
+void map_cached_pages(struct vm_area_struct *vma, unsigned long start,
+		unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct vm_fault vmf;
+	unsigned long next;
+	spinlock_t *ptl;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte;
+
+	if (!vma->vm_ops || !vma->vm_ops->map_pages)
+		return;
+	if (vma->vm_flags & (VM_WRITE | VM_LOCKED | VM_NONLINEAR))
+		return;
+
+	start = max(start & PAGE_MASK, vma->vm_start);
+	end = min(PAGE_ALIGN(end), vma->vm_end);
+
+	for (; start < end; start = next) {
+		next = pmd_addr_end(start, end);
+		pgd = pgd_offset(mm, start);
+		pud = pud_alloc(mm, pgd, start);
+		if (!pud)
+			return;
+		pmd = pmd_alloc(mm, pud, start);
+		if (!pmd)
+			return;
+		if (pmd_none(*pmd) && __pte_alloc(mm, vma, pmd, start))
+			return;
+		if (pmd_trans_huge(*pmd))
+			continue;
+
+		pte = pte_offset_map_lock(mm, pmd, start, &ptl);
+		vmf.virtual_address = (void __user *)start;
+		vmf.pte = pte;
+		vmf.pgoff = linear_page_index(vma, start);
+		vmf.max_pgoff = vmf.pgoff + ((next - start) >> PAGE_SHIFT) - 1;
+		vmf.flags = 0;
+		vmf.page = NULL;
+		vma->vm_ops->map_pages(vma, &vmf);
+		pte_unmap_unlock(pte, ptl);
+	}
+}
+
 #if !defined(__HAVE_ARCH_GATE_AREA)
 
 #if defined(AT_SYSINFO_EHDR)
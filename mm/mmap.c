@@ -49,6 +49,8 @@
 static void unmap_region(struct mm_struct *mm,
 		struct vm_area_struct *vma, struct vm_area_struct *prev,
 		unsigned long start, unsigned long end);
+static int __do_munmap(struct mm_struct *mm, unsigned long start, size_t len,
+		       int downgrade);
 
 /*
  * WARNING: the debugging will use recursive algorithms so never enable this
@@ -246,8 +248,10 @@ SYSCALL_DEFINE1(brk, unsigned long, brk)
 	unsigned long newbrk, oldbrk;
 	struct mm_struct *mm = current->mm;
 	unsigned long min_brk;
+	unsigned long origbrk;
 
 	down_write(&mm->mmap_sem);
+	origbrk = mm->brk;
 
 #ifdef CONFIG_COMPAT_BRK
 	/*
@@ -281,10 +285,22 @@ SYSCALL_DEFINE1(brk, unsigned long, brk)
 	if (oldbrk == newbrk)
 		goto set_brk;
 
-	/* Always allow shrinking brk. */
+	/*
+	 * Always allow shrinking brk. mm->brk is set before the unmap,
+	 * which may downgrade mmap_sem, and restored if that fails.
+	 */
 	if (brk <= mm->brk) {
-		if (!do_munmap(mm, newbrk, oldbrk-newbrk))
-			goto set_brk;
+		int ret;
+
+		mm->brk = brk;
+		ret = __do_munmap(mm, newbrk, oldbrk-newbrk, 1);
+		if (ret < 0) {
+			mm->brk = origbrk;
+			goto out;
+		} else if (ret == 1) {
+			up_read(&mm->mmap_sem);
+			return brk;
+		}
 		goto out;
 	}
 
@@ -500,6 +516,10 @@ int vma_adjust(struct vm_area_struct *vma, unsigned long start,
 	long adjust_next = 0;
 	int remove_next = 0;
 
+	/* A page table shared by fork() must stay within one vma */
+	if (unshare_pte_boundary(vma, start) || unshare_pte_boundary(vma, end))
+		return -ENOMEM;
+
 	if (next && !insert) {
 		struct vm_area_struct *exporter = NULL;
 
@@ -1849,19 +1869,13 @@ find_extend_vma(struct mm_struct * mm, unsigned long addr)
 
 /*
  * Ok - we have the memory areas we should free on the vma list,
- * so release them, and do the vma updates.
+ * so release them.
  *
- * Called with the mm semaphore held.
+ * Called with the mm semaphore held, possibly only for reading.
  */
 static void remove_vma_list(struct mm_struct *mm, struct vm_area_struct *vma)
 {
-	/* Update high watermark before we lower total_vm */
-	update_hiwater_vm(mm);
 	do {
-		long nrpages = vma_pages(vma);
-
-		mm->total_vm -= nrpages;
-		vm_stat_account(mm, vma->vm_flags, vma->vm_file, -nrpages);
 		vma = remove_vma(vma);
 	} while (vma);
 	validate_mm(mm);
@@ -1904,9 +1918,15 @@ detach_vmas_to_be_unmapped(struct mm_struct *mm, struct vm_area_struct *vma,
 
 	insertion_point = (prev ? &prev->vm_next : &mm->mmap);
 	vma->vm_prev = NULL;
+	/* Update high watermark before we lower total_vm */
+	update_hiwater_vm(mm);
 	do {
+		long nrpages = vma_pages(vma);
+
 		rb_erase(&vma->vm_rb, &mm->mm_rb);
 		mm->map_count--;
+		mm->total_vm -= nrpages;
+		vm_stat_account(mm, vma->vm_flags, vma->vm_file, -nrpages);
 		tail_vma = vma;
 		vma = vma->vm_next;
 	} while (vma && vma->vm_start < end);
@@ -2012,15 +2032,40 @@ int split_vma(struct mm_struct *mm, struct vm_area_struct *vma,
 	return __split_vma(mm, vma, addr, new_below);
 }
 
+/*
+ * Once the vmas are detached, no page fault can find them, and zapping
+ * and freeing their page tables can go on with mmap_sem downgraded to
+ * read: faults, and other readers, elsewhere in the address space need
+ * not wait for it. This is not safe if a neighbouring stack could grow
+ * into the range being freed, since expand_stack() only holds mmap_sem
+ * for reading; and hugetlb and pfnmap vmas keep the exclusive lock.
+ */
+static int can_downgrade_munmap(struct vm_area_struct *vma,
+		struct vm_area_struct *prev, struct vm_area_struct *next)
+{
+	if (next && (next->vm_flags & VM_GROWSDOWN))
+		return 0;
+	if (prev && (prev->vm_flags & VM_GROWSUP))
+		return 0;
+	for (; vma; vma = vma->vm_next)
+		if (vma->vm_flags & (VM_HUGETLB | VM_PFNMAP))
+			return 0;
+	return 1;
+}
+
 /* Munmap is split into 2 main parts -- this part which finds
  * what needs doing, and the areas themselves, which do the
  * work.  This now handles partial unmappings.
  * Jeremy Fitzhardinge <jeremy@goop.org>
+ *
+ * If @downgrade is set and this returns 1, mmap_sem was downgraded
+ * and the caller has to up_read() it instead of up_write().
  */
-int do_munmap(struct mm_struct *mm, unsigned long start, size_t len)
+static int __do_munmap(struct mm_struct *mm, unsigned long start, size_t len,
+		       int downgrade)
 {
 	unsigned long end;
-	struct vm_area_struct *vma, *prev, *last;
+	struct vm_area_struct *vma, *prev, *last, *next;
 
 	if ((start & ~PAGE_MASK) || start > TASK_SIZE || len > TASK_SIZE-start)
 		return -EINVAL;
@@ -2091,12 +2136,22 @@ int do_munmap(struct mm_struct *mm, unsigned long start, size_t len)
 	 * Remove the vma's, and unmap the actual pages
 	 */
 	detach_vmas_to_be_unmapped(mm, vma, prev, end);
+	next = prev ? prev->vm_next : mm->mmap;
+	if (downgrade && can_downgrade_munmap(vma, prev, next))
+		downgrade_write(&mm->mmap_sem);
+	else
+		downgrade = 0;
 	unmap_region(mm, vma, prev, start, end);
 
 	/* Fix up all other VM information */
 	remove_vma_list(mm, vma);
 
-	return 0;
+	return downgrade ? 1 : 0;
+}
+
+int do_munmap(struct mm_struct *mm, unsigned long start, size_t len)
+{
+	return __do_munmap(mm, start, len, 0);
 }
 
 EXPORT_SYMBOL(do_munmap);
@@ -2109,7 +2164,11 @@ SYSCALL_DEFINE2(munmap, unsigned long, addr, size_t, len)
 	profile_munmap(addr);
 
 	down_write(&mm->mmap_sem);
-	ret = do_munmap(mm, addr, len);
+	ret = __do_munmap(mm, addr, len, 1);
+	if (ret == 1) {
+		up_read(&mm->mmap_sem);
+		return 0;
+	}
 	up_write(&mm->mmap_sem);
 	return ret;
 }
@@ -147,6 +147,9 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 		old_pmd = get_old_pmd(vma->vm_mm, old_addr);
 		if (!old_pmd)
 			continue;
+		if (unlikely(pte_table_shared(old_pmd)) &&
+		    unshare_pte_table(vma, old_pmd, old_addr))
+			break;
 		new_pmd = alloc_new_pmd(vma->vm_mm, vma, new_addr);
 		if (!new_pmd)
 			break;
@@ -1175,6 +1175,7 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	spinlock_t *ptl;
 	int ret = SWAP_AGAIN;
 
+again:
 	pte = page_check_address(page, mm, address, &ptl, 0);
 	if (!pte)
 		goto out;
@@ -1191,6 +1192,20 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 		if (TTU_ACTION(flags) == TTU_MUNLOCK)
 			goto out_unmap;
 	}
+
+	/*
+	 * The ptes of a page table shared by fork() do not change until
+	 * one of its mms takes a private copy: see share_pte_table(). Take
+	 * one for this mm, the other mms sharing the table do the same when
+	 * the rmap walk reaches their vmas.
+	 */
+	if (pgtable_shared(kmap_atomic_to_page(pte))) {
+		pte_unmap_unlock(pte, ptl);
+		if (try_unshare_pte_table(vma, address))
+			goto out;
+		goto again;
+	}
+
 	if (!(flags & TTU_IGNORE_ACCESS)) {
 		if (ptep_clear_flush_young_notify(vma, address, pte)) {
 			ret = SWAP_FAIL;
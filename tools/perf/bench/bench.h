@@ -3,7 +3,19 @@
 
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
+extern int bench_sched_jitter(int argc, const char **argv, const char *prefix);
+extern int bench_sched_unix(int argc, const char **argv, const char *prefix);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_fork(int argc, const char **argv, const char *prefix);
+extern int bench_mem_mmap(int argc, const char **argv, const char *prefix);
+extern int bench_mem_exec(int argc, const char **argv, const char *prefix);
+extern int bench_mem_filemap(int argc, const char **argv, const char *prefix);
+extern int bench_fs_create(int argc, const char **argv, const char *prefix);
+extern int bench_fs_fd(int argc, const char **argv, const char *prefix);
+extern int bench_fs_copy(int argc, const char **argv, const char *prefix);
+extern int bench_futex_hash(int argc, const char **argv, const char *prefix);
+extern int bench_futex_wake(int argc, const char **argv, const char *prefix);
+extern int bench_futex_requeue(int argc, const char **argv, const char *prefix);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
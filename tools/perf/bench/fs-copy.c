@@ -0,0 +1,225 @@
+/*
+ *
+ * fs-copy.c
+ *
+ * copy: Benchmark for copying a file within one filesystem
+ *
+ * A source file is written in the given directory and then copied to a
+ * second file, either with copy_file_range(), which lets a filesystem
+ * like btrfs share the extents and falls back to an in-kernel page cache
+ * copy elsewhere (ext4, tmpfs), or with sendfile() or read()/write() for
+ * comparison.  Only the copy is timed.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#define BUF_SIZE	(1024 * 1024)
+
+static const char *base_dir = ".";
+static const char *mode_str = "copy";
+static int size_mb = 256;
+static bool do_fsync = false;
+
+static const struct option options[] = {
+	OPT_STRING('d', "directory", &base_dir, "path",
+		    "Directory to create the test files in"),
+	OPT_STRING('m', "mode", &mode_str, "mode",
+		    "Copy with copy_file_range (copy), sendfile or read/write (rw)"),
+	OPT_INTEGER('s', "size", &size_mb,
+		    "Specify size of the file in MB"),
+	OPT_BOOLEAN('f', "fsync", &do_fsync,
+		    "Include an fsync() of the copy in the timing"),
+	OPT_END()
+};
+
+static const char * const bench_fs_copy_usage[] = {
+	"perf bench fs copy <options>",
+	NULL
+};
+
+enum copy_mode {
+	COPY_RANGE,
+	COPY_SENDFILE,
+	COPY_RW,
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static ssize_t sys_copy_file_range(int fd_in, int fd_out, size_t len)
+{
+#ifdef __NR_copy_file_range
+	return syscall(__NR_copy_file_range, fd_in, NULL, fd_out, NULL,
+		       len, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static void write_source(int fd, unsigned long long size)
+{
+	char *buf = malloc(BUF_SIZE);
+	unsigned long long i;
+	ssize_t ret;
+
+	if (!buf)
+		barf("malloc");
+	for (i = 0; i < BUF_SIZE; i++)
+		buf[i] = i * 7;
+
+	while (size) {
+		size_t len = size < BUF_SIZE ? size : BUF_SIZE;
+
+		ret = write(fd, buf, len);
+		if (ret <= 0)
+			barf("write");
+		size -= ret;
+	}
+	if (fsync(fd))
+		barf("fsync");
+	free(buf);
+}
+
+static void copy_file(int src, int dst, enum copy_mode mode,
+		      unsigned long long size)
+{
+	char *buf = NULL;
+	ssize_t ret;
+
+	if (mode == COPY_RW) {
+		buf = malloc(BUF_SIZE);
+		if (!buf)
+			barf("malloc");
+	}
+
+	while (size) {
+		switch (mode) {
+		case COPY_RANGE:
+			ret = sys_copy_file_range(src, dst, size);
+			break;
+		case COPY_SENDFILE:
+			ret = sendfile(dst, src, NULL, size);
+			break;
+		case COPY_RW:
+		default:
+			ret = read(src, buf, size < BUF_SIZE ? size : BUF_SIZE);
+			if (ret > 0)
+				ret = write(dst, buf, ret);
+			break;
+		}
+		if (ret < 0)
+			barf("copy");
+		if (!ret) {
+			fprintf(stderr, "source file got truncated\n");
+			exit(1);
+		}
+		size -= ret;
+	}
+	free(buf);
+}
+
+int bench_fs_copy(int argc, const char **argv,
+		  const char *prefix __used)
+{
+	char src_path[PATH_MAX], dst_path[PATH_MAX];
+	struct timeval start, stop, diff;
+	unsigned long long size, result_usec;
+	enum copy_mode mode;
+	int src, dst;
+
+	argc = parse_options(argc, argv, options,
+			     bench_fs_copy_usage, 0);
+
+	if (!strcmp(mode_str, "copy"))
+		mode = COPY_RANGE;
+	else if (!strcmp(mode_str, "sendfile"))
+		mode = COPY_SENDFILE;
+	else if (!strcmp(mode_str, "rw"))
+		mode = COPY_RW;
+	else
+		usage_with_options(bench_fs_copy_usage, options);
+
+	if (size_mb <= 0)
+		usage_with_options(bench_fs_copy_usage, options);
+	size = size_mb * 1024ULL * 1024ULL;
+
+	snprintf(src_path, sizeof(src_path), "%s/perf-copy-src.%d",
+		 base_dir, getpid());
+	snprintf(dst_path, sizeof(dst_path), "%s/perf-copy-dst.%d",
+		 base_dir, getpid());
+
+	src = open(src_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (src < 0)
+		barf("open source");
+	dst = open(dst_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (dst < 0)
+		barf("open destination");
+
+	write_source(src, size);
+	if (lseek(src, 0, SEEK_SET))
+		barf("lseek");
+
+	gettimeofday(&start, NULL);
+	copy_file(src, dst, mode, size);
+	if (do_fsync && fsync(dst))
+		barf("fsync");
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	close(src);
+	close(dst);
+	unlink(src_path);
+	unlink(dst_path);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Copied %d MB in %s with %s\n\n",
+		       size_mb, base_dir, mode_str);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf MB/sec\n",
+		       (double)size_mb /
+		       ((double)(result_usec ? result_usec : 1) / 1000000.0));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n",
+		       (double)size_mb /
+		       ((double)(result_usec ? result_usec : 1) / 1000000.0));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ *
+ * fs-create.c
+ *
+ * create: Benchmark for parallel file creation and removal
+ *
+ * Every thread creates and unlinks empty files in its own directory (or
+ * in one shared directory), which hammers the inode and dentry caches,
+ * their LRUs and the per-superblock inode list.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+static const char *base_dir = ".";
+static int nr_threads = 32;
+static int nr_files = 1000;
+static int loops = 10;
+static bool shared_dir = false;
+
+static const struct option options[] = {
+	OPT_STRING('d', "directory", &base_dir, "path",
+		    "Directory to create the test files in"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads"),
+	OPT_INTEGER('n', "files", &nr_files,
+		    "Specify number of files per thread and loop"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of loops"),
+	OPT_BOOLEAN('s', "shared", &shared_dir,
+		    "All threads use the same directory"),
+	OPT_END()
+};
+
+static const char * const bench_fs_create_usage[] = {
+	"perf bench fs create <options>",
+	NULL
+};
+
+struct create_worker {
+	pthread_t thread;
+	int id;
+	char dir[PATH_MAX];
+};
+
+static pthread_mutex_t start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int start_flag;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *create_worker(void *arg)
+{
+	struct create_worker *w = arg;
+	char path[PATH_MAX];
+	int i, j, fd;
+
+	pthread_mutex_lock(&start_mutex);
+	while (!start_flag)
+		pthread_cond_wait(&start_cond, &start_mutex);
+	pthread_mutex_unlock(&start_mutex);
+
+	for (i = 0; i < loops; i++) {
+		for (j = 0; j < nr_files; j++) {
+			snprintf(path, sizeof(path), "%s/f-%d-%d",
+				 w->dir, w->id, j);
+			fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0600);
+			if (fd < 0)
+				barf("open");
+			close(fd);
+		}
+		for (j = 0; j < nr_files; j++) {
+			snprintf(path, sizeof(path), "%s/f-%d-%d",
+				 w->dir, w->id, j);
+			if (unlink(path))
+				barf("unlink");
+		}
+	}
+
+	return NULL;
+}
+
+int bench_fs_create(int argc, const char **argv,
+		    const char *prefix __used)
+{
+	struct create_worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long long nr_ops, result_usec;
+	char top[PATH_MAX];
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_fs_create_usage, 0);
+
+	if (nr_threads <= 0 || nr_files <= 0 || loops <= 0)
+		usage_with_options(bench_fs_create_usage, options);
+
+	workers = calloc(nr_threads, sizeof(*workers));
+	if (!workers)
+		barf("calloc");
+
+	snprintf(top, sizeof(top), "%s/perf-bench-create.%d",
+		 base_dir, getpid());
+	if (mkdir(top, 0700))
+		barf("mkdir");
+
+	for (i = 0; i < nr_threads; i++) {
+		struct create_worker *w = &workers[i];
+
+		w->id = i;
+		if (shared_dir) {
+			strcpy(w->dir, top);
+		} else {
+			snprintf(w->dir, sizeof(w->dir), "%s/%d", top, i);
+			if (mkdir(w->dir, 0700))
+				barf("mkdir");
+		}
+		if (pthread_create(&w->thread, NULL, create_worker, w))
+			barf("pthread_create");
+	}
+
+	gettimeofday(&start, NULL);
+	pthread_mutex_lock(&start_mutex);
+	start_flag = 1;
+	pthread_cond_broadcast(&start_cond);
+	pthread_mutex_unlock(&start_mutex);
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(workers[i].thread, NULL);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	if (!shared_dir) {
+		for (i = 0; i < nr_threads; i++)
+			rmdir(workers[i].dir);
+	}
+	rmdir(top);
+	free(workers);
+
+	/* one create plus one unlink per file */
+	nr_ops = 2ULL * nr_threads * nr_files * loops;
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads creating and unlinking %d files %d times"
+		       " in %s director%s\n\n",
+		       nr_threads, nr_files, loops,
+		       shared_dir ? "a shared" : "private",
+		       shared_dir ? "y" : "ies");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/op\n",
+		       (double)result_usec / (double)nr_ops);
+		printf(" %14llu ops/sec\n",
+		       nr_ops * 1000000ULL / (result_usec ? result_usec : 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
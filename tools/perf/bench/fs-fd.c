@@ -0,0 +1,205 @@
+/*
+ *
+ * fs-fd.c
+ *
+ * fd: Benchmark for file descriptor allocation and release
+ *
+ * Every thread of one process repeatedly allocates a file descriptor and
+ * closes it again, by default with dup() so that only the fd table is
+ * exercised.  Optionally the table is filled with a number of descriptors
+ * first, so that every allocation has to search past them for the lowest
+ * free one.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+static int nr_threads;
+static int nr_fill;
+static int duration = 5;
+static bool use_open = false;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('f', "fill", &nr_fill,
+		    "Keep this many descriptors open during the run"),
+	OPT_INTEGER('r', "runtime", &duration,
+		    "Specify run time in seconds"),
+	OPT_BOOLEAN('o', "open", &use_open,
+		    "Open /dev/null instead of dup()ing a descriptor"),
+	OPT_END()
+};
+
+static const char * const bench_fs_fd_usage[] = {
+	"perf bench fs fd <options>",
+	NULL
+};
+
+struct fd_worker {
+	pthread_t thread;
+	unsigned long long ops;
+};
+
+static pthread_mutex_t start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int start_flag;
+static volatile int done;
+static int base_fd;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *fd_worker(void *arg)
+{
+	struct fd_worker *w = arg;
+	unsigned long long ops = 0;
+	int fd;
+
+	pthread_mutex_lock(&start_mutex);
+	while (!start_flag)
+		pthread_cond_wait(&start_cond, &start_mutex);
+	pthread_mutex_unlock(&start_mutex);
+
+	do {
+		if (use_open)
+			fd = open("/dev/null", O_RDONLY);
+		else
+			fd = dup(base_fd);
+		if (fd < 0)
+			barf(use_open ? "open" : "dup");
+		if (close(fd))
+			barf("close");
+		ops++;
+	} while (!done);
+
+	w->ops = ops;
+	return NULL;
+}
+
+static void fill_fd_table(void)
+{
+	struct rlimit rlim;
+	int i;
+
+	if (getrlimit(RLIMIT_NOFILE, &rlim))
+		barf("getrlimit");
+	if (rlim.rlim_cur < (rlim_t)nr_fill + 1024) {
+		rlim.rlim_cur = nr_fill + 1024;
+		if (rlim.rlim_max < rlim.rlim_cur)
+			rlim.rlim_max = rlim.rlim_cur;
+		if (setrlimit(RLIMIT_NOFILE, &rlim))
+			barf("setrlimit");
+	}
+
+	for (i = 0; i < nr_fill; i++) {
+		if (dup(base_fd) < 0)
+			barf("dup");
+	}
+}
+
+int bench_fs_fd(int argc, const char **argv,
+		const char *prefix __used)
+{
+	struct fd_worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long long nr_ops = 0, min = ~0ULL, max = 0, result_usec;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_fs_fd_usage, 0);
+
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads <= 0 || nr_fill < 0 || duration <= 0)
+		usage_with_options(bench_fs_fd_usage, options);
+
+	base_fd = open("/dev/null", O_RDONLY);
+	if (base_fd < 0)
+		barf("open /dev/null");
+	fill_fd_table();
+
+	workers = calloc(nr_threads, sizeof(*workers));
+	if (!workers)
+		barf("calloc");
+
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&workers[i].thread, NULL, fd_worker,
+				   &workers[i]))
+			barf("pthread_create");
+	}
+
+	gettimeofday(&start, NULL);
+	pthread_mutex_lock(&start_mutex);
+	start_flag = 1;
+	pthread_cond_broadcast(&start_cond);
+	pthread_mutex_unlock(&start_mutex);
+
+	sleep(duration);
+	done = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		struct fd_worker *w = &workers[i];
+
+		pthread_join(w->thread, NULL);
+		nr_ops += w->ops;
+		if (w->ops < min)
+			min = w->ops;
+		if (w->ops > max)
+			max = w->ops;
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	free(workers);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads %s and closing descriptors, %d more open\n\n",
+		       nr_threads, use_open ? "opening" : "dup()ing", nr_fill);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14llu ops/sec\n",
+		       nr_ops * 1000000ULL / (result_usec ? result_usec : 1));
+		printf(" %14llu ops/sec per thread (min: %llu max: %llu)\n",
+		       nr_ops * 1000000ULL / (result_usec ? result_usec : 1) /
+		       nr_threads,
+		       min * 1000000ULL / (result_usec ? result_usec : 1),
+		       max * 1000000ULL / (result_usec ? result_usec : 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu\n",
+		       nr_ops * 1000000ULL / (result_usec ? result_usec : 1));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
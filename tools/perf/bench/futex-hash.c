@@ -0,0 +1,199 @@
+/*
+ *
+ * futex-hash.c
+ *
+ * hash: Benchmark for the futex hash table and its bucket locks
+ *
+ * Every thread spins on FUTEX_WAIT for its own set of futexes, always with
+ * a value that does not match.  The syscall then returns -EAGAIN right away
+ * after hashing the key and taking the bucket lock, so what is measured is
+ * the hashing and the contention on the buckets.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/time.h>
+
+#ifndef PR_SET_FUTEX_HASH
+#define PR_SET_FUTEX_HASH	35
+#endif
+
+static int nr_threads;
+static int nr_futexes = 1024;
+static int duration = 10;
+static bool shared = false;
+static int private_hash = -1;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('f', "futexes", &nr_futexes,
+		    "Specify number of futexes per thread"),
+	OPT_INTEGER('r', "runtime", &duration,
+		    "Specify run time in seconds"),
+	OPT_BOOLEAN('s', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_INTEGER('H', "private-hash", &private_hash,
+		    "Use a private futex hash with this many buckets (0: default)"),
+	OPT_END()
+};
+
+static const char * const bench_futex_hash_usage[] = {
+	"perf bench futex hash <options>",
+	NULL
+};
+
+struct hash_worker {
+	pthread_t thread;
+	u_int32_t *futex;
+	unsigned long long ops;
+};
+
+static pthread_mutex_t start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int start_flag;
+static volatile int done;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *hash_worker(void *arg)
+{
+	struct hash_worker *w = arg;
+	int opflags = shared ? 0 : FUTEX_PRIVATE_FLAG;
+	unsigned long long ops = 0;
+	int i;
+
+	pthread_mutex_lock(&start_mutex);
+	while (!start_flag)
+		pthread_cond_wait(&start_cond, &start_mutex);
+	pthread_mutex_unlock(&start_mutex);
+
+	do {
+		for (i = 0; i < nr_futexes; i++) {
+			/* the futex is 0, waiting for 1 never blocks */
+			if (futex_wait(&w->futex[i], 1, NULL, opflags) == 0 ||
+			    errno != EAGAIN)
+				barf("futex_wait");
+		}
+		ops += nr_futexes;
+	} while (!done);
+
+	w->ops = ops;
+	return NULL;
+}
+
+int bench_futex_hash(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	struct hash_worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long long nr_ops = 0, min = ~0ULL, max = 0, result_usec;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_hash_usage, 0);
+
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads <= 0 || nr_futexes <= 0 || duration <= 0)
+		usage_with_options(bench_futex_hash_usage, options);
+
+	/* must happen while we are still single threaded */
+	if (private_hash >= 0) {
+		private_hash = prctl(PR_SET_FUTEX_HASH, private_hash, 0, 0, 0);
+		if (private_hash < 0)
+			barf("prctl(PR_SET_FUTEX_HASH)");
+	}
+
+	workers = calloc(nr_threads, sizeof(*workers));
+	if (!workers)
+		barf("calloc");
+
+	for (i = 0; i < nr_threads; i++) {
+		struct hash_worker *w = &workers[i];
+
+		w->futex = calloc(nr_futexes, sizeof(*w->futex));
+		if (!w->futex)
+			barf("calloc");
+		if (pthread_create(&w->thread, NULL, hash_worker, w))
+			barf("pthread_create");
+	}
+
+	gettimeofday(&start, NULL);
+	pthread_mutex_lock(&start_mutex);
+	start_flag = 1;
+	pthread_cond_broadcast(&start_cond);
+	pthread_mutex_unlock(&start_mutex);
+
+	sleep(duration);
+	done = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		struct hash_worker *w = &workers[i];
+
+		pthread_join(w->thread, NULL);
+		nr_ops += w->ops;
+		if (w->ops < min)
+			min = w->ops;
+		if (w->ops > max)
+			max = w->ops;
+		free(w->futex);
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	free(workers);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads hashing %d %s futexes each",
+		       nr_threads, nr_futexes, shared ? "shared" : "private");
+		if (private_hash > 0)
+			printf(" (private hash, %d buckets)", private_hash);
+		printf("\n\n");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14llu ops/sec\n",
+		       nr_ops * 1000000ULL / (result_usec ? result_usec : 1));
+		printf(" %14llu ops/sec per thread (min: %llu max: %llu)\n",
+		       nr_ops * 1000000ULL / (result_usec ? result_usec : 1) /
+		       nr_threads,
+		       min * 1000000ULL / (result_usec ? result_usec : 1),
+		       max * 1000000ULL / (result_usec ? result_usec : 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu\n",
+		       nr_ops * 1000000ULL / (result_usec ? result_usec : 1));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ *
+ * futex-requeue.c
+ *
+ * requeue: Benchmark for requeueing the waiters of a futex onto another
+ *
+ * A bunch of threads block on one futex, and the main thread moves them
+ * over to a second futex with FUTEX_CMP_REQUEUE, nr_requeue at a time,
+ * without waking any of them; this is what a condition variable broadcast
+ * does.  Both hash buckets are locked during the requeue.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+static int nr_threads;
+static int nr_requeue = 1;
+static int loops = 10;
+static bool shared = false;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('q', "nrequeue", &nr_requeue,
+		    "Specify number of threads to requeue per call"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of loops"),
+	OPT_BOOLEAN('s', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_requeue_usage[] = {
+	"perf bench futex requeue <options>",
+	NULL
+};
+
+static u_int32_t futex1, futex2;
+static int opflags;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *requeue_worker(void *arg __used)
+{
+	/* neither futex is ever changed, so only a wakeup gets us out */
+	while (futex_wait(&futex1, 0, NULL, opflags) && errno == EINTR)
+		;
+
+	return NULL;
+}
+
+int bench_futex_requeue(int argc, const char **argv,
+			const char *prefix __used)
+{
+	pthread_t *threads;
+	struct timeval start, stop, diff, total;
+	unsigned long long result_usec;
+	int i, l, nr_requeued, nr_woken;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_requeue_usage, 0);
+
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads <= 0 || nr_requeue <= 0 || loops <= 0)
+		usage_with_options(bench_futex_requeue_usage, options);
+
+	opflags = shared ? 0 : FUTEX_PRIVATE_FLAG;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		barf("calloc");
+
+	timerclear(&total);
+	for (l = 0; l < loops; l++) {
+		for (i = 0; i < nr_threads; i++) {
+			if (pthread_create(&threads[i], NULL,
+					   requeue_worker, NULL))
+				barf("pthread_create");
+		}
+		/* give the threads a chance to block */
+		usleep(100000);
+
+		/*
+		 * Keep requeueing until everybody has moved; threads that
+		 * were not asleep yet are simply picked up by a later call.
+		 */
+		nr_requeued = 0;
+		gettimeofday(&start, NULL);
+		while (nr_requeued < nr_threads) {
+			int ret = futex_cmp_requeue(&futex1, 0, &futex2, 0,
+						    nr_requeue, opflags);
+
+			if (ret < 0)
+				barf("futex_cmp_requeue");
+			nr_requeued += ret;
+		}
+		gettimeofday(&stop, NULL);
+		timersub(&stop, &start, &diff);
+		timeradd(&total, &diff, &total);
+
+		/* everybody sits on futex2 now, let them go */
+		nr_woken = 0;
+		while (nr_woken < nr_threads) {
+			int ret = futex_wake(&futex2, nr_threads, opflags);
+
+			if (ret < 0)
+				barf("futex_wake");
+			nr_woken += ret;
+		}
+
+		for (i = 0; i < nr_threads; i++)
+			pthread_join(threads[i], NULL);
+	}
+	free(threads);
+
+	result_usec = total.tv_sec * 1000000ULL + total.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# requeueing %d threads between two %s futexes, %d at"
+		       " a time, %d times\n\n", nr_threads,
+		       shared ? "shared" : "private", nr_requeue, loops);
+
+		printf(" %14s: %lu.%03lu [msec]\n\n", "Total time",
+		       (unsigned long) (result_usec / 1000),
+		       (unsigned long) (result_usec % 1000));
+
+		printf(" %14lf usecs/requeue\n",
+		       (double)result_usec / ((double)nr_threads * loops));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       (unsigned long) (result_usec / 1000),
+		       (unsigned long) (result_usec % 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ *
+ * futex-wake.c
+ *
+ * wake: Benchmark for waking up the waiters of a futex
+ *
+ * A bunch of threads block on the same futex, and the main thread wakes
+ * them up again, nr_wake at a time.  This measures FUTEX_WAKE walking the
+ * hash bucket and waking up tasks while holding the bucket lock.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+static int nr_threads;
+static int nr_wake = 1;
+static int loops = 10;
+static bool shared = false;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('w', "nwakes", &nr_wake,
+		    "Specify number of threads to wake up per call"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of loops"),
+	OPT_BOOLEAN('s', "shared", &shared,
+		    "Use a shared futex instead of a private one"),
+	OPT_END()
+};
+
+static const char * const bench_futex_wake_usage[] = {
+	"perf bench futex wake <options>",
+	NULL
+};
+
+static u_int32_t futex1;
+static int opflags;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *wake_worker(void *arg __used)
+{
+	/* the futex is never changed, so only a wakeup gets us out */
+	while (futex_wait(&futex1, 0, NULL, opflags) && errno == EINTR)
+		;
+
+	return NULL;
+}
+
+int bench_futex_wake(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	pthread_t *threads;
+	struct timeval start, stop, diff, total;
+	unsigned long long result_usec;
+	int i, l, nr_woken;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_wake_usage, 0);
+
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads <= 0 || nr_wake <= 0 || loops <= 0)
+		usage_with_options(bench_futex_wake_usage, options);
+
+	opflags = shared ? 0 : FUTEX_PRIVATE_FLAG;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		barf("calloc");
+
+	timerclear(&total);
+	for (l = 0; l < loops; l++) {
+		for (i = 0; i < nr_threads; i++) {
+			if (pthread_create(&threads[i], NULL,
+					   wake_worker, NULL))
+				barf("pthread_create");
+		}
+		/* give the threads a chance to block */
+		usleep(100000);
+
+		/*
+		 * Keep waking until everybody is out; threads that were
+		 * not asleep yet are simply picked up by a later call.
+		 */
+		nr_woken = 0;
+		gettimeofday(&start, NULL);
+		while (nr_woken < nr_threads) {
+			int ret = futex_wake(&futex1, nr_wake, opflags);
+
+			if (ret < 0)
+				barf("futex_wake");
+			nr_woken += ret;
+		}
+		gettimeofday(&stop, NULL);
+		timersub(&stop, &start, &diff);
+		timeradd(&total, &diff, &total);
+
+		for (i = 0; i < nr_threads; i++)
+			pthread_join(threads[i], NULL);
+	}
+	free(threads);
+
+	result_usec = total.tv_sec * 1000000ULL + total.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# waking %d threads blocked on a %s futex, %d at a"
+		       " time, %d times\n\n", nr_threads,
+		       shared ? "shared" : "private", nr_wake, loops);
+
+		printf(" %14s: %lu.%03lu [msec]\n\n", "Total time",
+		       (unsigned long) (result_usec / 1000),
+		       (unsigned long) (result_usec % 1000));
+
+		printf(" %14lf usecs/wakeup\n",
+		       (double)result_usec / ((double)nr_threads * loops));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       (unsigned long) (result_usec / 1000),
+		       (unsigned long) (result_usec % 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
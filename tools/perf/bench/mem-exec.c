@@ -0,0 +1,131 @@
+/*
+ *
+ * mem-exec.c
+ *
+ * exec: Benchmark for exec() and startup latency of a program
+ *
+ * The program is run over and over by a forked child that execs it
+ * straight away, and the parent reaps it. The time from fork() until
+ * the child is reaped and the minor page faults each run takes are
+ * reported, which is mostly the cost of setting up and faulting in the
+ * mappings of the program, its interpreter and its libraries.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+static int loops = 1000;
+static const char *program = "/bin/true";
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of runs of the program"),
+	OPT_STRING('p', "program", &program, "path",
+		    "Specify program to run, without arguments"),
+	OPT_END()
+};
+
+static const char * const bench_mem_exec_usage[] = {
+	"perf bench mem exec <options>",
+	NULL
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void run_program(void)
+{
+	char *argv[] = { (char *)program, NULL };
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		barf("fork");
+	if (!pid) {
+		execv(program, argv);
+		_exit(127);
+	}
+
+	if (waitpid(pid, &status, 0) != pid)
+		barf("waitpid");
+	if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+		fprintf(stderr, "%s did not run\n", program);
+		exit(1);
+	}
+}
+
+int bench_mem_exec(int argc, const char **argv,
+		   const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	struct rusage before, after;
+	unsigned long long result_usec, minflt;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_exec_usage, 0);
+
+	if (loops <= 0)
+		usage_with_options(bench_mem_exec_usage, options);
+	if (access(program, X_OK))
+		barf(program);
+
+	/* once to get the program into the page cache */
+	run_program();
+
+	getrusage(RUSAGE_CHILDREN, &before);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < loops; i++)
+		run_program();
+	gettimeofday(&stop, NULL);
+	getrusage(RUSAGE_CHILDREN, &after);
+
+	timersub(&stop, &start, &diff);
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	minflt = after.ru_minflt - before.ru_minflt;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d runs of %s\n\n", loops, program);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %10llu.%03llu usecs/run\n",
+		       result_usec / loops,
+		       result_usec * 1000 / loops % 1000);
+		printf(" %14llu minor faults/run\n", minflt / loops);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu %llu\n", result_usec / loops, minflt / loops);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
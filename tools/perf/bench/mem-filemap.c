@@ -0,0 +1,174 @@
+/*
+ *
+ * mem-filemap.c
+ *
+ * filemap: Benchmark for read faults on a file mapping in the page cache
+ *
+ * A file is written in the given directory, so that all of it is in the
+ * page cache, and is then mapped read-only and read a byte per page over
+ * and over, with a fresh mapping for each pass.  The time per pass and
+ * the minor faults it takes are reported; with fault-around, a fault
+ * maps the cached neighbours of the faulting page as well (the window is
+ * /sys/kernel/debug/fault_around_bytes, one page turns it off).
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#define BUF_SIZE	(1024 * 1024)
+
+static const char *base_dir = ".";
+static int size_mb = 64;
+static int loops = 10;
+
+static const struct option options[] = {
+	OPT_STRING('d', "directory", &base_dir, "path",
+		    "Directory to create the test file in"),
+	OPT_INTEGER('s', "size", &size_mb,
+		    "Specify size of the file in MB"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of passes over the mapping"),
+	OPT_END()
+};
+
+static const char * const bench_mem_filemap_usage[] = {
+	"perf bench mem filemap <options>",
+	NULL
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void write_file(int fd, unsigned long size)
+{
+	char *buf = malloc(BUF_SIZE);
+	unsigned long i;
+	ssize_t ret;
+
+	if (!buf)
+		barf("malloc");
+	for (i = 0; i < BUF_SIZE; i++)
+		buf[i] = i * 7;
+
+	while (size) {
+		size_t len = size < BUF_SIZE ? size : BUF_SIZE;
+
+		ret = write(fd, buf, len);
+		if (ret <= 0)
+			barf("write");
+		size -= ret;
+	}
+	free(buf);
+}
+
+static unsigned long read_mapping(int fd, unsigned long size,
+				  unsigned long page_size)
+{
+	volatile char *area;
+	unsigned long off, sum = 0;
+
+	area = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (area == MAP_FAILED)
+		barf("mmap");
+	for (off = 0; off < size; off += page_size)
+		sum += area[off];
+	if (munmap((void *)area, size))
+		barf("munmap");
+
+	return sum;
+}
+
+int bench_mem_filemap(int argc, const char **argv,
+		      const char *prefix __used)
+{
+	char path[PATH_MAX];
+	struct timeval start, stop, diff;
+	struct rusage before, after;
+	unsigned long long result_usec, minflt;
+	unsigned long size, page_size, pages;
+	int fd, i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_filemap_usage, 0);
+
+	if (size_mb <= 0 || loops <= 0)
+		usage_with_options(bench_mem_filemap_usage, options);
+	page_size = sysconf(_SC_PAGESIZE);
+	size = size_mb * 1024UL * 1024UL;
+	pages = size / page_size;
+
+	snprintf(path, sizeof(path), "%s/perf-filemap.%d",
+		 base_dir, getpid());
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0)
+		barf("open");
+	unlink(path);
+	write_file(fd, size);
+
+	/* once to have all of it uptodate in the page cache */
+	read_mapping(fd, size, page_size);
+
+	getrusage(RUSAGE_SELF, &before);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < loops; i++)
+		read_mapping(fd, size, page_size);
+	gettimeofday(&stop, NULL);
+	getrusage(RUSAGE_SELF, &after);
+	close(fd);
+
+	timersub(&stop, &start, &diff);
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	minflt = after.ru_minflt - before.ru_minflt;
+	if (!minflt)
+		minflt = 1;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d passes over a %d MB file in %s\n\n",
+		       loops, size_mb, base_dir);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %10llu.%03llu usecs/pass\n",
+		       result_usec / loops,
+		       result_usec * 1000 / loops % 1000);
+		printf(" %14llu minor faults/pass\n", minflt / loops);
+		printf(" %14llu pages mapped/fault\n",
+		       (unsigned long long)pages * loops / minflt);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu %llu\n", result_usec / loops, minflt / loops);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ *
+ * mem-fork.c
+ *
+ * fork: Benchmark for fork() latency as a function of resident memory
+ *
+ * The process faults in a growing amount of private anonymous memory and
+ * forks a child that exits right away at each size. The time fork()
+ * takes in the parent is what stalls a large process, since its
+ * mmap_sem is held for writing throughout; the time until the child is
+ * reaped is reported as well.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define HPAGE_SIZE	(2UL * 1024 * 1024)
+
+static int min_mb = 64;
+static int max_mb = 1024;
+static int loops = 10;
+static const char *thp_str = "default";
+
+static const struct option options[] = {
+	OPT_INTEGER('m', "min", &min_mb,
+		    "Specify smallest resident size in MB"),
+	OPT_INTEGER('s', "size", &max_mb,
+		    "Specify largest resident size in MB"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of forks per size"),
+	OPT_STRING('t', "thp", &thp_str, "mode",
+		    "Transparent huge pages: on, off or default"),
+	OPT_END()
+};
+
+static const char * const bench_mem_fork_usage[] = {
+	"perf bench mem fork <options>",
+	NULL
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static char *alloc_area(unsigned long size)
+{
+	char *area;
+
+	/* align to huge pages, so that THP can back all of it */
+	area = mmap(NULL, size + HPAGE_SIZE, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (area == MAP_FAILED)
+		barf("mmap");
+	area = (char *)(((unsigned long)area + HPAGE_SIZE - 1) &
+			~(HPAGE_SIZE - 1));
+
+	if (!strcmp(thp_str, "on")) {
+#ifdef MADV_HUGEPAGE
+		if (madvise(area, size, MADV_HUGEPAGE))
+			barf("madvise(MADV_HUGEPAGE)");
+#else
+		fprintf(stderr, "MADV_HUGEPAGE is not supported\n");
+		exit(1);
+#endif
+	} else if (!strcmp(thp_str, "off")) {
+#ifdef MADV_NOHUGEPAGE
+		if (madvise(area, size, MADV_NOHUGEPAGE))
+			barf("madvise(MADV_NOHUGEPAGE)");
+#endif
+	}
+
+	return area;
+}
+
+static void fork_child(unsigned long long *fork_usec,
+		       unsigned long long *exit_usec)
+{
+	struct timeval start, forked, reaped, diff;
+	int status;
+	pid_t pid;
+
+	gettimeofday(&start, NULL);
+	pid = fork();
+	if (pid < 0)
+		barf("fork");
+	if (!pid)
+		_exit(0);
+	gettimeofday(&forked, NULL);
+
+	if (waitpid(pid, &status, 0) != pid)
+		barf("waitpid");
+	gettimeofday(&reaped, NULL);
+
+	timersub(&forked, &start, &diff);
+	*fork_usec += diff.tv_sec * 1000000ULL + diff.tv_usec;
+	timersub(&reaped, &forked, &diff);
+	*exit_usec += diff.tv_sec * 1000000ULL + diff.tv_usec;
+}
+
+int bench_mem_fork(int argc, const char **argv,
+		   const char *prefix __used)
+{
+	unsigned long long fork_usec, exit_usec;
+	unsigned long touched = 0, page_size, size;
+	char *area;
+	int mb, i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_fork_usage, 0);
+
+	if (strcmp(thp_str, "on") && strcmp(thp_str, "off") &&
+	    strcmp(thp_str, "default"))
+		usage_with_options(bench_mem_fork_usage, options);
+	if (min_mb <= 0 || max_mb < min_mb || loops <= 0)
+		usage_with_options(bench_mem_fork_usage, options);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	area = alloc_area(max_mb * 1024UL * 1024UL);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT) {
+		printf("# %d forks per size, transparent huge pages %s\n\n",
+		       loops, thp_str);
+		printf(" %14s %14s %14s\n", "RSS [MB]", "fork [usec]",
+		       "exit [usec]");
+	}
+
+	for (mb = min_mb; ; mb *= 2) {
+		if (mb > max_mb)
+			mb = max_mb;
+
+		/* fault in the memory up to the new size */
+		size = mb * 1024UL * 1024UL;
+		for (; touched < size; touched += page_size)
+			area[touched] = 1;
+
+		fork_usec = exit_usec = 0;
+		for (i = 0; i < loops; i++)
+			fork_child(&fork_usec, &exit_usec);
+
+		switch (bench_format) {
+		case BENCH_FORMAT_DEFAULT:
+			printf(" %14d %10llu.%03llu %10llu.%03llu\n", mb,
+			       fork_usec / loops,
+			       fork_usec * 1000 / loops % 1000,
+			       exit_usec / loops,
+			       exit_usec * 1000 / loops % 1000);
+			break;
+
+		case BENCH_FORMAT_SIMPLE:
+			printf("%d %llu %llu\n", mb, fork_usec / loops,
+			       exit_usec / loops);
+			break;
+
+		default:
+			/* reaching here is something disaster */
+			fprintf(stderr, "Unknown format:%d\n", bench_format);
+			exit(1);
+			break;
+		}
+
+		if (mb == max_mb)
+			break;
+	}
+
+	return 0;
+}
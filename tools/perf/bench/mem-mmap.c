@@ -0,0 +1,238 @@
+/*
+ *
+ * mem-mmap.c
+ *
+ * mmap: Benchmark for page faults racing with mmap() and munmap()
+ *
+ * Fault threads keep faulting in pages of their own anonymous area and
+ * dropping them again with madvise(MADV_DONTNEED), while mapper threads of
+ * the same process mmap() an area, touch it and munmap() it.  Everything
+ * that changes the address space takes mmap_sem for writing, so the fault
+ * rate and the worst fault latency show how much the mappers stall the
+ * faulting threads.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+static int nr_faulters;
+static int nr_mappers = 1;
+static int fault_mb = 16;
+static int map_mb = 64;
+static int duration = 5;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_faulters,
+		    "Specify number of faulting threads (default: online cpus)"),
+	OPT_INTEGER('m', "mappers", &nr_mappers,
+		    "Specify number of mmap/munmap threads"),
+	OPT_INTEGER('f', "fault-size", &fault_mb,
+		    "Specify size of the area of each faulting thread in MB"),
+	OPT_INTEGER('s', "size", &map_mb,
+		    "Specify size of each mmap() in MB"),
+	OPT_INTEGER('r', "runtime", &duration,
+		    "Specify run time in seconds"),
+	OPT_END()
+};
+
+static const char * const bench_mem_mmap_usage[] = {
+	"perf bench mem mmap <options>",
+	NULL
+};
+
+struct mmap_worker {
+	pthread_t thread;
+	unsigned long long ops;
+	unsigned long long max_usec;
+};
+
+static pthread_mutex_t start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int start_flag;
+static volatile int done;
+static unsigned long page_size;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void wait_for_start(void)
+{
+	pthread_mutex_lock(&start_mutex);
+	while (!start_flag)
+		pthread_cond_wait(&start_cond, &start_mutex);
+	pthread_mutex_unlock(&start_mutex);
+}
+
+static unsigned long long now_usec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static void *fault_worker(void *arg)
+{
+	struct mmap_worker *w = arg;
+	unsigned long size = fault_mb * 1024UL * 1024UL;
+	unsigned long long ops = 0, max_usec = 0, t0, t1;
+	unsigned long off;
+	char *area;
+
+	area = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (area == MAP_FAILED)
+		barf("mmap");
+
+	wait_for_start();
+
+	do {
+		t0 = now_usec();
+		for (off = 0; off < size && !done; off += page_size) {
+			area[off] = 1;
+			t1 = now_usec();
+			if (t1 - t0 > max_usec)
+				max_usec = t1 - t0;
+			t0 = t1;
+			ops++;
+		}
+		if (madvise(area, size, MADV_DONTNEED))
+			barf("madvise");
+	} while (!done);
+
+	munmap(area, size);
+	w->ops = ops;
+	w->max_usec = max_usec;
+	return NULL;
+}
+
+static void *map_worker(void *arg)
+{
+	struct mmap_worker *w = arg;
+	unsigned long size = map_mb * 1024UL * 1024UL;
+	unsigned long long ops = 0;
+	unsigned long off;
+	char *area;
+
+	wait_for_start();
+
+	do {
+		area = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (area == MAP_FAILED)
+			barf("mmap");
+		for (off = 0; off < size; off += page_size)
+			area[off] = 1;
+		if (munmap(area, size))
+			barf("munmap");
+		ops++;
+	} while (!done);
+
+	w->ops = ops;
+	return NULL;
+}
+
+int bench_mem_mmap(int argc, const char **argv,
+		   const char *prefix __used)
+{
+	struct mmap_worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long long faults = 0, maps = 0, max_usec = 0, result_usec;
+	int nr_threads, i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_mmap_usage, 0);
+
+	if (!nr_faulters)
+		nr_faulters = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_faulters <= 0 || nr_mappers < 0 || fault_mb <= 0 ||
+	    map_mb <= 0 || duration <= 0)
+		usage_with_options(bench_mem_mmap_usage, options);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	nr_threads = nr_faulters + nr_mappers;
+	workers = calloc(nr_threads, sizeof(*workers));
+	if (!workers)
+		barf("calloc");
+
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&workers[i].thread, NULL,
+				   i < nr_faulters ? fault_worker : map_worker,
+				   &workers[i]))
+			barf("pthread_create");
+	}
+
+	gettimeofday(&start, NULL);
+	pthread_mutex_lock(&start_mutex);
+	start_flag = 1;
+	pthread_cond_broadcast(&start_cond);
+	pthread_mutex_unlock(&start_mutex);
+
+	sleep(duration);
+	done = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		struct mmap_worker *w = &workers[i];
+
+		pthread_join(w->thread, NULL);
+		if (i < nr_faulters) {
+			faults += w->ops;
+			if (w->max_usec > max_usec)
+				max_usec = w->max_usec;
+		} else
+			maps += w->ops;
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	free(workers);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	if (!result_usec)
+		result_usec = 1;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads faulting in %d MB each, %d threads mapping %d MB\n\n",
+		       nr_faulters, fault_mb, nr_mappers, map_mb);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14llu faults/sec\n",
+		       faults * 1000000ULL / result_usec);
+		printf(" %14llu usecs longest fault\n", max_usec);
+		printf(" %14llu mmap/munmap/sec\n",
+		       maps * 1000000ULL / result_usec);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu %llu\n",
+		       faults * 1000000ULL / result_usec, max_usec);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ *
+ * sched-jitter.c
+ *
+ * jitter: Measure how often, and for how long, a busy loop gets interrupted
+ *
+ * The loop keeps reading CLOCK_MONOTONIC and records every gap between two
+ * reads longer than the threshold: these are the time slices stolen by the
+ * tick, interrupts, softirqs and other tasks. Run it on a full dynticks CPU
+ * (nohz_full=) to see the tick going away.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+static int cpu = -1;
+static int duration = 5;
+static int threshold = 2;
+
+static const struct option options[] = {
+	OPT_INTEGER('c', "cpu", &cpu,
+		    "CPU to run the loop on (default: current one)"),
+	OPT_INTEGER('t', "time", &duration,
+		    "Specify run time in seconds"),
+	OPT_INTEGER('T', "threshold", &threshold,
+		    "Smallest gap reported as an interruption, in usecs"),
+	OPT_END()
+};
+
+static const char * const bench_sched_jitter_usage[] = {
+	"perf bench sched jitter <options>",
+	NULL
+};
+
+static inline unsigned long long now_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int bench_sched_jitter(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	unsigned long long start, end, prev, t, delta;
+	unsigned long long thresh_ns, nr_hits = 0, lost = 0, max = 0;
+	double elapsed;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_jitter_usage, 0);
+
+	if (duration <= 0 || threshold <= 0)
+		usage_with_options(bench_sched_jitter_usage, options);
+
+	if (cpu >= 0) {
+		cpu_set_t mask;
+
+		CPU_ZERO(&mask);
+		CPU_SET(cpu, &mask);
+		if (sched_setaffinity(0, sizeof(mask), &mask)) {
+			fprintf(stderr, "sched_setaffinity to CPU %d failed"
+				" (error: %s)\n", cpu, strerror(errno));
+			exit(1);
+		}
+	}
+
+	thresh_ns = threshold * 1000ULL;
+	start = prev = now_nsec();
+	end = start + duration * 1000000000ULL;
+
+	do {
+		t = now_nsec();
+		delta = t - prev;
+		prev = t;
+
+		if (delta < thresh_ns)
+			continue;
+
+		nr_hits++;
+		lost += delta;
+		if (delta > max)
+			max = delta;
+	} while (t < end);
+
+	elapsed = (double)(t - start) / 1e9;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Busy loop for %d sec on %s%d, reporting gaps"
+		       " above %d usecs\n\n", duration,
+		       cpu >= 0 ? "CPU " : "any CPU", cpu >= 0 ? cpu : 0,
+		       threshold);
+
+		printf(" %14llu interruptions\n", nr_hits);
+		printf(" %14.2lf interruptions/sec\n", nr_hits / elapsed);
+		printf(" %14.3lf usecs max\n", max / 1e3);
+		printf(" %14.3lf usecs avg\n",
+		       nr_hits ? lost / 1e3 / nr_hits : 0.0);
+		printf(" %14.3lf usecs lost in total (%.4lf%%)\n",
+		       lost / 1e3, lost / (elapsed * 1e7));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu %.3lf\n", nr_hits, max / 1e3);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
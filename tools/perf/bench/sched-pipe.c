@@ -8,6 +8,9 @@
  *  http://people.redhat.com/mingo/cfs-scheduler/tools/pipe-test-1m.c
  * Ported to perf by Hitoshi Mitake <mitake@dcl.info.waseda.ac.jp>
  *
+ * With --stream one task writes all messages into one pipe and the
+ * other reads them, without waiting for each other.
+ *
  */
 
 #include "../perf.h"
@@ -30,10 +33,16 @@
 
 #define LOOPS_DEFAULT 1000000
 static int loops = LOOPS_DEFAULT;
+static int msg_bytes = sizeof(int);
+static bool stream = false;
 
 static const struct option options[] = {
 	OPT_INTEGER('l', "loop", &loops,
 		    "Specify number of loops"),
+	OPT_INTEGER('b', "bytes", &msg_bytes,
+		    "Specify size of each message in bytes"),
+	OPT_BOOLEAN('s', "stream", &stream,
+		    "Stream messages one way instead of ping-ponging"),
 	OPT_END()
 };
 
@@ -42,25 +51,49 @@ static const char * const bench_sched_pipe_usage[] = {
 	NULL
 };
 
+/* a message larger than a page may show up in pieces */
+static void read_msg(int fd, char *buf, int len)
+{
+	int n;
+
+	while (len > 0) {
+		n = read(fd, buf, len);
+		assert(n > 0);
+		len -= n;
+	}
+}
+
+static void write_msg(int fd, char *buf, int len)
+{
+	int n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		assert(n > 0);
+		len -= n;
+	}
+}
+
 int bench_sched_pipe(int argc, const char **argv,
 		     const char *prefix __used)
 {
 	int pipe_1[2], pipe_2[2];
-	int m = 0, i;
+	int i;
+	char *m;
 	struct timeval start, stop, diff;
 	unsigned long long result_usec = 0;
-
-	/*
-	 * why does "ret" exist?
-	 * discarding returned value of read(), write()
-	 * causes error in building environment for perf
-	 */
-	int __used ret, wait_stat;
+	int wait_stat;
 	pid_t pid, retpid;
 
 	argc = parse_options(argc, argv, options,
 			     bench_sched_pipe_usage, 0);
 
+	if (loops <= 0 || msg_bytes <= 0)
+		usage_with_options(bench_sched_pipe_usage, options);
+
+	m = calloc(1, msg_bytes);
+	assert(m);
+
 	assert(!pipe(pipe_1));
 	assert(!pipe(pipe_2));
 
@@ -69,21 +102,32 @@ int bench_sched_pipe(int argc, const char **argv,
 
 	gettimeofday(&start, NULL);
 
-	if (!pid) {
+	if (stream) {
+		if (!pid) {
+			unsigned long long left = (unsigned long long)msg_bytes * loops;
+			int n;
+
+			while (left) {
+				n = read(pipe_1[0], m, msg_bytes);
+				assert(n > 0);
+				left -= n;
+			}
+		} else {
+			for (i = 0; i < loops; i++)
+				write_msg(pipe_1[1], m, msg_bytes);
+		}
+	} else if (!pid) {
 		for (i = 0; i < loops; i++) {
-			ret = read(pipe_1[0], &m, sizeof(int));
-			ret = write(pipe_2[1], &m, sizeof(int));
+			read_msg(pipe_1[0], m, msg_bytes);
+			write_msg(pipe_2[1], m, msg_bytes);
 		}
 	} else {
 		for (i = 0; i < loops; i++) {
-			ret = write(pipe_1[1], &m, sizeof(int));
-			ret = read(pipe_2[0], &m, sizeof(int));
+			write_msg(pipe_1[1], m, msg_bytes);
+			read_msg(pipe_2[0], m, msg_bytes);
 		}
 	}
 
-	gettimeofday(&stop, NULL);
-	timersub(&stop, &start, &diff);
-
 	if (pid) {
 		retpid = waitpid(pid, &wait_stat, 0);
 		assert((retpid == pid) && WIFEXITED(wait_stat));
@@ -91,10 +135,19 @@ int bench_sched_pipe(int argc, const char **argv,
 		exit(0);
 	}
 
+	/* for streaming, the data is only through once the reader is done */
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	free(m);
+
 	switch (bench_format) {
 	case BENCH_FORMAT_DEFAULT:
-		printf("# Executed %d pipe operations between two tasks\n\n",
-			loops);
+		if (stream)
+			printf("# Streamed %d messages of %d bytes between two tasks\n\n",
+				loops, msg_bytes);
+		else
+			printf("# Executed %d pipe operations between two tasks\n\n",
+				loops);
 
 		result_usec = diff.tv_sec * 1000000;
 		result_usec += diff.tv_usec;
@@ -108,6 +161,10 @@ int bench_sched_pipe(int argc, const char **argv,
 		printf(" %14d ops/sec\n",
 		       (int)((double)loops /
 			     ((double)result_usec / (double)1000000)));
+		if (stream)
+			printf(" %14lf MB/sec\n",
+			       (double)msg_bytes * loops / (1024 * 1024) /
+			       ((double)result_usec / (double)1000000));
 		break;
 
 	case BENCH_FORMAT_SIMPLE:
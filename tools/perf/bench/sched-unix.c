@@ -0,0 +1,239 @@
+/*
+ *
+ * sched-unix.c
+ *
+ * unix: Throughput benchmark for AF_UNIX stream sockets
+ *
+ * A sender process streams a buffer over a socketpair() to a receiver
+ * process.  Both sides default to plain write() and read(), so that every
+ * byte is copied twice.  Either side can be switched to splice: the sender
+ * then vmsplice()s its buffer into a pipe with SPLICE_F_GIFT and splices
+ * the pipe into the socket, the receiver splices the socket into a pipe
+ * and that pipe into /dev/null.  The data is not checked.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+/* the most a pipe holds by default, never splice more in one go */
+#define PIPE_CHUNK	(64 * 1024)
+
+static int msg_kb = 64;
+static int total_mb = 1024;
+static bool gift = false;
+static bool splice_recv = false;
+
+static const struct option options[] = {
+	OPT_INTEGER('s', "size", &msg_kb,
+		    "Specify size of each write in KB (default: 64)"),
+	OPT_INTEGER('l', "length", &total_mb,
+		    "Specify amount of data to transfer in MB (default: 1024)"),
+	OPT_BOOLEAN('g', "gift", &gift,
+		    "Send by vmsplice()ing gifted pages into the socket"),
+	OPT_BOOLEAN('p', "splice", &splice_recv,
+		    "Receive by splicing the socket to /dev/null"),
+	OPT_END()
+};
+
+static const char * const bench_sched_unix_usage[] = {
+	"perf bench sched unix <options>",
+	NULL
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *alloc_buffer(size_t size)
+{
+	void *buf;
+
+	/* page aligned, so that vmsplice() can take whole pages */
+	if (posix_memalign(&buf, sysconf(_SC_PAGESIZE), size))
+		barf("posix_memalign");
+	memset(buf, 0x5a, size);
+	return buf;
+}
+
+/* move len bytes that are sitting in the pipe on to fd */
+static void drain_pipe(int pipe_fd, int fd, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = splice(pipe_fd, NULL, fd, NULL, len, SPLICE_F_MOVE);
+		if (ret <= 0)
+			barf("splice from pipe");
+		len -= ret;
+	}
+}
+
+static void sender(int sock, size_t size, unsigned long long total)
+{
+	char *buf = alloc_buffer(size);
+	int pfd[2];
+	ssize_t ret;
+
+	if (gift && pipe(pfd))
+		barf("pipe");
+
+	while (total) {
+		size_t len = size < total ? size : total;
+		size_t off = 0;
+
+		while (off < len) {
+			if (gift) {
+				struct iovec iov;
+
+				iov.iov_base = buf + off;
+				iov.iov_len = len - off;
+				if (iov.iov_len > PIPE_CHUNK)
+					iov.iov_len = PIPE_CHUNK;
+				ret = vmsplice(pfd[1], &iov, 1, SPLICE_F_GIFT);
+				if (ret <= 0)
+					barf("vmsplice");
+				drain_pipe(pfd[0], sock, ret);
+			} else {
+				ret = write(sock, buf + off, len - off);
+				if (ret <= 0)
+					barf("write");
+			}
+			off += ret;
+		}
+		total -= len;
+	}
+	free(buf);
+}
+
+static void receiver(int sock, size_t size, unsigned long long total)
+{
+	char *buf = NULL;
+	int pfd[2], null_fd = -1;
+	ssize_t ret;
+
+	if (splice_recv) {
+		if (pipe(pfd))
+			barf("pipe");
+		null_fd = open("/dev/null", O_WRONLY);
+		if (null_fd < 0)
+			barf("open /dev/null");
+	} else {
+		buf = alloc_buffer(size);
+	}
+
+	while (total) {
+		size_t len = size < total ? size : total;
+
+		if (splice_recv) {
+			if (len > PIPE_CHUNK)
+				len = PIPE_CHUNK;
+			ret = splice(sock, NULL, pfd[1], NULL, len,
+				     SPLICE_F_MOVE);
+			if (ret > 0)
+				drain_pipe(pfd[0], null_fd, ret);
+		} else {
+			ret = read(sock, buf, len);
+		}
+		if (ret < 0)
+			barf(splice_recv ? "splice from socket" : "read");
+		if (!ret) {
+			fprintf(stderr, "unexpected end of stream\n");
+			exit(1);
+		}
+		total -= ret;
+	}
+	free(buf);
+}
+
+int bench_sched_unix(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long total, result_usec;
+	size_t size;
+	int sv[2], wait_stat;
+	pid_t pid;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_unix_usage, 0);
+
+	if (msg_kb <= 0 || total_mb <= 0)
+		usage_with_options(bench_sched_unix_usage, options);
+
+	size = msg_kb * 1024UL;
+	total = total_mb * 1024ULL * 1024ULL;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+		barf("socketpair");
+
+	gettimeofday(&start, NULL);
+
+	pid = fork();
+	if (pid < 0)
+		barf("fork");
+	if (!pid) {
+		close(sv[1]);
+		sender(sv[0], size, total);
+		exit(0);
+	}
+
+	close(sv[0]);
+	receiver(sv[1], size, total);
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	if (waitpid(pid, &wait_stat, 0) != pid || !WIFEXITED(wait_stat) ||
+	    WEXITSTATUS(wait_stat))
+		barf("sender failed");
+	close(sv[1]);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Transferred %d MB in %d KB writes (%s send, %s receive)\n\n",
+		       total_mb, msg_kb, gift ? "vmsplice" : "write",
+		       splice_recv ? "splice" : "read");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf MB/sec\n",
+		       (double)total_mb /
+		       ((double)(result_usec ? result_usec : 1) / 1000000.0));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n",
+		       (double)total_mb /
+		       ((double)(result_usec ? result_usec : 1) / 1000000.0));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -13,6 +13,8 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  fs    ... filesystem and VFS cache scalability
+ *  futex ... futex hashing, wakeup and requeue
  *
  */
 
@@ -42,6 +44,12 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "jitter",
+	  "Interruptions of a busy loop, e.g. by the tick",
+	  bench_sched_jitter    },
+	{ "unix",
+	  "Stream throughput over an AF_UNIX socketpair",
+	  bench_sched_unix      },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -52,6 +60,50 @@ static struct bench_suite mem_suites[] = {
 	{ "memcpy",
 	  "Simple memory copy in various ways",
 	  bench_mem_memcpy },
+	{ "fork",
+	  "Fork latency as a function of resident memory",
+	  bench_mem_fork },
+	{ "mmap",
+	  "Page faults racing with mmap and munmap",
+	  bench_mem_mmap },
+	{ "exec",
+	  "Exec and startup latency of a program",
+	  bench_mem_exec },
+	{ "filemap",
+	  "Read faults on a cached file mapping",
+	  bench_mem_filemap },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite fs_suites[] = {
+	{ "create",
+	  "Parallel creation and removal of files",
+	  bench_fs_create },
+	{ "fd",
+	  "Allocation and release of file descriptors by many threads",
+	  bench_fs_fd },
+	{ "copy",
+	  "Copy of a file with copy_file_range, sendfile or read/write",
+	  bench_fs_copy },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite futex_suites[] = {
+	{ "hash",
+	  "Contention on the futex hash buckets",
+	  bench_futex_hash },
+	{ "wake",
+	  "Wakeup of many threads blocked on a futex",
+	  bench_futex_wake },
+	{ "requeue",
+	  "Requeue of many threads between two futexes",
+	  bench_futex_requeue },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -71,6 +123,12 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "fs",
+	  "filesystem and VFS cache scalability",
+	  fs_suites },
+	{ "futex",
+	  "futex hashing, wakeup and requeue",
+	  futex_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },
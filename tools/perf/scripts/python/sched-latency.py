@@ -0,0 +1,124 @@
+# scheduling latency histograms
+# Licensed under the terms of the GNU GPL License version 2
+#
+# Displays the log2 wakeup and preemption latency histograms kept by the
+# scheduler (CONFIG_SCHEDSTATS), as they changed over the traced period.
+# System-wide figures come from /proc/schedstat; if a [cgroup directory]
+# of the cpu controller is specified, its cpu.latency file is used.
+
+import os
+import sys
+
+sys.path.append(os.environ['PERF_EXEC_PATH'] + \
+	'/scripts/python/Perf-Trace-Util/lib/Perf/Trace')
+
+from perf_trace_context import *
+from Core import *
+
+usage = "perf script -s sched-latency.py [cgroup directory]\n";
+
+# oldest schedstat version with the latency histograms
+SCHEDSTAT_VERSION = 16
+NR_BUCKETS = 24
+BAR_WIDTH = 40
+
+hists = ("wakeup_lat", "preempt_lat")
+
+cgroup = None
+
+if len(sys.argv) > 2:
+	sys.exit(usage)
+
+if len(sys.argv) > 1:
+	cgroup = sys.argv[1]
+
+def read_schedstat():
+	stats = { "nr_migrations" : 0 }
+	for name in hists:
+		stats[name] = [0] * NR_BUCKETS
+
+	f = open("/proc/schedstat")
+	for line in f:
+		fields = line.split()
+		if fields[0] == "version":
+			if int(fields[1]) < SCHEDSTAT_VERSION:
+				sys.exit("unsupported schedstat version %s\n" %
+					 fields[1])
+		elif fields[0].startswith("cpu"):
+			stats["nr_migrations"] += int(fields[12])
+		elif fields[0] in hists:
+			hist = stats[fields[0]]
+			for i in range(NR_BUCKETS):
+				hist[i] += int(fields[i + 1])
+	f.close()
+
+	return stats
+
+def read_cgroup():
+	stats = {}
+
+	f = open(os.path.join(cgroup, "cpu.latency"))
+	for line in f:
+		fields = line.split()
+		if fields[0] in hists:
+			stats[fields[0]] = [int(v) for v in fields[1:]]
+		elif fields[0] == "nr_migrations":
+			stats["nr_migrations"] = int(fields[1])
+	f.close()
+
+	return stats
+
+def read_stats():
+	try:
+		if cgroup is not None:
+			return read_cgroup()
+		return read_schedstat()
+	except IOError, e:
+		sys.exit("%s (is CONFIG_SCHEDSTATS enabled?)\n" % e)
+
+def bucket_range(i):
+	# bucket i holds waits in [2^(i-1), 2^i) * 1024ns
+	if i == 0:
+		return "< 1"
+	lo = 1 << (i - 1)
+	if i == NR_BUCKETS - 1:
+		return ">= %d" % lo
+	if i == 1:
+		return "1"
+	return "%d - %d" % (lo, (1 << i) - 1)
+
+def print_hist(name, hist):
+	total = sum(hist)
+
+	print "\n%s: %d samples\n" % (name, total)
+	print "%-20s  %12s  %s" % ("usecs (1024ns)", "count", "distribution")
+
+	if not total:
+		return
+
+	top = max(hist)
+	last = max([i for i in range(NR_BUCKETS) if hist[i]])
+	for i in range(last + 1):
+		bar = "#" * (hist[i] * BAR_WIDTH / top)
+		print "%-20s  %12d  |%-*s|" % (bucket_range(i), hist[i],
+					      BAR_WIDTH, bar)
+
+start = None
+
+def trace_begin():
+	global start
+
+	start = read_stats()
+
+def trace_end():
+	end = read_stats()
+
+	if cgroup is not None:
+		print "\nscheduling latency for %s:" % cgroup,
+	else:
+		print "\nsystem-wide scheduling latency:",
+
+	for name in hists:
+		print_hist(name, [e - s for e, s in zip(end[name], start[name])])
+
+	print "\nmigrations: %d" % (end["nr_migrations"] - start["nr_migrations"])
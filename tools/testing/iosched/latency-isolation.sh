@@ -0,0 +1,104 @@
+#!/bin/sh
+#
+# Check that the latency target IO scheduler keeps a reader with a tight
+# read target isolated from a flood of writers in another blkio cgroup.
+#
+# A null_blk device in request mode with timer completions stands in for a
+# fast SSD with a small hardware queue.  The reader and the writers use
+# separate halves of the device so that blktrace events can be attributed
+# to them by sector.  The script prints the mean and 99th percentile queue
+# to completion time of the reader's requests and fails if the mean is
+# above the target.
+#
+# Needs root, null_blk, blktrace/blkparse, CONFIG_LATENCY_GROUP_IOSCHED and
+# a blkio cgroup mount (or a place to mount one).
+#
+# usage: latency-isolation.sh [scheduler]
+#
+# Running it with "deadline" instead of the default "latency" shows what
+# the reader sees without isolation; that run is expected to fail.
+
+SCHED=${1:-latency}
+TARGET=500		# reader read target, usecs
+SERVICE=100000		# null_blk completion time, nsecs
+DEPTH=8			# null_blk hardware queue depth
+WRITERS=32
+RUNTIME=10		# seconds
+CGROOT=${CGROOT:-/sys/fs/cgroup/blkio}
+TMP=$(mktemp -d /tmp/latency-isolation.XXXXXX)
+
+fail()
+{
+	echo "FAIL: $*"
+	exit 1
+}
+
+cleanup()
+{
+	kill $PIDS 2>/dev/null
+	wait 2>/dev/null
+	for g in reader writers; do
+		[ -d $CGROOT/$g ] && rmdir $CGROOT/$g
+	done
+	rmmod null_blk 2>/dev/null
+	rm -rf $TMP
+}
+trap cleanup EXIT
+
+[ $(id -u) -eq 0 ] || fail "must be run as root"
+which blktrace blkparse >/dev/null || fail "blktrace and blkparse are needed"
+
+modprobe null_blk queue_mode=1 irqmode=2 completion_nsec=$SERVICE \
+	hw_queue_depth=$DEPTH nr_devices=1 gb=16 || fail "cannot load null_blk"
+DEV=nullb0
+echo $SCHED > /sys/block/$DEV/queue/scheduler || \
+	fail "scheduler $SCHED not available"
+MAJMIN=$(cat /sys/block/$DEV/dev)
+
+if [ ! -f $CGROOT/blkio.reset_stats ]; then
+	mkdir -p $CGROOT
+	mount -t cgroup -o blkio none $CGROOT || fail "cannot mount blkio cgroup"
+fi
+mkdir $CGROOT/reader $CGROOT/writers || fail "cannot create cgroups"
+if [ $SCHED = latency ]; then
+	echo "$MAJMIN $TARGET" > $CGROOT/reader/blkio.latency.read_target_device
+	echo "$MAJMIN 100000" > $CGROOT/writers/blkio.latency.write_target_device
+fi
+
+# writers: 64k direct writes at 2GB and up
+i=0
+while [ $i -lt $WRITERS ]; do
+	sh -c "echo \$\$ > $CGROOT/writers/tasks; exec dd if=/dev/zero \
+		of=/dev/$DEV bs=64k oflag=direct seek=$((32768 + i * 256)) \
+		count=1000000" 2>/dev/null &
+	PIDS="$PIDS $!"
+	i=$((i + 1))
+done
+
+# reader: 4k direct reads, one at a time, below 2GB
+sh -c "echo \$\$ > $CGROOT/reader/tasks; exec dd if=/dev/$DEV of=/dev/null \
+	bs=4k iflag=direct count=100000000" 2>/dev/null &
+PIDS="$PIDS $!"
+
+sleep 1
+(cd $TMP && blktrace -d /dev/$DEV -a queue -a complete -w $RUNTIME \
+	>/dev/null 2>&1) || fail "blktrace failed"
+kill $PIDS 2>/dev/null
+wait 2>/dev/null
+PIDS=
+
+# queue to completion time of requests below 2GB, in usecs
+blkparse -i $TMP/$DEV -q -f "%a %S %T.%9t\n" 2>/dev/null | awk '
+	$2 >= 4194304 { next }
+	$1 == "Q" { q[$2] = $3 }
+	$1 == "C" && ($2 in q) { print ($3 - q[$2]) * 1000000; delete q[$2] }
+' | sort -n > $TMP/lat
+
+N=$(wc -l < $TMP/lat)
+[ $N -gt 100 ] || fail "only $N reader completions traced"
+MEAN=$(awk '{ s += $1 } END { printf "%d", s / NR }' $TMP/lat)
+P99=$(sed -n "$(((N * 99 + 99) / 100))p" $TMP/lat | cut -d. -f1)
+
+echo "$SCHED: $N reads, mean ${MEAN}us, p99 ${P99}us, target ${TARGET}us"
+[ $MEAN -le $TARGET ] || fail "mean read latency above target"
+echo "PASS"
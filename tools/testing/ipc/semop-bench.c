@@ -0,0 +1,165 @@
+/*
+ * semop-bench.c - SysV semaphore scaling benchmark
+ *
+ * Every thread repeatedly increments and decrements its own semaphore of
+ * one shared semaphore set with single-sop semop() calls.  The threads
+ * never contend on a semaphore, so the throughput shows how well semop()
+ * scales between semaphores of the same array.  The run is repeated for
+ * 1, 2, 4, ... threads up to the given maximum.
+ *
+ * With -c every semop() operates on two semaphores (its own one and a
+ * spare one per thread), which forces the complex operation path and the
+ * array-wide lock, for comparison.
+ *
+ * usage: semop-bench [-t max_threads] [-s seconds] [-c]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+
+#define MAX_THREADS	64
+
+struct worker {
+	pthread_t thread;
+	int num;
+	unsigned long ops;
+} __attribute__((aligned(64)));
+
+static struct worker workers[MAX_THREADS];
+static pthread_barrier_t barrier;
+static volatile int done;
+static int semid;
+static int complex_ops;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *worker(void *arg)
+{
+	struct worker *w = arg;
+	struct sembuf up[2], down[2];
+	int nsops = complex_ops ? 2 : 1;
+	unsigned long ops = 0;
+
+	up[0].sem_num = w->num;
+	up[0].sem_op = 1;
+	up[0].sem_flg = 0;
+	down[0] = up[0];
+	down[0].sem_op = -1;
+
+	up[1].sem_num = MAX_THREADS + w->num;
+	up[1].sem_op = 1;
+	up[1].sem_flg = 0;
+	down[1] = up[1];
+	down[1].sem_op = -1;
+
+	pthread_barrier_wait(&barrier);
+
+	while (!done) {
+		if (semop(semid, up, nsops) || semop(semid, down, nsops))
+			barf("semop failed");
+		ops += 2;
+	}
+	w->ops = ops;
+
+	return NULL;
+}
+
+static unsigned long run(int nr_threads, int runtime)
+{
+	unsigned long total = 0;
+	int i;
+
+	done = 0;
+	if (pthread_barrier_init(&barrier, NULL, nr_threads + 1))
+		barf("pthread_barrier_init failed");
+
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].num = i;
+		workers[i].ops = 0;
+		if (pthread_create(&workers[i].thread, NULL, worker,
+				   &workers[i]))
+			barf("pthread_create failed");
+	}
+
+	pthread_barrier_wait(&barrier);
+	sleep(runtime);
+	done = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		total += workers[i].ops;
+	}
+	pthread_barrier_destroy(&barrier);
+
+	return total / runtime;
+}
+
+int main(int argc, char **argv)
+{
+	int max_threads = 64;
+	int runtime = 5;
+	unsigned long base = 0;
+	int nr, c;
+
+	while ((c = getopt(argc, argv, "t:s:c")) != -1) {
+		switch (c) {
+		case 't':
+			max_threads = atoi(optarg);
+			break;
+		case 's':
+			runtime = atoi(optarg);
+			break;
+		case 'c':
+			complex_ops = 1;
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-t max_threads] [-s seconds] [-c]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (max_threads < 1 || max_threads > MAX_THREADS || runtime < 1) {
+		fprintf(stderr, "threads must be 1..%d, seconds positive\n",
+			MAX_THREADS);
+		return 1;
+	}
+
+	semid = semget(IPC_PRIVATE, 2 * MAX_THREADS, IPC_CREAT | 0600);
+	if (semid < 0)
+		barf("semget failed (is kernel.sem SEMMSL >= 128?)");
+
+	printf("# %s semop(), %d seconds per run\n",
+	       complex_ops ? "two-sop" : "single-sop", runtime);
+	printf("%8s %14s %10s\n", "threads", "ops/sec", "scaling");
+
+	for (nr = 1; ; nr *= 2) {
+		unsigned long ops;
+
+		if (nr > max_threads)
+			nr = max_threads;
+		ops = run(nr, runtime);
+		if (nr == 1)
+			base = ops ? ops : 1;
+		printf("%8d %14lu %9.2fx\n", nr, ops, (double)ops / base);
+		fflush(stdout);
+
+		if (nr == max_threads)
+			break;
+	}
+
+	if (semctl(semid, 0, IPC_RMID))
+		barf("semctl(IPC_RMID) failed");
+
+	return 0;
+}